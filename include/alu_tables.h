@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+
+// Lookup tables for the 8-bit ALU, generated at build time by
+// gen_alu_tables. Every entry holds the result in the low byte and the z, n,
+// h and c bits of F in the high byte, so an operation is a single load. The
+// low nibble of F is left to the caller.
+
+// same order as the CB prefixed rotates and shifts, (opcode >> 3) & 0x07
+enum {
+    ALU_RLC,
+    ALU_RRC,
+    ALU_RL,
+    ALU_RR,
+    ALU_SLA,
+    ALU_SRA,
+    ALU_SWAP,
+    ALU_SRL,
+};
+
+#define ALU_PAIR(a, b) ((uint16_t)((a) << 8 | (b)))
+#define ALU_NHC(f) (((f) >> 4) & 0x07)
+
+extern const uint16_t alu_add[2][0x10000]; // [carry][ALU_PAIR(a, b)], ADD and ADC
+extern const uint16_t alu_sub[2][0x10000]; // [carry][ALU_PAIR(a, b)], SUB, SBC and CP
+extern const uint16_t alu_inc[0x100];      // c is not touched
+extern const uint16_t alu_dec[0x100];      // c is not touched
+extern const uint16_t alu_daa[8][0x100];   // [ALU_NHC(F)][A]
+extern const uint16_t alu_shift[8][2][0x100]; // [ALU_*][carry][value]
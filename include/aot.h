@@ -0,0 +1,56 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gbcpu.h"
+
+// Ahead-of-time translated ROMs. gb_aot walks the control flow of a ROM
+// image from the entry point and the RST and interrupt vectors and writes C
+// source with one function per block it finds; gb_aot_module() in
+// CMakeLists.txt compiles that into a shared object. A block runs the same
+// addressing modes and handlers, in the same order, as cpu_clock would, so
+// the trace matches the interpreter exactly.
+//
+// A block only runs when the bytes it was translated from are still in
+// memory; RAM-resident code, code gb_aot did not find and ROM bytes written
+// at run time go through cpu_clock. The module is read-only once loaded, so
+// any number of CPUs and threads can share it.
+
+#define AOT_VERSION 1
+
+typedef struct {
+    uint16_t start;
+    uint16_t length; // bytes the block was translated from
+    const uint8_t *bytes;
+    void (*run)(GBCPU *cpu);
+} AotBlock;
+
+// what a generated shared object exports as gb_aot_module
+typedef struct {
+    uint32_t version;
+    uint32_t count;
+    const AotBlock *blocks;
+} AotModule;
+
+typedef struct {
+    const AotModule *module;
+    void *handle;                  // from dlopen, NULL for a linked-in module
+    const AotBlock *entry[0x8000]; // by start address
+} AotRuntime;
+
+AotRuntime *aot_load(const char *path);
+AotRuntime *aot_attach_module(const AotModule *module);
+void aot_unload(AotRuntime *aot);
+
+// Runs the block at PC, or a single instruction in cpu_clock when there is
+// no valid block or a breakpoint inside it. Runs nothing while stopped, see
+// breakpoints.h. Returns whether translated code ran.
+bool aot_run(const AotRuntime *aot, GBCPU *cpu);
+
+// Called by generated code after each handler, the tail of cpu_clock.
+// Returns false when the block has to stop. Instructions that may store to
+// memory pass the rest of the block's bytes, which are checked for writes
+// into code that has not run yet.
+bool aot_retire(GBCPU *cpu, const OpInstr *instr, uint16_t addr, uint16_t next, const uint8_t *rest,
+                uint16_t rest_length);
@@ -0,0 +1,106 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gbcpu.h"
+
+// Basic-block translation cache. A block is a run of pre-decoded
+// instructions starting at a PC and ending at the first jump, call, return,
+// RST, STOP or HALT. Operands that only depend on the instruction bytes
+// (registers, immediates, $FF00+n, (nn)) are resolved once when the block is
+// decoded, so a block runs without going through the opcode table or the
+// addressing-mode functions again.
+//
+// A cache belongs to the GBCPU it was attached to: resolved operands point
+// into that instance. Every byte a block was decoded from is marked in a
+// code bitmap, and bus writes that hit a marked byte invalidate the blocks
+// covering it. Memory changed behind the CPU's back (read_binary, test
+// pokes) needs a block_cache_flush.
+//
+// A few common idioms at the end of a block are fused when the block is
+// decoded and run as one handler. A fused handler checks its preconditions
+// first (no pending serial transfer, no store into code or the I/O page, the
+// cycle deadline) and falls back to block_step when one does not hold. A
+// fused loop whose jump targets its own start keeps iterating inside the
+// handler until the loop exits or the deadline is reached.
+//
+// Fill and copy loops built on LDI/LDD are run as one memset or memmove.
+// They are only recognised as self-loops, and only when the whole range they
+// store to is plain RAM (VRAM, WRAM or HRAM) that does not hold the loop
+// itself; cached blocks in the range are invalidated as a bus write would.
+//
+// With breakpoints attached, blocks end before every breakpoint, a block
+// starting at one is not fused and fill loops are not run in one go over a
+// watched page, see breakpoints.h.
+
+#define BLOCK_MAX_INSTRUCTIONS 32
+
+enum {
+    FUSE_NONE,
+    FUSE_DEC_JR,  // DEC r; JR NZ,e
+    FUSE_POLL,    // LDH A,(n); AND n; JR Z/NZ,e
+    FUSE_COPY,    // LDI A,(HL); LD (DE),A; INC DE; DEC BC; LD A,B; OR C; JR NZ,e
+    FUSE_COPY_R,  // LDI A,(HL); LD (DE),A; INC DE; DEC B/C; JR NZ,e
+    FUSE_FILL,    // LDI/LDD (HL),A; DEC r; JR NZ,e
+    FUSE_FILL_BC, // XOR A or LD A,n; LDI/LDD (HL),A; DEC BC; LD A,B; OR C; JR NZ,e
+    FUSE_FILL_H,  // LDI/LDD (HL),A; BIT n,H; JR Z/NZ,e
+    FUSE_COUNT,
+};
+
+extern const char *const block_fuse_names[FUSE_COUNT];
+
+typedef struct {
+    Instruction instruction;
+    AddrModeFunc read_func; // NULL when src was resolved at decode time
+    AddrModeFunc write_func; // NULL when dst was resolved at decode time
+    DataAccess src;
+    DataAccess dst;
+    const OpInstr *instr;
+    uint16_t addr;
+    uint16_t next;
+    uint8_t opcode;
+    uint8_t cycles;
+    uint8_t fuse;        // FUSE_* pattern starting at this instruction
+    uint8_t fuse_cycles; // cycles of one pass through the pattern
+} BlockInstr;
+
+typedef struct Block {
+    struct Block *next; // chain of blocks starting in the same page
+    uint32_t start;
+    uint32_t end; // one past the last byte decoded
+    bool valid;
+    uint8_t count;
+    uint32_t hits;
+    void (*native)(GBCPU *cpu); // set once jit.c compiled the block
+    BlockInstr instrs[];
+} Block;
+
+typedef struct {
+    Block *blocks[0x100]; // indexed by the low byte of the start address
+    Block *chain;
+} BlockPage;
+
+struct BlockCache {
+    BlockPage *pages[0x100];
+    uint8_t code[0x10000 / 8];
+    Block *retired; // invalidated while possibly still running, freed on the next lookup
+    void *jit;      // code arena, owned by jit.c
+    size_t deadline; // fused handlers never run past this cycle count, SIZE_MAX by default
+    size_t decoded;
+    size_t executed;
+    size_t invalidated;
+    size_t fused[FUSE_COUNT]; // guest instructions run by each fused handler
+    size_t fuse_fallbacks;
+};
+
+void block_cache_attach(GBCPU *cpu);
+void block_cache_detach(GBCPU *cpu);
+void block_cache_flush(BlockCache *cache);
+void block_cache_write(BlockCache *cache, uint16_t addr);
+void block_run(GBCPU *cpu);
+
+// building blocks for other engines running on top of the cache
+Block *block_lookup(GBCPU *cpu);
+void block_execute(GBCPU *cpu, Block *block);
+bool block_step(GBCPU *cpu, const Block *block, const BlockInstr *d);
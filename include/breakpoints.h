@@ -0,0 +1,91 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gbcpu.h"
+
+// PC breakpoints and memory watchpoints. Nothing is checked unless
+// breakpoints_attach was called; an attached instance with nothing set only
+// tests a bitmap bit per block.
+//
+// Breakpoints are a bitmap with one bit per PC, tested at block boundaries:
+// block_run, jit_run and aot_run check before they run anything, and a loop
+// stepping cpu_clock calls breakpoints_check before each instruction. Blocks
+// decoded by the block cache end before any breakpoint, and setting one
+// invalidates the cached blocks covering it, so every breakpoint is a block
+// start. AOT blocks containing a breakpoint run through cpu_clock instead.
+//
+// Watchpoints stop the run when a bus store changes the value at an address.
+// Every page holding a watched address is flagged, and only stores into a
+// flagged page leave the fast path to look the address up. The store still
+// happens; the run stops at the next block boundary, with the instruction
+// that made the store recorded in the hit. Fused fill and copy loops fall
+// back to block_step over a flagged page.
+
+typedef enum {
+    BREAK_NONE, // running
+    BREAK_PC,
+    BREAK_WATCH,
+} BreakKind;
+
+typedef struct {
+    BreakKind kind;
+    uint16_t addr;       // the breakpoint PC or the watched address
+    uint8_t old_value;   // watchpoints only
+    uint8_t new_value;   // watchpoints only
+    size_t instruction;  // instruction_count of the breakpoint or the store
+} BreakHit;
+
+struct Breakpoints {
+    uint8_t pc[0x10000 / 8];
+    uint8_t watched[0x10000 / 8];
+    uint16_t watched_pages[0x100]; // watched addresses in each page
+    size_t pc_count;
+    BreakHit hit; // kind is BREAK_NONE until something stops the run
+};
+
+void breakpoints_attach(GBCPU *cpu);
+void breakpoints_detach(GBCPU *cpu);
+
+// Setting a breakpoint or watchpoint attaches breakpoints first when needed;
+// clearing one on an instance without them does nothing.
+void breakpoint_set(GBCPU *cpu, uint16_t pc);
+void breakpoint_clear(GBCPU *cpu, uint16_t pc);
+void watchpoint_set(GBCPU *cpu, uint16_t addr);
+void watchpoint_clear(GBCPU *cpu, uint16_t addr);
+
+// Clears the hit and, after a breakpoint, steps over the instruction at PC
+// in cpu_clock so the run does not stop at the same breakpoint again.
+void breakpoints_resume(GBCPU *cpu);
+
+// the store slow path, for addresses in a flagged page
+void watchpoint_store(GBCPU *cpu, uint16_t addr, uint8_t value);
+
+static inline bool breakpoint_at(const Breakpoints *breakpoints, uint16_t pc) {
+    return breakpoints->pc[pc >> 3] & (1 << (pc & 0x07));
+}
+
+// Whether the run is stopped, recording a hit when PC is a breakpoint.
+static inline bool breakpoints_check(GBCPU *cpu) {
+    Breakpoints *breakpoints = cpu->breakpoints;
+    if (breakpoints == NULL) {
+        return false;
+    }
+    if (breakpoints->hit.kind == BREAK_NONE && breakpoint_at(breakpoints, cpu->reg.PC)) {
+        breakpoints->hit.kind = BREAK_PC;
+        breakpoints->hit.addr = cpu->reg.PC;
+        breakpoints->hit.instruction = cpu->instruction_count;
+    }
+    return breakpoints->hit.kind != BREAK_NONE;
+}
+
+// Called by bus stores before the value is written.
+static inline void breakpoints_store(GBCPU *cpu, uint16_t addr, uint8_t value) {
+    if (cpu->breakpoints && cpu->breakpoints->watched_pages[addr >> 8]) {
+        watchpoint_store(cpu, addr, value);
+    }
+}
+
+// Whether a store to any of length bytes from start takes the slow path.
+bool watchpoints_in_range(const GBCPU *cpu, uint16_t start, size_t length);
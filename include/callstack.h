@@ -0,0 +1,94 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gbcpu.h"
+
+// Guest call stack tracking and sampling. Once callstack_attach was called,
+// CALL, RST and interrupt entry push a frame for their target and RET/RETI
+// pop the frames they return from; a run loop calls callstack_poll after
+// each step to sample the stack every interval guest cycles. The samples are
+// written as folded stacks, one "root;caller;callee count" line per stack,
+// the input flamegraph.pl and speedscope take.
+//
+// Frames remember the SP their return address was pushed at. A return pops
+// every frame at or below its SP and a call drops the frames it overwrites,
+// so code that discards return addresses or returns through a pushed
+// address does not leave stale frames behind.
+//
+// Each frame is a node in a calling-context tree, so a sample is one
+// increment on the node of the current stack. Stacks deeper than
+// CALLSTACK_DEPTH are sampled at their deepest kept frame.
+//
+// Frames are named from a .sym file (RGBDS and no$gmb "BB:AAAA name" lines)
+// when one is loaded and as BB:AAAA otherwise. Only the first 64K of a ROM
+// are mapped, so $4000-$7FFF is always bank 1.
+
+#define CALLSTACK_DEPTH 64
+#define CALLSTACK_INTERVAL 1024 // default guest cycles between samples
+
+typedef struct {
+    uint16_t addr;
+    uint8_t bank;
+    uint32_t parent;
+    uint32_t child;   // first child, 0 for none
+    uint32_t sibling; // next child of the parent, 0 for none
+    uint64_t samples;
+} CallNode;
+
+typedef struct {
+    uint32_t node;
+    uint16_t sp; // where the return address is
+} CallFrame;
+
+typedef struct {
+    uint32_t key; // bank << 16 | address
+    char *name;
+} CallSymbol;
+
+struct CallStack {
+    CallFrame frames[CALLSTACK_DEPTH];
+    uint32_t depth; // frames above the root
+    uint32_t node;  // node of the current stack, root is 0
+    CallNode *nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+    size_t interval;
+    size_t next_sample;
+    CallSymbol *symbols; // sorted by key
+    size_t symbol_count;
+};
+
+// Starts tracking with the current PC as the root, sampling every interval
+// guest cycles, CALLSTACK_INTERVAL when 0.
+void callstack_attach(GBCPU *cpu, size_t interval);
+void callstack_detach(GBCPU *cpu);
+bool callstack_load_symbols(CallStack *stack, const char *file);
+void callstack_write_folded(const CallStack *stack, FILE *out);
+
+uint8_t callstack_bank(uint16_t addr);
+void callstack_push(CallStack *stack, uint16_t addr, uint16_t sp);
+void callstack_pop(CallStack *stack, uint16_t sp);
+void callstack_sample(CallStack *stack, size_t cycles);
+
+// Called by CALL, RST and interrupt entry once the return address is pushed.
+static inline void callstack_enter(GBCPU *cpu, uint16_t addr) {
+    if (cpu->calls) {
+        callstack_push(cpu->calls, addr, cpu->reg.SP);
+    }
+}
+
+// Called by RET and RETI before the return address is popped.
+static inline void callstack_leave(GBCPU *cpu) {
+    if (cpu->calls) {
+        callstack_pop(cpu->calls, cpu->reg.SP);
+    }
+}
+
+static inline void callstack_poll(GBCPU *cpu) {
+    if (cpu->calls && cpu->cycles >= cpu->calls->next_sample) {
+        callstack_sample(cpu->calls, cpu->cycles);
+    }
+}
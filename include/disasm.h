@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+
+// Table-driven disassembler. The text of every opcode is built once from the
+// opcode tables, with markers where the immediate goes; gb_disasm copies the
+// template and writes the operand with the hex tables, without printf.
+
+#define GB_DISASM_SIZE 24 // longest text with its terminator
+
+// Writes the instruction at bytes, which is at addr, to out, e.g.
+// "LD HL, $C000" or "JRNZ $0150" with the jump target worked out. Returns its
+// length in bytes, 1 for an undefined opcode, which is shown as "DB $xx".
+// bytes has to hold the longest instruction, 3 bytes.
+uint8_t gb_disasm(const uint8_t *bytes, uint16_t addr, char *out);
+
+// Hex and decimal writers the trace formatters share. They return the end
+// of what they wrote and do not terminate it.
+char *disasm_hex8(char *out, uint8_t value);
+char *disasm_hex16(char *out, uint16_t value);
+// right aligned in width characters, wider when the number needs it
+char *disasm_decimal(char *out, uint64_t value, int width);
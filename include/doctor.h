@@ -0,0 +1,38 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "gbcpu.h"
+
+// Compares a run with a Gameboy Doctor reference log, the format
+// print_flags writes:
+//   A: 01 F: B0 B: 00 C: 13 D: 00 E: D8 H: 01 L: 4D SP: FFFE PC: 00:0100 (00 C3 13 02)
+// The log is memory mapped and each line is decoded at its fixed columns and
+// compared with the recorded state as bytes; text is only formatted for the
+// report once something differs.
+
+typedef enum {
+    DOCTOR_MATCH,
+    DOCTOR_MISMATCH,
+    DOCTOR_MALFORMED, // the line is not in the format above
+    DOCTOR_END,       // no lines left
+} DoctorResult;
+
+typedef struct {
+    const char *data;
+    size_t size;
+    size_t offset; // start of the current line
+    size_t line;   // 1-based number of the current line
+} DoctorLog;
+
+DoctorLog *doctor_open(const char *file);
+void doctor_close(DoctorLog *log);
+
+// Compares the state before an instruction, as in cpu->history, with the
+// current line, and moves on to the next line when they match.
+DoctorResult doctor_compare(DoctorLog *log, const HistoryEntry *entry);
+
+// Prints the line number, the expected and the found line, and marks the
+// fields that differ.
+void doctor_report(const DoctorLog *log, const HistoryEntry *entry, FILE *out);
@@ -0,0 +1,59 @@
+#pragma once
+#include <stdbool.h>
+
+#include "blocks.h"
+#include "gbcpu.h"
+#ifdef GB_JIT
+#include "jit.h"
+#endif
+
+// The execution engines the gb_* tools let the user pick by name, and the
+// helpers they share. Built as the gb_tools library, which passes GB_JIT on
+// to everything linking it: jit only exists in a GB_JIT build.
+
+typedef enum {
+    ENGINE_CPU,    // cpu_clock
+    ENGINE_BLOCKS, // block_run
+    ENGINE_JIT,    // jit_run
+    ENGINE_COUNT,
+} Engine;
+
+#ifdef GB_JIT
+#define ENGINES ENGINE_COUNT
+#else
+#define ENGINES ENGINE_JIT
+#endif
+
+extern const char *const engine_names[ENGINE_COUNT]; // "cpu", "blocks", "jit"
+
+// Returns false for an unknown name or an engine this build does not have.
+bool engine_parse(const char *name, Engine *engine);
+void engine_attach(GBCPU *cpu, Engine engine);
+// Detaches whichever engine is attached.
+void engine_detach(GBCPU *cpu);
+
+// A VerifyEngine stepping the engine context points to.
+void engine_run(GBCPU *cpu, void *context);
+// The same, except that the JIT compiles every block on its first run, so
+// even a single instruction is checked in native code.
+void engine_run_eager(GBCPU *cpu, void *context);
+
+// seconds on the monotonic clock
+double now_s(void);
+
+// One step: an instruction in cpu_clock, or a block.
+static inline void engine_step(GBCPU *cpu, Engine engine) {
+    switch (engine) {
+    case ENGINE_BLOCKS:
+        block_run(cpu);
+        break;
+#ifdef GB_JIT
+    case ENGINE_JIT:
+        jit_run(cpu);
+        break;
+#endif
+    default:
+        cpu_clock(cpu, false, false);
+        break;
+    }
+}
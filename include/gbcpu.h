@@ -3,39 +3,42 @@
 
 #include "tools.h"
 
-typedef struct {
-    uint16_t not_used : 4;
-    uint16_t c : 1; // carry
-    uint16_t h : 1; // half carry
-    uint16_t n : 1; // subtract
-    uint16_t z : 1; // zero
-    uint16_t areg : 8;
-} Flags;
+// Register pairs overlay their two halves, low byte first. 16-bit operands
+// point straight at a pair, so the host has to be little-endian.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "cpu_registers needs a little-endian host"
+#endif
+
+// F is a plain byte, flags are tested and updated with whole-byte masks. The
+// low nibble is always 0.
+#define FLAG_Z 0x80 // zero
+#define FLAG_N 0x40 // subtract
+#define FLAG_H 0x20 // half carry
+#define FLAG_C 0x10 // carry
 
 typedef struct {
     union {
         uint16_t AF;
-        struct __attribute__((__packed__)) {
+        struct {
             uint8_t F;
             uint8_t A;
         };
-        Flags flags;
     };
-    union __attribute__((__packed__)) {
+    union {
         uint16_t BC;
         struct {
             uint8_t C;
             uint8_t B;
         };
     };
-    union __attribute__((__packed__)) {
+    union {
         uint16_t DE;
         struct {
             uint8_t E;
             uint8_t D;
         };
     };
-    union __attribute__((__packed__)) {
+    union {
         uint16_t HL;
         struct {
             uint8_t L;
@@ -46,24 +49,94 @@ typedef struct {
     uint16_t PC;
 } cpu_registers;
 
+_Static_assert(sizeof(cpu_registers) == 12, "cpu_registers must not be padded");
+
+// 0 or 1, for flags that feed into arithmetic
+static inline uint8_t get_flag(const cpu_registers *reg, uint8_t flag) {
+    return (reg->F & flag) != 0;
+}
+
+static inline void set_flag(cpu_registers *reg, uint8_t flag, bool value) {
+    reg->F = value ? reg->F | flag : reg->F & ~flag;
+}
+
+// 8-bit ALU operations record their operands instead of computing z, n, h
+// and c. F is only brought up to date by cpu_flags_sync when something
+// reads it: conditional jumps, PUSH AF, DAA, carry consumers and the
+// diagnostics. The low nibble of F is never touched by a pending operation.
+enum {
+    LAZY_NONE,
+    LAZY_ADD, // ADD, ADC
+    LAZY_SUB, // SUB, SBC, CP
+    LAZY_INC, // INC r, the c it keeps is in carry
+    LAZY_DEC, // DEC r, the c it keeps is in carry
+};
+
+typedef struct {
+    uint8_t op;
+    uint8_t a;
+    uint8_t b;
+    uint8_t carry;
+} LazyFlags;
+
 typedef struct {
     char *ptr;
     uint16_t addr;
     bool reg;
 } DataAccess;
 
+#define GBCPU_CACHE_LINE 64
+
+// The last HISTORY_SIZE instructions run by cpu_clock and block_step, as the
+// state before each one, stored by instruction_count. Recording is a few
+// stores; cpu_history_line formats an entry only when asked, for failure
+// context. Fused idioms, native JIT code and AOT blocks are not recorded.
+#define HISTORY_SIZE 64
+#define HISTORY_LINE_SIZE 128 // a formatted entry with its terminator
+
 typedef struct {
-    uint8_t memory[0x10000];
-    cpu_registers reg;
+    cpu_registers reg; // PC is the address of the instruction
+    LazyFlags lazy;    // F is resolved when formatting
+    uint8_t bytes[4];  // at PC, four for the Gameboy Doctor format
+} HistoryEntry;
+
+typedef struct BlockCache BlockCache;
+typedef struct Breakpoints Breakpoints;
+typedef struct CallStack CallStack;
+typedef struct MemStats MemStats;
+typedef struct Profile Profile;
+typedef struct WriteHash WriteHash;
+
+typedef struct {
+    // hot: touched by every instruction, fits in the first two cache lines
+    _Alignas(GBCPU_CACHE_LINE) cpu_registers reg;
+    LazyFlags lazy; // F is stale while lazy.op != LAZY_NONE
     bool ime;
-    size_t instruction_count;
+    bool crashed;
     uint8_t opcode;
+    uint8_t joypad;
+    size_t instruction_count;
+    size_t cycles;
     DataAccess src;
     DataAccess dst;
-    char debug[100];
-    char disassembly[100];
-    bool crashed;
+    BlockCache *blocks;       // NULL unless block_cache_attach was called
+    Breakpoints *breakpoints; // NULL unless breakpoints_attach was called
+    CallStack *calls;         // NULL unless callstack_attach was called
+    WriteHash *writes;        // NULL unless verify_attach was called
+
+    uint8_t memory[0x10000];
+
+    // cold: diagnostics, only touched when tracing or on serial output
+    char debug[HISTORY_LINE_SIZE];
+    char disassembly[HISTORY_LINE_SIZE];
     SerialBuffer buffer;
+    HistoryEntry history[HISTORY_SIZE];
+#ifdef GB_PROFILE
+    Profile *profile; // NULL unless set, see profile.h
+#endif
+#ifdef GB_STATS
+    MemStats *stats; // NULL unless set, see memstats.h
+#endif
 } GBCPU;
 
 typedef void (*Instruction)(GBCPU *cpu);
@@ -174,9 +247,58 @@ void cpu_initialize(GBCPU *cpu);
 void cpu_reset(GBCPU *cpu);
 uint8_t cpu_read(GBCPU *cpu);
 void cpu_clock(GBCPU *cpu, bool debug, bool disassembly);
+void cpu_serial_transfer(GBCPU *cpu);
+void cpu_infinite_loop(GBCPU *cpu, uint16_t addr);
 void cpu_push(GBCPU *cpu, uint8_t value);
+void cpu_flags_materialize(GBCPU *cpu);
+
+static inline void cpu_flags_sync(GBCPU *cpu) {
+    if (cpu->lazy.op != LAZY_NONE) {
+        cpu_flags_materialize(cpu);
+    }
+}
 uint8_t cpu_pop(GBCPU *cpu);
 
+// c as cpu_flags_sync would leave it, without materializing the rest of F
+static inline uint8_t cpu_flag_carry(const GBCPU *cpu) {
+    const LazyFlags *lazy = &cpu->lazy;
+    switch (lazy->op) {
+    case LAZY_ADD:
+        return lazy->a + lazy->b + lazy->carry > 0xFF;
+    case LAZY_SUB:
+        return lazy->a < lazy->b + lazy->carry;
+    case LAZY_INC:
+    case LAZY_DEC:
+        return lazy->carry;
+    }
+    return (cpu->reg.F & FLAG_C) != 0;
+}
+
+static inline void history_entry_capture(HistoryEntry *entry, const GBCPU *cpu, uint16_t addr) {
+    entry->reg = cpu->reg;
+    entry->reg.PC = addr;
+    entry->lazy = cpu->lazy;
+    for (uint16_t i = 0; i < 4; ++i) {
+        entry->bytes[i] = cpu->memory[(uint16_t)(addr + i)];
+    }
+}
+
+static inline void cpu_history_record(GBCPU *cpu, uint16_t addr) {
+    history_entry_capture(&cpu->history[cpu->instruction_count & (HISTORY_SIZE - 1)], cpu, addr);
+}
+
+// F with the pending lazy flags applied
+uint8_t history_entry_flags(const HistoryEntry *entry);
+
+// The text cpu_clock writes to disassembly and debug, for a recorded entry.
+// line has room for HISTORY_LINE_SIZE characters.
+void history_format_disassembly(const HistoryEntry *entry, size_t instruction, char *line);
+void history_format_doctor(const HistoryEntry *entry, char *line);
+
+// Formats the given instruction the way cpu_clock disassembles. Returns
+// false when it is no longer, or not yet, in the history.
+bool cpu_history_line(const GBCPU *cpu, size_t instruction, char *line);
+
 uint8_t cpu_read_from_src(GBCPU *cpu);
 uint8_t cpu_read_from_dst(GBCPU *cpu);
 uint16_t cpu_read_from_src_16(GBCPU *cpu);
@@ -241,18 +363,5 @@ void rra(GBCPU *cpu);
 void rrca(GBCPU *cpu);
 void stop(GBCPU *cpu);
 
-// CB Prefix
-void bit(GBCPU *cpu);
-void res(GBCPU *cpu);
-void set(GBCPU *cpu);
-void srl(GBCPU *cpu);
-void sla(GBCPU *cpu);
-void sra(GBCPU *cpu);
-void rr(GBCPU *cpu);
-void rrc(GBCPU *cpu);
-void rl(GBCPU *cpu);
-void rlc(GBCPU *cpu);
-void swap(GBCPU *cpu);
-
-const OpInstr opcodes[256];
-const OpInstr prefix_opcodes[256];
+extern const OpInstr opcodes[256];
+extern const OpInstr prefix_opcodes[256];
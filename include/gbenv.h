@@ -0,0 +1,63 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Embeddable stepping API for agents driving the emulator from a host
+// process. GBEnv is opaque; everything an agent observes is exposed as
+// pointers into the instance memory, valid until gb_env_destroy.
+
+#define GB_ENV_API_VERSION 1
+#define GB_ENV_MAX_RANGES 16
+#define GB_ENV_FRAME_CYCLES 70224
+
+// same bits as JOYPAD_* in joypad.h
+#define GB_ENV_BUTTON_NONE 0x00
+#define GB_ENV_BUTTON_RIGHT 0x01
+#define GB_ENV_BUTTON_LEFT 0x02
+#define GB_ENV_BUTTON_UP 0x04
+#define GB_ENV_BUTTON_DOWN 0x08
+#define GB_ENV_BUTTON_A 0x10
+#define GB_ENV_BUTTON_B 0x20
+#define GB_ENV_BUTTON_SELECT 0x40
+#define GB_ENV_BUTTON_START 0x80
+
+#if defined(_WIN32)
+#define GB_ENV_API __declspec(dllexport)
+#else
+#define GB_ENV_API __attribute__((visibility("default")))
+#endif
+
+typedef struct GBEnv GBEnv;
+
+typedef struct {
+    const uint8_t *ptr;
+    uint16_t start;
+    uint16_t length;
+} GBEnvRange;
+
+typedef struct {
+    // there is no PPU, so tile data, tile maps and OAM stand in for the frame
+    const uint8_t *vram; // $8000-$9FFF
+    const uint8_t *oam;  // $FE00-$FE9F
+    const uint8_t *memory;
+    GBEnvRange ranges[GB_ENV_MAX_RANGES];
+    size_t range_count;
+    // serial output since the last line break seen by the previous step, so a
+    // line stays observable for one step after it ends
+    const char *serial;
+    size_t frame; // emulated frames, including skipped ones
+    size_t cycles;
+    bool crashed;
+} GBEnvObservation;
+
+GB_ENV_API int gb_env_api_version(void);
+GB_ENV_API GBEnv *gb_env_create(const char *rom);
+GB_ENV_API void gb_env_destroy(GBEnv *env);
+GB_ENV_API void gb_env_reset(GBEnv *env);
+GB_ENV_API void gb_env_set_frame_skip(GBEnv *env, unsigned frame_skip);
+GB_ENV_API bool gb_env_observe_range(GBEnv *env, uint16_t start, uint16_t length);
+// Holds buttons (GB_ENV_BUTTON_* bits) for the given number of frames, each of them
+// 1 + frame_skip emulated frames long. Returns the frames run before a crash.
+GB_ENV_API size_t gb_env_step(GBEnv *env, uint8_t buttons, size_t frames);
+GB_ENV_API const GBEnvObservation *gb_env_observe(GBEnv *env);
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blocks.h"
+#include "gbcpu.h"
+
+// x86-64 recompiler for hot blocks of the block cache, Linux only and only
+// built with -DGB_JIT=ON. A block is compiled after it ran JIT_HOT_THRESHOLD
+// times. Guest A, F, B, C, D, E, H and L live in r8-r15 while native code
+// runs. Register and immediate loads, 8-bit ALU, INC/DEC r, flag operations,
+// (HL) reads outside the I/O page and static jumps are translated. The flags
+// of an ALU operation are only computed when the next instruction does not
+// overwrite them. Everything else calls back into block_step, which also
+// catches self-modifying code through the block cache invalidation.
+
+#define JIT_HOT_THRESHOLD 16
+#define JIT_ARENA_SIZE (4 * 1024 * 1024)
+
+typedef struct {
+    uint8_t *code;
+    size_t used;
+    size_t compiled;
+    size_t native_runs;
+} JitArena;
+
+void jit_attach(GBCPU *cpu);
+void jit_detach(GBCPU *cpu);
+void jit_run(GBCPU *cpu);
+JitArena *jit_arena(GBCPU *cpu);
@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+
+#include "gbcpu.h"
+
+#define JOYPAD_RIGHT 0x01
+#define JOYPAD_LEFT 0x02
+#define JOYPAD_UP 0x04
+#define JOYPAD_DOWN 0x08
+#define JOYPAD_A 0x10
+#define JOYPAD_B 0x20
+#define JOYPAD_SELECT 0x40
+#define JOYPAD_START 0x80
+
+void joypad_set(GBCPU *cpu, uint8_t buttons);
+void joypad_update(GBCPU *cpu);
+uint8_t joypad_parse(const char *buttons);
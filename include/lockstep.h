@@ -0,0 +1,54 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gbcpu.h"
+
+// Runs up to LOCKSTEP_LANES instances of the same ROM in lockstep. Registers
+// are kept in structure-of-arrays form so register-only instructions execute
+// once for all lanes with vector instructions. Any other instruction steps
+// every lane through cpu_clock. Lanes that diverge (different PC or opcode)
+// step through cpu_clock lowest PC first, so the lanes behind catch up and
+// the lanes reconverge.
+
+#ifndef LOCKSTEP_LANES
+#define LOCKSTEP_LANES 16
+#endif
+
+typedef uint8_t lane_u8 __attribute__((vector_size(LOCKSTEP_LANES)));
+typedef uint16_t lane_u16 __attribute__((vector_size(LOCKSTEP_LANES * 2)));
+
+// index into Lockstep.r, matches the SM83 register encoding with F in the
+// (HL) slot
+#define LANE_B 0
+#define LANE_C 1
+#define LANE_D 2
+#define LANE_E 3
+#define LANE_H 4
+#define LANE_L 5
+#define LANE_F 6
+#define LANE_A 7
+
+typedef struct {
+    uint8_t kind;
+    uint8_t src;
+    uint8_t dst;
+    uint8_t length;
+} LaneOp;
+
+typedef struct {
+    lane_u8 r[8];
+    lane_u16 sp;
+    lane_u16 pc;
+    GBCPU *cpus[LOCKSTEP_LANES];
+    size_t lanes;
+    LaneOp ops[256];
+    size_t vector_steps;
+    size_t scalar_steps;
+} Lockstep;
+
+void lockstep_initialize(Lockstep *lockstep, GBCPU **cpus, size_t lanes);
+void lockstep_step(Lockstep *lockstep);
+void lockstep_sync(Lockstep *lockstep);
+bool lockstep_vectorizable(uint8_t opcode);
@@ -0,0 +1,80 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gbcpu.h"
+
+// Guest memory access statistics, only built with -DGB_STATS=ON. Every byte
+// read or written through the bus accessors (cpu_read_from_*,
+// cpu_write_to_*, cpu_push and cpu_pop) is counted in a 64K heatmap.
+// Opcode fetches are not counted, immediate operands are, as reads of the
+// bytes that follow the opcode. The per-region and per-I/O-register totals are
+// sums over the heatmap, so a hook is a single increment. Fused idioms,
+// native JIT code and AOT blocks access memory directly and are not seen.
+// Without GB_STATS the hooks are empty and GBCPU has no stats pointer.
+//
+// Stats are attached with cpu->stats = stats after cpu_initialize; several
+// CPUs may share them only when they run on the same thread.
+
+#ifdef GB_STATS
+
+typedef enum {
+    REGION_ROM0,
+    REGION_ROM1,
+    REGION_VRAM,
+    REGION_EXTERNAL,
+    REGION_WRAM,
+    REGION_ECHO,
+    REGION_OAM,
+    REGION_UNUSABLE,
+    REGION_IO,
+    REGION_HRAM,
+    REGION_IE,
+    REGION_COUNT,
+} MemRegion;
+
+extern const char *const memstats_region_names[REGION_COUNT];
+
+MemRegion memstats_region(uint16_t addr);
+// the register's name, NULL for addresses outside $FF00-$FF7F and unnamed ones
+const char *memstats_io_name(uint16_t addr);
+
+struct MemStats {
+    uint64_t reads[0x10000];
+    uint64_t writes[0x10000];
+};
+
+MemStats *memstats_create(void);
+void memstats_merge(MemStats *into, const MemStats *from);
+void memstats_regions(const MemStats *stats, uint64_t reads[REGION_COUNT], uint64_t writes[REGION_COUNT]);
+// region totals and the I/O registers that were accessed
+void memstats_report(const MemStats *stats, FILE *out);
+// the heatmap, one line per address that was accessed
+bool memstats_write_csv(const MemStats *stats, const char *file);
+
+static inline void memstats_read(GBCPU *cpu, uint16_t addr) {
+    if (cpu->stats) {
+        cpu->stats->reads[addr]++;
+    }
+}
+
+static inline void memstats_write(GBCPU *cpu, uint16_t addr) {
+    if (cpu->stats) {
+        cpu->stats->writes[addr]++;
+    }
+}
+
+#else
+
+static inline void memstats_read(GBCPU *cpu, uint16_t addr) {
+    (void)cpu;
+    (void)addr;
+}
+
+static inline void memstats_write(GBCPU *cpu, uint16_t addr) {
+    (void)cpu;
+    (void)addr;
+}
+
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gbcpu.h"
+
+// Per-opcode execution profile, only built with -DGB_PROFILE=ON. Every
+// instruction run by cpu_clock or block_step is counted together with its
+// guest cycles, and one in interval instructions is timed on the host around
+// the addressing modes and the handler. Fused idioms and native JIT code are
+// not seen, BlockCache keeps its own counters for those. Without GB_PROFILE
+// none of this is compiled and GBCPU has no profile pointer.
+//
+// A profile is attached with cpu->profile = profile after cpu_initialize;
+// several CPUs may share one only when they run on the same thread.
+
+#ifdef GB_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+typedef struct {
+    uint64_t count;
+    uint64_t cycles;  // guest cycles
+    uint64_t samples; // executions that were timed
+    uint64_t ticks;   // host ticks spent in the timed executions
+} ProfileEntry;
+
+struct Profile {
+    uint32_t interval;
+    uint32_t countdown;
+    ProfileEntry ops[2][0x100]; // [prefixed][opcode]
+};
+
+Profile *profile_create(uint32_t interval);
+void profile_merge(Profile *into, const Profile *from);
+// opcodes sorted by estimated host time, the top ones only when top > 0
+void profile_report(const Profile *profile, FILE *out, size_t top);
+bool profile_write_csv(const Profile *profile, const char *file);
+
+// rdtsc where there is one, nanoseconds otherwise
+static inline uint64_t profile_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+// Returns the start time when this execution is sampled, 0 otherwise.
+static inline uint64_t profile_begin(Profile *profile) {
+    if (profile == NULL || --profile->countdown > 0) {
+        return 0;
+    }
+    profile->countdown = profile->interval;
+    return profile_ticks();
+}
+
+static inline void profile_end(Profile *profile, bool prefixed, uint8_t opcode, uint8_t cycles, uint64_t start) {
+    if (profile == NULL) {
+        return;
+    }
+    ProfileEntry *entry = &profile->ops[prefixed][opcode];
+    entry->count++;
+    entry->cycles += cycles;
+    if (start) {
+        entry->samples++;
+        entry->ticks += profile_ticks() - start;
+    }
+}
+
+#endif
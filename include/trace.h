@@ -0,0 +1,52 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gbcpu.h"
+
+// Binary instruction traces. A trace file is a TraceHeader followed by one
+// HistoryEntry per instruction, in the byte order of the host that wrote it,
+// so instruction n is at a fixed offset. trace_sync copies the entries
+// cpu_clock and block_step recorded in cpu->history since the last call into
+// a buffer, and a background thread writes full buffers while the next one
+// fills. Formatting is left to gbtrace.
+//
+// trace_sync has to be called at least every HISTORY_SIZE instructions, and
+// the CPU has to record every instruction it runs: cpu_clock or a block cache
+// without fused idioms.
+
+#define TRACE_MAGIC "GBTR"
+#define TRACE_VERSION 1
+#define TRACE_BUFFER_ENTRIES 0x4000
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t entry_size;
+    uint64_t first; // instruction_count of the first entry
+} TraceHeader;
+
+typedef struct TraceWriter TraceWriter;
+
+// Starts tracing at cpu->instruction_count. Returns NULL when the file
+// cannot be written or the writer thread cannot be started.
+TraceWriter *trace_open(const char *file, const GBCPU *cpu);
+// Returns false once instructions were lost or a write failed; the file then
+// ends before the first missing instruction.
+bool trace_sync(TraceWriter *trace, const GBCPU *cpu);
+// Writes what is buffered and closes the file, false if anything failed.
+bool trace_close(TraceWriter *trace);
+
+typedef struct {
+    FILE *file;
+    TraceHeader header;
+    uint64_t count; // entries in the file
+    uint64_t next;  // instruction trace_next returns
+} TraceReader;
+
+TraceReader *trace_reader_open(const char *file);
+void trace_reader_close(TraceReader *reader);
+// Positions the reader at an instruction, false if it is not in the file.
+bool trace_seek(TraceReader *reader, uint64_t instruction);
+bool trace_next(TraceReader *reader, HistoryEntry *entry, uint64_t *instruction);
@@ -0,0 +1,98 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gbcpu.h"
+#include "verify.h"
+
+// Single-instruction test vectors. For every defined opcode, unprefixed and
+// CB prefixed, a batch of random starting states is run through one
+// instruction and the result is compared with a golden file written once by
+// cpu_clock. A regression in any engine shows up as the opcode whose vectors
+// fail, with the first failing state.
+//
+// A starting state is random registers and flags, IME, and random bytes for
+// everything the instruction can read: its operands at PC, the stack at SP
+// and the byte at HL, BC, DE, (nn), ($FF00+n) or ($FF00+C) when it goes
+// through that operand. Those pointers are kept in WRAM and HRAM, so no
+// store reaches the I/O page or ROM; PC and SP are always in WRAM. The state
+// is generated from (seed, opcode, index), so the file only holds the
+// results.
+//
+// The file is a VectorsHeader followed by one record per vector, little
+// endian, each a delta against its starting state:
+//   changed   bit 0-5: AF, BC, DE, HL, SP, PC differ (PC from PC + length)
+//             bit 6: IME toggled, bit 7: crashed
+//   timing    cycles in bit 0-5, number of stores in bit 6-7
+//   values    the changed registers, 16 bits each, in the order above
+//   stores    address (16 bits) and value of each store, in order
+// Most vectors are 4 to 6 bytes. The file is memory mapped and the records
+// of an opcode are decoded while its vectors run.
+
+#define VECTORS_MAGIC "GBIV"
+#define VECTORS_VERSION 1
+#define VECTORS_PER_OPCODE 64 // what gb_vectors writes by default
+#define VECTOR_OPCODES 0x200  // unprefixed, then CB prefixed at 0x100 + opcode
+#define VECTOR_BYTES 8        // memory bytes a starting state sets
+#define VECTOR_MAX_STORES 3
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t per_opcode;
+    uint64_t seed;
+    uint32_t offsets[VECTOR_OPCODES + 1]; // of the records of each opcode
+} VectorsHeader;
+
+typedef struct {
+    cpu_registers reg;
+    bool ime;
+    uint8_t length; // of the instruction, with the prefix
+    uint8_t count;  // bytes set
+    uint16_t addr[VECTOR_BYTES];
+    uint8_t value[VECTOR_BYTES];
+} VectorInput;
+
+typedef struct {
+    cpu_registers reg; // F resolved
+    bool ime;
+    bool crashed;
+    uint8_t cycles;
+    uint8_t stores;
+    uint16_t store_addr[VECTOR_MAX_STORES];
+    uint8_t store_value[VECTOR_MAX_STORES];
+    size_t instructions; // always 1 for a correct engine
+} VectorResult;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    const VectorsHeader *header;
+} Vectors;
+
+// Whether an opcode index has vectors: it is defined in the opcode tables
+// and is not the CB prefix itself.
+bool vector_opcode_defined(unsigned opcode);
+
+void vector_input(uint64_t seed, unsigned opcode, unsigned index, VectorInput *input);
+
+// Loads the input into cpu, runs one engine step (cpu_clock, block_run,
+// jit_run, ...) and reads the result back. The memory bytes of the input and
+// the stores are cleared again afterwards, so the rest of cpu->memory stays
+// 0. With a block cache attached, breakpoints are attached too and one is
+// set after the instruction, which makes the instruction a block of its own.
+void vector_run(GBCPU *cpu, const VectorInput *input, VerifyEngine run, void *context, VectorResult *result);
+
+// Runs per_opcode vectors of every opcode through cpu_clock and writes
+// their results. Returns false when the file could not be written.
+bool vectors_write(const char *file, uint64_t seed, unsigned per_opcode);
+
+Vectors *vectors_open(const char *file);
+void vectors_close(Vectors *vectors);
+
+// Runs every vector of an opcode through the engine on cpu, which has to
+// be set up as for vector_run. Returns the number of vectors that differ and
+// reports the first of them to out, when out is not NULL.
+size_t vectors_check(const Vectors *vectors, GBCPU *cpu, unsigned opcode, VerifyEngine run, void *context, FILE *out);
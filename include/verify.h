@@ -0,0 +1,94 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gbcpu.h"
+
+// Differential verification of an execution engine against cpu_clock. Two
+// instances start from the same state; after every step of the engine (one
+// block_run, jit_run, ... call) the reference runs cpu_clock up to the same
+// instruction count and both are compared: registers with F resolved, IME,
+// the crash flag, cycles and a hash of the memory writes so far.
+//
+// Memory is not compared byte by byte. Once verify_attach was called, every
+// bus store (cpu_write_to_dst, cpu_write_to_dst_16, cpu_push) and every byte
+// a fused fill or copy loop stores is added to a WriteHash. The hash is a
+// sum over (address, value) pairs, so it does not depend on the order of
+// the stores inside a step, which a fused loop does not keep.
+//
+// On the first divergence verify_report prints both states, the first byte
+// of memory that differs and the last instructions both instances ran, in
+// the disassembler's format.
+
+#define VERIFY_HISTORY 8 // instructions shown before a divergence
+#define WRITE_LOG 4       // stores WriteHash keeps in order
+
+struct WriteHash {
+    uint64_t hash;
+    uint64_t count;
+    // the first WRITE_LOG stores since count was 0, for checks of a single
+    // instruction (see vectors.h)
+    uint16_t log_addr[WRITE_LOG];
+    uint8_t log_value[WRITE_LOG];
+};
+
+typedef void (*VerifyEngine)(GBCPU *cpu, void *context);
+
+typedef struct {
+    GBCPU *reference; // runs cpu_clock
+    GBCPU *engine;
+    VerifyEngine run;
+    void *context;
+    size_t steps;
+    size_t synced; // instruction count before the last step
+    bool diverged;
+    char line[SERIAL_BUFFER_SIZE]; // the last serial line verify_run compared
+} Verifier;
+
+// Starts hashing the stores of both instances, which have to hold the same
+// state already. The engine is attached to its instance by the caller.
+void verify_attach(Verifier *verifier, GBCPU *reference, GBCPU *engine, VerifyEngine run, void *context);
+void verify_detach(Verifier *verifier);
+
+// Runs one engine step and compares. Returns false on a divergence.
+bool verify_step(Verifier *verifier);
+// Steps until the engine crashes, diverges or has run the given number of
+// instructions (0 for no limit). Serial output is compared and cleared at
+// every line end, the line is kept in verifier->line. Returns false on a
+// divergence.
+bool verify_run(Verifier *verifier, size_t instructions);
+bool verify_same_state(GBCPU *a, GBCPU *b);
+void verify_report(const Verifier *verifier, FILE *out);
+
+// A random program at addr, size bytes long, of loads, ALU and CB
+// operations, INC/DEC, stack operations, (HL) accesses and short forward
+// JRs, ending in an infinite loop. $D000-$DFFF is filled with random data,
+// and HL and SP start in it far enough above the program that no store
+// reaches the program for sizes up to $400. Loads through BC and DE read
+// anywhere. The same seed gives the same program.
+void verify_random_program(GBCPU *cpu, uint64_t seed, uint16_t addr, size_t size);
+
+static inline uint64_t write_hash_mix(uint64_t x) {
+    // splitmix64 finalizer
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static inline void write_hash_add(WriteHash *writes, uint16_t addr, uint8_t value) {
+    writes->hash += write_hash_mix(((uint64_t)addr << 8 | value) + 0x9E3779B97F4A7C15ull);
+    if (writes->count < WRITE_LOG) {
+        writes->log_addr[writes->count] = addr;
+        writes->log_value[writes->count] = value;
+    }
+    writes->count++;
+}
+
+// Called on every bus store.
+static inline void verify_store(GBCPU *cpu, uint16_t addr, uint8_t value) {
+    if (cpu->writes) {
+        write_hash_add(cpu->writes, addr, value);
+    }
+}
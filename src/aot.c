@@ -0,0 +1,96 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "aot.h"
+#include "breakpoints.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+AotRuntime *aot_attach_module(const AotModule *module) {
+    if (module->version != AOT_VERSION) {
+        fprintf(stderr, "AOT module version %u, expected %u\n", module->version, AOT_VERSION);
+        return NULL;
+    }
+
+    AotRuntime *aot = calloc(1, sizeof(AotRuntime));
+    aot->module = module;
+    for (uint32_t i = 0; i < module->count; ++i) {
+        const AotBlock *block = &module->blocks[i];
+        if (block->start < 0x8000) {
+            aot->entry[block->start] = block;
+        }
+    }
+    return aot;
+}
+
+AotRuntime *aot_load(const char *path) {
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf(stderr, "%s\n", dlerror());
+        return NULL;
+    }
+    const AotModule *module = dlsym(handle, "gb_aot_module");
+    AotRuntime *aot = module ? aot_attach_module(module) : NULL;
+    if (aot == NULL) {
+        dlclose(handle);
+        return NULL;
+    }
+    aot->handle = handle;
+    return aot;
+}
+
+void aot_unload(AotRuntime *aot) {
+    if (aot->handle) {
+        dlclose(aot->handle);
+    }
+    free(aot);
+}
+
+// whether a breakpoint falls inside the block, past its start
+static bool breakpoint_inside(const GBCPU *cpu, const AotBlock *block) {
+    if (cpu->breakpoints == NULL || cpu->breakpoints->pc_count == 0) {
+        return false;
+    }
+    for (uint32_t addr = block->start + 1; addr < (uint32_t)block->start + block->length; ++addr) {
+        if (breakpoint_at(cpu->breakpoints, addr)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool aot_run(const AotRuntime *aot, GBCPU *cpu) {
+    if (breakpoints_check(cpu)) {
+        return false;
+    }
+    uint16_t pc = cpu->reg.PC;
+    const AotBlock *block = pc < 0x8000 ? aot->entry[pc] : NULL;
+    if (block == NULL || memcmp(&cpu->memory[pc], block->bytes, block->length) != 0 ||
+        breakpoint_inside(cpu, block)) {
+        cpu_clock(cpu, false, false);
+        return false;
+    }
+    block->run(cpu);
+    return true;
+}
+
+bool aot_retire(GBCPU *cpu, const OpInstr *instr, uint16_t addr, uint16_t next, const uint8_t *rest,
+                uint16_t rest_length) {
+    cpu->cycles += instr->cycles;
+
+    if (cpu->memory[0xFF02] == 0x81) {
+        cpu_serial_transfer(cpu);
+    }
+    if (addr == cpu->reg.PC) {
+        cpu->disassembly[0] = '\0';
+        cpu_infinite_loop(cpu, addr);
+    }
+    cpu->instruction_count++;
+
+    // leave on a taken branch, an interrupt raised through $FF0F, or a
+    // store into the part of the block that has not run yet
+    return cpu->reg.PC == next && !cpu->crashed &&
+           (rest_length == 0 || memcmp(&cpu->memory[next], rest, rest_length) == 0);
+}
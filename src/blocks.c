@@ -0,0 +1,631 @@
+#include "blocks.h"
+#include "breakpoints.h"
+#include "profile.h"
+#include "verify.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *const block_fuse_names[FUSE_COUNT] = {
+    [FUSE_NONE] = "none",
+    [FUSE_DEC_JR] = "DEC r; JR NZ",
+    [FUSE_POLL] = "LDH A,(n); AND n; JR",
+    [FUSE_COPY] = "copy loop",
+    [FUSE_COPY_R] = "short copy loop",
+    [FUSE_FILL] = "fill loop",
+    [FUSE_FILL_BC] = "long fill loop",
+    [FUSE_FILL_H] = "fill to an H boundary",
+};
+
+static bool ends_block(Instruction f) {
+    return f == jp || f == jp_c || f == jp_nc || f == jp_nz || f == jp_z ||
+           f == jr || f == jr_c || f == jr_nc || f == jr_nz || f == jr_z ||
+           f == call || f == call_c || f == call_nc || f == call_nz || f == call_z ||
+           f == ret || f == ret_c || f == ret_nc || f == ret_nz || f == ret_z ||
+           f == reti || f == rst || f == stop;
+}
+
+static bool dynamic_operand(AddrModeFunc func) {
+    // these read registers, everything else only depends on the instruction
+    // bytes; AF has to bring F up to date first
+    return func == reg_bc_ptr || func == reg_de_ptr || func == reg_hl_ptr || func == reg_c_ptr ||
+           func == reg_af;
+}
+
+static AddrModeFunc resolve_operand(GBCPU *cpu, AddrModeFunc func, DataAccess *data_access) {
+    if (dynamic_operand(func)) {
+        memset(data_access, 0, sizeof(DataAccess));
+        return func;
+    }
+    func(cpu, data_access);
+    return NULL;
+}
+
+static bool is_op(const BlockInstr *d, uint8_t opcode) {
+    return d->instr == &opcodes[opcode];
+}
+
+static bool is_cb(const BlockInstr *d, uint8_t opcode) {
+    return d->instr == &prefix_opcodes[opcode];
+}
+
+static bool is_store_hl(const BlockInstr *d) {
+    return is_op(d, 0x22) || is_op(d, 0x32);
+}
+
+static bool is_dec(const BlockInstr *d, uint8_t first, uint8_t last) {
+    // DEC r for the registers from first to last in B, C, D, E, H, L order
+    return d->instruction == dec_8 && d->write_func == NULL && d->opcode >= first && d->opcode <= last &&
+           (d->opcode & 0x07) == 0x05;
+}
+
+static uint16_t jr_target(const BlockInstr *d) {
+    return d->next + (int8_t)*d->src.ptr;
+}
+
+// fill and copy loops, only called for self-loops
+static uint8_t match_bulk(const BlockInstr *d, uint8_t left) {
+    bool nz = is_op(&d[left - 1], 0x20);
+
+    if (left == 3 && is_store_hl(d) && is_dec(&d[1], 0x05, 0x1D) && nz) {
+        return FUSE_FILL;
+    }
+    if (left == 3 && is_store_hl(d) && is_cb(&d[1], 0x44 | (d[1].opcode & 0x38))) {
+        return FUSE_FILL_H;
+    }
+    if (left == 5 && is_op(d, 0x2A) && is_op(&d[1], 0x12) && is_op(&d[2], 0x13) &&
+        is_dec(&d[3], 0x05, 0x0D) && nz) {
+        return FUSE_COPY_R;
+    }
+    if (left == 6 && (is_op(d, 0xAF) || is_op(d, 0x3E)) && is_store_hl(&d[1]) && is_op(&d[2], 0x0B) &&
+        is_op(&d[3], 0x78) && is_op(&d[4], 0xB1) && nz) {
+        return FUSE_FILL_BC;
+    }
+    return FUSE_NONE;
+}
+
+static uint8_t match_fuse(const BlockInstr *d, uint8_t left) {
+    // every pattern ends in the JR that ends the block; a JR onto itself is
+    // left to the infinite loop check in block_step
+    const BlockInstr *jr = &d[left - 1];
+    if (!(is_op(jr, 0x20) || is_op(jr, 0x28)) || jr_target(jr) == jr->addr) {
+        return FUSE_NONE;
+    }
+    if (jr_target(jr) == d->addr) {
+        uint8_t bulk = match_bulk(d, left);
+        if (bulk != FUSE_NONE) {
+            return bulk;
+        }
+    }
+
+    if (left == 2 && d->instruction == dec_8 && d->write_func == NULL && is_op(jr, 0x20)) {
+        return FUSE_DEC_JR;
+    }
+    if (left == 3 && is_op(d, 0xF0) && is_op(&d[1], 0xE6)) {
+        return FUSE_POLL;
+    }
+    if (left == 7 && is_op(d, 0x2A) && is_op(&d[1], 0x12) && is_op(&d[2], 0x13) && is_op(&d[3], 0x0B) &&
+        is_op(&d[4], 0x78) && is_op(&d[5], 0xB1) && is_op(jr, 0x20)) {
+        return FUSE_COPY;
+    }
+    return FUSE_NONE;
+}
+
+static void fuse_block(BlockInstr *instrs, uint8_t count) {
+    for (uint8_t i = 0; i < count; ++i) {
+        BlockInstr *d = &instrs[i];
+        d->fuse = match_fuse(d, count - i);
+        if (d->fuse != FUSE_NONE) {
+            for (uint8_t j = i; j < count; ++j) {
+                d->fuse_cycles += instrs[j].cycles;
+            }
+            break;
+        }
+    }
+}
+
+static void mark_code(BlockCache *cache, uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr < end; ++addr) {
+        cache->code[addr >> 3] |= 1 << (addr & 0x07);
+    }
+}
+
+static Block *decode_block(GBCPU *cpu, BlockCache *cache, uint16_t pc) {
+    BlockInstr instrs[BLOCK_MAX_INSTRUCTIONS];
+    uint8_t count = 0;
+    uint32_t addr = pc;
+    uint16_t saved_pc = cpu->reg.PC;
+
+    while (count < BLOCK_MAX_INSTRUCTIONS && addr + 3 <= 0x10000) {
+        if (count > 0 && cpu->breakpoints && breakpoint_at(cpu->breakpoints, addr)) {
+            // breakpoints are only checked between blocks
+            break;
+        }
+        uint8_t opcode = cpu->memory[addr];
+        const OpInstr *instr = &opcodes[opcode];
+        uint32_t operands = addr + 1;
+        if (opcode == 0xCB) {
+            opcode = cpu->memory[addr + 1];
+            instr = &prefix_opcodes[opcode];
+            operands = addr + 2;
+        }
+        if (instr->instruction == NULL) {
+            // leave the crash report to cpu_clock
+            break;
+        }
+
+        // run the addressing modes once, the same way cpu_clock would, and
+        // count the bytes they consume rather than trusting the table length
+        BlockInstr *d = &instrs[count++];
+        cpu->reg.PC = operands;
+        d->read_func = resolve_operand(cpu, instr->read_mode.addr_mode_func, &d->src);
+        d->write_func = resolve_operand(cpu, instr->write_mode.addr_mode_func, &d->dst);
+        d->instruction = instr->instruction;
+        d->instr = instr;
+        d->addr = addr;
+        d->next = cpu->reg.PC;
+        d->opcode = opcode;
+        d->cycles = instr->cycles;
+        d->fuse = FUSE_NONE;
+        d->fuse_cycles = 0;
+
+        addr = operands + (uint16_t)(cpu->reg.PC - operands);
+        if (ends_block(instr->instruction)) {
+            break;
+        }
+    }
+    cpu->reg.PC = saved_pc;
+
+    if (count == 0) {
+        return NULL;
+    }
+    if (cpu->breakpoints == NULL || !breakpoint_at(cpu->breakpoints, pc)) {
+        // a fused self-loop would pass its breakpoint without stopping
+        fuse_block(instrs, count);
+    }
+
+    Block *block = malloc(sizeof(Block) + count * sizeof(BlockInstr));
+    memcpy(block->instrs, instrs, count * sizeof(BlockInstr));
+    block->count = count;
+    block->start = pc;
+    block->end = addr;
+    block->valid = true;
+    block->hits = 0;
+    block->native = NULL;
+    mark_code(cache, block->start, block->end);
+
+    BlockPage *page = cache->pages[pc >> 8];
+    if (page == NULL) {
+        page = calloc(1, sizeof(BlockPage));
+        cache->pages[pc >> 8] = page;
+    }
+    page->blocks[pc & 0xFF] = block;
+    block->next = page->chain;
+    page->chain = block;
+
+    cache->decoded++;
+    return block;
+}
+
+static void invalidate_page(BlockCache *cache, BlockPage *page, uint16_t addr) {
+    Block **link = &page->chain;
+    while (*link) {
+        Block *block = *link;
+        if (addr >= block->start && addr < block->end) {
+            *link = block->next;
+            page->blocks[block->start & 0xFF] = NULL;
+            block->valid = false;
+            block->next = cache->retired;
+            cache->retired = block;
+            cache->invalidated++;
+        } else {
+            link = &block->next;
+        }
+    }
+}
+
+void block_cache_write(BlockCache *cache, uint16_t addr) {
+    if (!(cache->code[addr >> 3] & (1 << (addr & 0x07)))) {
+        return;
+    }
+
+    // blocks are far shorter than a page, so only blocks starting in this
+    // page or the one before can cover addr
+    uint8_t page = addr >> 8;
+    if (cache->pages[page]) {
+        invalidate_page(cache, cache->pages[page], addr);
+    }
+    if (page > 0 && cache->pages[page - 1]) {
+        invalidate_page(cache, cache->pages[page - 1], addr);
+    }
+}
+
+static void free_chain(Block *block) {
+    while (block) {
+        Block *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void block_cache_flush(BlockCache *cache) {
+    for (size_t i = 0; i < 0x100; ++i) {
+        if (cache->pages[i]) {
+            free_chain(cache->pages[i]->chain);
+            free(cache->pages[i]);
+            cache->pages[i] = NULL;
+        }
+    }
+    free_chain(cache->retired);
+    cache->retired = NULL;
+    memset(cache->code, 0, sizeof(cache->code));
+}
+
+void block_cache_attach(GBCPU *cpu) {
+    if (cpu->blocks == NULL) {
+        cpu->blocks = calloc(1, sizeof(BlockCache));
+        cpu->blocks->deadline = SIZE_MAX;
+    }
+}
+
+void block_cache_detach(GBCPU *cpu) {
+    if (cpu->blocks) {
+        block_cache_flush(cpu->blocks);
+        free(cpu->blocks);
+        cpu->blocks = NULL;
+    }
+}
+
+Block *block_lookup(GBCPU *cpu) {
+    BlockCache *cache = cpu->blocks;
+    if (cache->retired) {
+        free_chain(cache->retired);
+        cache->retired = NULL;
+    }
+
+    uint16_t pc = cpu->reg.PC;
+    BlockPage *page = cache->pages[pc >> 8];
+    Block *block = page ? page->blocks[pc & 0xFF] : NULL;
+    if (block == NULL) {
+        block = decode_block(cpu, cache, pc);
+    }
+    return block;
+}
+
+bool block_step(GBCPU *cpu, const Block *block, const BlockInstr *d) {
+    cpu_history_record(cpu, d->addr);
+    cpu->reg.PC = d->next;
+    cpu->opcode = d->opcode;
+
+#ifdef GB_PROFILE
+    uint64_t start = profile_begin(cpu->profile);
+#endif
+    if (d->read_func) {
+        d->read_func(cpu, &cpu->src);
+    } else {
+        cpu->src = d->src;
+    }
+    if (d->write_func) {
+        d->write_func(cpu, &cpu->dst);
+    } else {
+        cpu->dst = d->dst;
+    }
+    d->instruction(cpu);
+    cpu->cycles += d->cycles;
+#ifdef GB_PROFILE
+    profile_end(cpu->profile, d->instr == &prefix_opcodes[d->opcode], d->opcode, d->cycles, start);
+#endif
+
+    if (cpu->memory[0xFF02] == 0x81) {
+        cpu_serial_transfer(cpu);
+    }
+    if (d->addr == cpu->reg.PC) {
+        cpu->disassembly[0] = '\0';
+        cpu_infinite_loop(cpu, d->addr);
+    }
+    cpu->instruction_count++;
+
+    // leave on a taken branch, an interrupt raised through $FF0F, or a
+    // write that invalidated the block being run
+    return cpu->reg.PC == d->next && !cpu->crashed && block->valid;
+}
+
+static bool is_code(const BlockCache *cache, uint16_t addr) {
+    return cache->code[addr >> 3] & (1 << (addr & 0x07));
+}
+
+// how many passes of a fused pattern fit before the deadline
+static size_t fuse_budget(const GBCPU *cpu, const BlockInstr *d) {
+    size_t deadline = cpu->blocks->deadline;
+    return cpu->cycles < deadline ? (deadline - cpu->cycles) / d->fuse_cycles : 0;
+}
+
+static void fuse_finish(GBCPU *cpu, const BlockInstr *first, const BlockInstr *jr, bool taken, size_t passes) {
+    size_t count = jr - first + 1;
+    cpu->reg.PC = taken ? jr_target(jr) : jr->next;
+    cpu->opcode = jr->opcode;
+    cpu->src = jr->src;
+    cpu->dst = jr->dst;
+    cpu->cycles += first->fuse_cycles * passes;
+    cpu->instruction_count += count * passes;
+    cpu->blocks->fused[first->fuse] += count * passes;
+}
+
+// passes of a loop counted down by DEC r, capped by the deadline
+static size_t dec_passes(const GBCPU *cpu, const BlockInstr *d, uint8_t count) {
+    size_t passes = count ? count : 0x100;
+    size_t budget = fuse_budget(cpu, d);
+    return passes < budget ? passes : budget;
+}
+
+static void dec_reg(GBCPU *cpu, uint8_t *reg, size_t passes) {
+    // only the last DEC is recorded, with the c they all kept
+    uint8_t carry = cpu_flag_carry(cpu);
+    uint8_t last = *reg - (passes - 1);
+    *reg = last - 1;
+    cpu->lazy.op = LAZY_DEC;
+    cpu->lazy.a = last;
+    cpu->lazy.carry = carry;
+}
+
+static bool fuse_dec_jr(GBCPU *cpu, const BlockInstr *d) {
+    const BlockInstr *jr = &d[1];
+    uint8_t *reg = (uint8_t *)d->dst.ptr;
+    // a self-loop ends when the register reaches 0
+    size_t passes = dec_passes(cpu, d, jr_target(jr) == d->addr ? *reg : 1);
+    if (passes == 0) {
+        return false;
+    }
+
+    dec_reg(cpu, reg, passes);
+    fuse_finish(cpu, d, jr, *reg != 0, passes);
+    return true;
+}
+
+static bool fuse_poll(GBCPU *cpu, const BlockInstr *d) {
+    const BlockInstr *jr = &d[2];
+    if (fuse_budget(cpu, d) == 0) {
+        return false;
+    }
+
+    // LDH A,(n) goes through the bus, the immediates of AND n and JR are
+    // plain reads from the instruction bytes
+    cpu->src = d->src;
+    cpu->dst = d->dst;
+    uint8_t value = cpu_read_from_src(cpu) & *(uint8_t *)d[1].src.ptr;
+    cpu->reg.A = value;
+    cpu->reg.F = (value == 0) << 7 | 0x20;
+    cpu->lazy.op = LAZY_NONE;
+    fuse_finish(cpu, d, jr, is_op(jr, 0x28) == (value == 0), 1);
+    return true;
+}
+
+static bool plain_source(uint16_t start, size_t length) {
+    // ROM, VRAM, external RAM and WRAM reads have no side effects, neither
+    // has HRAM
+    uint32_t end = start + length;
+    return end <= 0xE000 || (start >= 0xFF80 && end <= 0xFFFF);
+}
+
+// Whether length bytes from start can be stored in one go: VRAM, WRAM or
+// HRAM only, not over the instructions of the loop doing the stores and not
+// into a page with a watchpoint.
+static bool plain_target(const GBCPU *cpu, const BlockInstr *d, const BlockInstr *jr, uint16_t start,
+                         size_t length) {
+    uint32_t end = start + length;
+    bool ram = (start >= 0x8000 && end <= 0xA000) || (start >= 0xC000 && end <= 0xE000) ||
+               (start >= 0xFF80 && end <= 0xFFFF);
+    return ram && (end <= d->addr || start >= jr->next) && !watchpoints_in_range(cpu, start, length);
+}
+
+static void bulk_stored(GBCPU *cpu, uint16_t start, size_t length) {
+    for (uint32_t addr = start; addr < start + length; ++addr) {
+        if (is_code(cpu->blocks, addr)) {
+            block_cache_write(cpu->blocks, addr);
+        }
+    }
+    if (cpu->writes) {
+        for (uint32_t addr = start; addr < start + length; ++addr) {
+            verify_store(cpu, addr, cpu->memory[addr]);
+        }
+    }
+}
+
+// Copies length bytes from HL to DE, front to back like the loop. Returns
+// false when the ranges are not plain memory or overlap in a way memmove
+// would not reproduce.
+static bool bulk_copy(GBCPU *cpu, const BlockInstr *d, const BlockInstr *jr, size_t length) {
+    uint16_t src = cpu->reg.HL;
+    uint16_t dst = cpu->reg.DE;
+    if (!plain_source(src, length) || !plain_target(cpu, d, jr, dst, length) ||
+        (dst > src && dst < src + length)) {
+        return false;
+    }
+
+    memmove(&cpu->memory[dst], &cpu->memory[src], length);
+    bulk_stored(cpu, dst, length);
+    cpu->reg.HL += length;
+    cpu->reg.DE += length;
+    cpu->reg.A = cpu->memory[dst + length - 1];
+    return true;
+}
+
+// Stores A through (HL+) or (HL-) length times.
+static bool bulk_fill(GBCPU *cpu, const BlockInstr *d, const BlockInstr *jr, const BlockInstr *store,
+                      size_t length) {
+    bool up = is_op(store, 0x22);
+    int32_t start = up ? cpu->reg.HL : cpu->reg.HL - (int32_t)length + 1;
+    if (start < 0 || !plain_target(cpu, d, jr, start, length)) {
+        return false;
+    }
+
+    memset(&cpu->memory[start], cpu->reg.A, length);
+    bulk_stored(cpu, start, length);
+    cpu->reg.HL = up ? cpu->reg.HL + length : cpu->reg.HL - length;
+    return true;
+}
+
+static bool fuse_copy(GBCPU *cpu, const BlockInstr *d) {
+    const BlockInstr *jr = &d[6];
+    size_t passes = 1;
+    if (jr_target(jr) == d->addr) {
+        passes = cpu->reg.BC ? cpu->reg.BC : 0x10000;
+    }
+    size_t budget = fuse_budget(cpu, d);
+    passes = passes < budget ? passes : budget;
+    if (passes == 0 || !bulk_copy(cpu, d, jr, passes)) {
+        return false;
+    }
+
+    cpu->reg.BC -= passes;
+    cpu->reg.A = cpu->reg.B | cpu->reg.C;
+    cpu->reg.F = (cpu->reg.A == 0) << 7;
+    cpu->lazy.op = LAZY_NONE;
+    fuse_finish(cpu, d, jr, cpu->reg.A != 0, passes);
+    return true;
+}
+
+static bool fuse_copy_r(GBCPU *cpu, const BlockInstr *d) {
+    const BlockInstr *jr = &d[4];
+    uint8_t *reg = (uint8_t *)d[3].dst.ptr;
+    size_t passes = dec_passes(cpu, d, *reg);
+    if (passes == 0 || !bulk_copy(cpu, d, jr, passes)) {
+        return false;
+    }
+
+    dec_reg(cpu, reg, passes);
+    fuse_finish(cpu, d, jr, *reg != 0, passes);
+    return true;
+}
+
+static bool fuse_fill(GBCPU *cpu, const BlockInstr *d) {
+    const BlockInstr *jr = &d[2];
+    uint8_t *reg = (uint8_t *)d[1].dst.ptr;
+    size_t passes = dec_passes(cpu, d, *reg);
+    if (passes == 0 || !bulk_fill(cpu, d, jr, d, passes)) {
+        return false;
+    }
+
+    dec_reg(cpu, reg, passes);
+    fuse_finish(cpu, d, jr, *reg != 0, passes);
+    return true;
+}
+
+static bool fuse_fill_bc(GBCPU *cpu, const BlockInstr *d) {
+    const BlockInstr *jr = &d[5];
+    size_t passes = cpu->reg.BC ? cpu->reg.BC : 0x10000;
+    size_t budget = fuse_budget(cpu, d);
+    passes = passes < budget ? passes : budget;
+    if (passes == 0) {
+        return false;
+    }
+
+    // every pass reloads A before the store, OR C leaves it at B | C
+    uint8_t a = cpu->reg.A;
+    cpu->reg.A = is_op(d, 0xAF) ? 0x00 : *(uint8_t *)d->src.ptr;
+    if (!bulk_fill(cpu, d, jr, &d[1], passes)) {
+        cpu->reg.A = a;
+        return false;
+    }
+
+    cpu->reg.BC -= passes;
+    cpu->reg.A = cpu->reg.B | cpu->reg.C;
+    cpu->reg.F = (cpu->reg.A == 0) << 7;
+    cpu->lazy.op = LAZY_NONE;
+    fuse_finish(cpu, d, jr, cpu->reg.A != 0, passes);
+    return true;
+}
+
+static bool fuse_fill_h(GBCPU *cpu, const BlockInstr *d) {
+    const BlockInstr *jr = &d[2];
+    uint8_t bit = 1 << ((d[1].opcode >> 3) & 0x07);
+    // JR NZ loops while the bit is set, JR Z while it is clear
+    uint8_t looping = is_op(jr, 0x20) ? bit : 0;
+    int step = is_op(d, 0x22) ? 1 : -1;
+    size_t budget = fuse_budget(cpu, d);
+
+    // the bit flips within 0x10000 stores, a longer run cannot be plain RAM
+    uint16_t hl = cpu->reg.HL;
+    size_t passes = 0;
+    do {
+        hl += step;
+        passes++;
+    } while (passes < budget && passes < 0x10000 && ((hl >> 8) & bit) == looping);
+
+    if (budget == 0 || !bulk_fill(cpu, d, jr, d, passes)) {
+        return false;
+    }
+
+    // BIT n,H keeps c and sets h
+    cpu_flags_sync(cpu);
+    bool set = cpu->reg.H & bit;
+    cpu->reg.F = (cpu->reg.F & 0x1F) | 0x20 | (set ? 0x00 : 0x80);
+    fuse_finish(cpu, d, jr, (set ? bit : 0) == looping, passes);
+    return true;
+}
+
+// Runs the fused pattern starting at d to the end of the block. Returns
+// false, having run nothing, when block_step has to take over.
+static bool run_fused(GBCPU *cpu, const BlockInstr *d) {
+    if (cpu->memory[0xFF02] == 0x81) {
+        // a transfer started before the block, block_step completes it
+        // after the first instruction
+        cpu->blocks->fuse_fallbacks++;
+        return false;
+    }
+
+    bool ran = false;
+    switch (d->fuse) {
+    case FUSE_DEC_JR:
+        ran = fuse_dec_jr(cpu, d);
+        break;
+    case FUSE_POLL:
+        ran = fuse_poll(cpu, d);
+        break;
+    case FUSE_COPY:
+        ran = fuse_copy(cpu, d);
+        break;
+    case FUSE_COPY_R:
+        ran = fuse_copy_r(cpu, d);
+        break;
+    case FUSE_FILL:
+        ran = fuse_fill(cpu, d);
+        break;
+    case FUSE_FILL_BC:
+        ran = fuse_fill_bc(cpu, d);
+        break;
+    case FUSE_FILL_H:
+        ran = fuse_fill_h(cpu, d);
+        break;
+    }
+    if (!ran) {
+        cpu->blocks->fuse_fallbacks++;
+    }
+    return ran;
+}
+
+void block_execute(GBCPU *cpu, Block *block) {
+    cpu->blocks->executed++;
+    for (uint8_t i = 0; i < block->count; ++i) {
+        const BlockInstr *d = &block->instrs[i];
+        if (d->fuse != FUSE_NONE && run_fused(cpu, d)) {
+            break;
+        }
+        if (!block_step(cpu, block, d)) {
+            break;
+        }
+    }
+}
+
+void block_run(GBCPU *cpu) {
+    if (breakpoints_check(cpu)) {
+        return;
+    }
+    Block *block = block_lookup(cpu);
+    if (block == NULL) {
+        cpu_clock(cpu, false, false);
+        return;
+    }
+    block_execute(cpu, block);
+}
@@ -0,0 +1,108 @@
+#include "breakpoints.h"
+#include "blocks.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void breakpoints_attach(GBCPU *cpu) {
+    if (cpu->breakpoints == NULL) {
+        cpu->breakpoints = calloc(1, sizeof(Breakpoints));
+    }
+}
+
+void breakpoints_detach(GBCPU *cpu) {
+    Breakpoints *breakpoints = cpu->breakpoints;
+    if (breakpoints == NULL) {
+        return;
+    }
+    cpu->breakpoints = NULL;
+    // blocks were cut short at the breakpoints, decode them in one piece again
+    if (cpu->blocks && breakpoints->pc_count > 0) {
+        block_cache_flush(cpu->blocks);
+    }
+    free(breakpoints);
+}
+
+void breakpoint_set(GBCPU *cpu, uint16_t pc) {
+    breakpoints_attach(cpu);
+    Breakpoints *breakpoints = cpu->breakpoints;
+    if (breakpoint_at(breakpoints, pc)) {
+        return;
+    }
+    breakpoints->pc[pc >> 3] |= 1 << (pc & 0x07);
+    breakpoints->pc_count++;
+    // blocks running over pc are decoded again, ending before it
+    if (cpu->blocks) {
+        block_cache_write(cpu->blocks, pc);
+    }
+}
+
+void breakpoint_clear(GBCPU *cpu, uint16_t pc) {
+    Breakpoints *breakpoints = cpu->breakpoints;
+    if (breakpoints == NULL || !breakpoint_at(breakpoints, pc)) {
+        return;
+    }
+    breakpoints->pc[pc >> 3] &= ~(1 << (pc & 0x07));
+    breakpoints->pc_count--;
+}
+
+static bool watched(const Breakpoints *breakpoints, uint16_t addr) {
+    return breakpoints->watched[addr >> 3] & (1 << (addr & 0x07));
+}
+
+void watchpoint_set(GBCPU *cpu, uint16_t addr) {
+    breakpoints_attach(cpu);
+    Breakpoints *breakpoints = cpu->breakpoints;
+    if (!watched(breakpoints, addr)) {
+        breakpoints->watched[addr >> 3] |= 1 << (addr & 0x07);
+        breakpoints->watched_pages[addr >> 8]++;
+    }
+}
+
+void watchpoint_clear(GBCPU *cpu, uint16_t addr) {
+    Breakpoints *breakpoints = cpu->breakpoints;
+    if (breakpoints && watched(breakpoints, addr)) {
+        breakpoints->watched[addr >> 3] &= ~(1 << (addr & 0x07));
+        breakpoints->watched_pages[addr >> 8]--;
+    }
+}
+
+void breakpoints_resume(GBCPU *cpu) {
+    Breakpoints *breakpoints = cpu->breakpoints;
+    if (breakpoints == NULL) {
+        return;
+    }
+    BreakKind kind = breakpoints->hit.kind;
+    memset(&breakpoints->hit, 0, sizeof(BreakHit));
+    if (kind == BREAK_PC && !cpu->crashed) {
+        cpu_clock(cpu, false, false);
+    }
+}
+
+void watchpoint_store(GBCPU *cpu, uint16_t addr, uint8_t value) {
+    Breakpoints *breakpoints = cpu->breakpoints;
+    uint8_t old_value = cpu->memory[addr];
+    // the first hit is kept until the run is resumed
+    if (!watched(breakpoints, addr) || old_value == value || breakpoints->hit.kind != BREAK_NONE) {
+        return;
+    }
+    breakpoints->hit.kind = BREAK_WATCH;
+    breakpoints->hit.addr = addr;
+    breakpoints->hit.old_value = old_value;
+    breakpoints->hit.new_value = value;
+    breakpoints->hit.instruction = cpu->instruction_count;
+}
+
+bool watchpoints_in_range(const GBCPU *cpu, uint16_t start, size_t length) {
+    const Breakpoints *breakpoints = cpu->breakpoints;
+    if (breakpoints == NULL || length == 0) {
+        return false;
+    }
+    uint32_t last = start + length - 1;
+    for (uint32_t page = start >> 8; page <= last >> 8 && page < 0x100; ++page) {
+        if (breakpoints->watched_pages[page]) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,160 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "callstack.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+uint8_t callstack_bank(uint16_t addr) {
+    return addr >= 0x4000 && addr < 0x8000 ? 1 : 0;
+}
+
+static uint32_t add_node(CallStack *stack, uint32_t parent, uint16_t addr) {
+    if (stack->node_count == stack->node_capacity) {
+        stack->node_capacity = stack->node_capacity ? stack->node_capacity * 2 : 256;
+        stack->nodes = realloc(stack->nodes, stack->node_capacity * sizeof(CallNode));
+    }
+    uint32_t index = stack->node_count++;
+    CallNode *node = &stack->nodes[index];
+    memset(node, 0, sizeof(CallNode));
+    node->addr = addr;
+    node->bank = callstack_bank(addr);
+    node->parent = parent;
+    if (index > 0) {
+        node->sibling = stack->nodes[parent].child;
+        stack->nodes[parent].child = index;
+    }
+    return index;
+}
+
+void callstack_attach(GBCPU *cpu, size_t interval) {
+    if (cpu->calls) {
+        return;
+    }
+    CallStack *stack = calloc(1, sizeof(CallStack));
+    stack->interval = interval ? interval : CALLSTACK_INTERVAL;
+    stack->next_sample = cpu->cycles + stack->interval;
+    add_node(stack, 0, cpu->reg.PC);
+    cpu->calls = stack;
+}
+
+void callstack_detach(GBCPU *cpu) {
+    CallStack *stack = cpu->calls;
+    if (stack == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < stack->symbol_count; ++i) {
+        free(stack->symbols[i].name);
+    }
+    free(stack->symbols);
+    free(stack->nodes);
+    free(stack);
+    cpu->calls = NULL;
+}
+
+// drops the frames whose return address is at or below sp
+static void unwind(CallStack *stack, uint16_t sp) {
+    while (stack->depth > 0 && stack->frames[stack->depth - 1].sp <= sp) {
+        stack->depth--;
+    }
+    stack->node = stack->depth > 0 ? stack->frames[stack->depth - 1].node : 0;
+}
+
+void callstack_push(CallStack *stack, uint16_t addr, uint16_t sp) {
+    unwind(stack, sp);
+    if (stack->depth == CALLSTACK_DEPTH) {
+        return;
+    }
+
+    uint32_t node = stack->nodes[stack->node].child;
+    uint8_t bank = callstack_bank(addr);
+    while (node && (stack->nodes[node].addr != addr || stack->nodes[node].bank != bank)) {
+        node = stack->nodes[node].sibling;
+    }
+    if (node == 0) {
+        node = add_node(stack, stack->node, addr);
+    }
+    stack->frames[stack->depth].node = node;
+    stack->frames[stack->depth].sp = sp;
+    stack->depth++;
+    stack->node = node;
+}
+
+void callstack_pop(CallStack *stack, uint16_t sp) {
+    // a return from a call deeper than CALLSTACK_DEPTH, or through an
+    // address the program pushed itself, finds no frame and changes nothing
+    unwind(stack, sp);
+}
+
+void callstack_sample(CallStack *stack, size_t cycles) {
+    // a fused loop or long block can span several intervals
+    size_t count = (cycles - stack->next_sample) / stack->interval + 1;
+    stack->nodes[stack->node].samples += count;
+    stack->next_sample += count * stack->interval;
+}
+
+static int compare_symbols(const void *a, const void *b) {
+    uint32_t x = ((const CallSymbol *)a)->key;
+    uint32_t y = ((const CallSymbol *)b)->key;
+    return (x > y) - (x < y);
+}
+
+bool callstack_load_symbols(CallStack *stack, const char *file) {
+    FILE *fd = fopen(file, "r");
+    if (!fd) {
+        perror(file);
+        return false;
+    }
+
+    size_t capacity = stack->symbol_count;
+    char line[512];
+    while (fgets(line, sizeof(line), fd)) {
+        unsigned bank;
+        unsigned addr;
+        char name[256];
+        // comments start with ';', other lines that do not parse are skipped
+        if (line[0] == ';' || sscanf(line, "%x:%x %255s", &bank, &addr, name) != 3 || addr > 0xFFFF) {
+            continue;
+        }
+        if (stack->symbol_count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            stack->symbols = realloc(stack->symbols, capacity * sizeof(CallSymbol));
+        }
+        CallSymbol *symbol = &stack->symbols[stack->symbol_count++];
+        symbol->key = (bank & 0xFF) << 16 | addr;
+        symbol->name = strdup(name);
+    }
+    fclose(fd);
+
+    qsort(stack->symbols, stack->symbol_count, sizeof(CallSymbol), compare_symbols);
+    return true;
+}
+
+static void write_name(const CallStack *stack, const CallNode *node, FILE *out) {
+    CallSymbol key = {.key = (uint32_t)node->bank << 16 | node->addr};
+    const CallSymbol *symbol =
+        stack->symbol_count ? bsearch(&key, stack->symbols, stack->symbol_count, sizeof(CallSymbol), compare_symbols)
+                            : NULL;
+    if (symbol) {
+        fputs(symbol->name, out);
+    } else {
+        fprintf(out, "%02X:%04X", node->bank, node->addr);
+    }
+}
+
+static void write_stack(const CallStack *stack, uint32_t node, FILE *out) {
+    if (node != 0) {
+        write_stack(stack, stack->nodes[node].parent, out);
+        fputc(';', out);
+    }
+    write_name(stack, &stack->nodes[node], out);
+}
+
+void callstack_write_folded(const CallStack *stack, FILE *out) {
+    for (uint32_t i = 0; i < stack->node_count; ++i) {
+        if (stack->nodes[i].samples) {
+            write_stack(stack, i, out);
+            fprintf(out, " %llu\n", (unsigned long long)stack->nodes[i].samples);
+        }
+    }
+}
@@ -0,0 +1,150 @@
+#include "disasm.h"
+#include "gbcpu.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+// markers in the templates for what the instruction bytes fill in
+enum {
+    OPERAND_IMM8 = 1,
+    OPERAND_IMM16,
+    OPERAND_RELATIVE, // JR target
+    OPERAND_SIGNED,   // SP offset
+};
+
+typedef struct {
+    char text[GB_DISASM_SIZE];
+    uint8_t length; // 0 for undefined opcodes
+} Template;
+
+static Template templates[2][0x100]; // [prefixed][opcode]
+static pthread_once_t templates_once = PTHREAD_ONCE_INIT;
+
+#define HEX_ROW(h) h "0" h "1" h "2" h "3" h "4" h "5" h "6" h "7" h "8" h "9" h "A" h "B" h "C" h "D" h "E" h "F"
+static const char hex_pairs[] = HEX_ROW("0") HEX_ROW("1") HEX_ROW("2") HEX_ROW("3") HEX_ROW("4") HEX_ROW("5")
+    HEX_ROW("6") HEX_ROW("7") HEX_ROW("8") HEX_ROW("9") HEX_ROW("A") HEX_ROW("B") HEX_ROW("C") HEX_ROW("D")
+        HEX_ROW("E") HEX_ROW("F");
+
+char *disasm_hex8(char *out, uint8_t value) {
+    memcpy(out, &hex_pairs[value * 2], 2);
+    return out + 2;
+}
+
+char *disasm_hex16(char *out, uint16_t value) {
+    memcpy(out, &hex_pairs[(value >> 8) * 2], 2);
+    memcpy(out + 2, &hex_pairs[(value & 0xFF) * 2], 2);
+    return out + 4;
+}
+
+char *disasm_decimal(char *out, uint64_t value, int width) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    for (int i = count; i < width; ++i) {
+        *out++ = ' ';
+    }
+    while (count > 0) {
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+static char *append_operand(char *out, const char *repr, const OpInstr *instr) {
+    if (strcmp(repr, "n") == 0) {
+        if (instr->instruction == jr || instr->instruction == jr_nz || instr->instruction == jr_z ||
+            instr->instruction == jr_nc || instr->instruction == jr_c) {
+            *out++ = OPERAND_RELATIVE;
+        } else if (instr->instruction == add_sp || instr->instruction == ldhl) {
+            *out++ = OPERAND_SIGNED;
+        } else {
+            *out++ = OPERAND_IMM8;
+        }
+    } else if (strcmp(repr, "nn") == 0) {
+        *out++ = OPERAND_IMM16;
+    } else if (strcmp(repr, "(nn)") == 0) {
+        *out++ = '(';
+        *out++ = OPERAND_IMM16;
+        *out++ = ')';
+    } else if (strcmp(repr, "($FF00+n)") == 0) {
+        strcpy(out, "($FF00+");
+        out += strlen(out);
+        *out++ = OPERAND_IMM8;
+        *out++ = ')';
+    } else {
+        strcpy(out, repr);
+        out += strlen(repr);
+    }
+    return out;
+}
+
+static void build_templates(void) {
+    for (int prefixed = 0; prefixed < 2; ++prefixed) {
+        for (int opcode = 0; opcode < 0x100; ++opcode) {
+            const OpInstr *instr = prefixed ? &prefix_opcodes[opcode] : &opcodes[opcode];
+            if (instr->instruction == NULL) {
+                continue;
+            }
+            const char *dst = instr->write_mode.repr;
+            const char *src = instr->read_mode.repr;
+            char *out = templates[prefixed][opcode].text;
+
+            strcpy(out, instr->name);
+            out += strlen(out);
+            if (dst[0] || src[0]) {
+                *out++ = ' ';
+            }
+            out = append_operand(out, dst, instr);
+            if (dst[0] && src[0]) {
+                *out++ = ',';
+                *out++ = ' ';
+            }
+            out = append_operand(out, src, instr);
+            *out = '\0';
+            templates[prefixed][opcode].length = instr->length;
+        }
+    }
+}
+
+uint8_t gb_disasm(const uint8_t *bytes, uint16_t addr, char *out) {
+    pthread_once(&templates_once, build_templates);
+
+    bool prefixed = bytes[0] == 0xCB;
+    const Template *template = &templates[prefixed][bytes[prefixed]];
+    if (template->length == 0) {
+        memcpy(out, "DB $", 4);
+        *disasm_hex8(out + 4, bytes[0]) = '\0';
+        return 1;
+    }
+
+    for (const char *c = template->text; *c; ++c) {
+        switch (*c) {
+        case OPERAND_IMM8:
+            *out++ = '$';
+            out = disasm_hex8(out, bytes[1]);
+            break;
+        case OPERAND_IMM16:
+            *out++ = '$';
+            out = disasm_hex16(out, bytes[1] | bytes[2] << 8);
+            break;
+        case OPERAND_RELATIVE:
+            *out++ = '$';
+            out = disasm_hex16(out, addr + 2 + (int8_t)bytes[1]);
+            break;
+        case OPERAND_SIGNED: {
+            int8_t offset = bytes[1];
+            *out++ = offset < 0 ? '-' : '+';
+            *out++ = '$';
+            out = disasm_hex8(out, offset < 0 ? -offset : offset);
+            break;
+        }
+        default:
+            *out++ = *c;
+        }
+    }
+    *out = '\0';
+    return template->length;
+}
@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "doctor.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LINE_LENGTH 82
+
+// the decoded fields of a line, in the order they appear
+typedef struct {
+    uint8_t registers[8]; // A F B C D E H L
+    uint16_t SP;
+    uint16_t PC;
+    uint8_t bytes[4];
+} DoctorState;
+
+// columns of the values in a line
+static const uint8_t register_columns[8] = {3, 9, 15, 21, 27, 33, 39, 45};
+#define SP_COLUMN 52
+#define PC_COLUMN 64
+static const uint8_t byte_columns[4] = {70, 73, 76, 79};
+
+// the text between the values, which is all a line is checked against
+static const char layout[] = "A: .. F: .. B: .. C: .. D: .. E: .. H: .. L: .. SP: .... PC: 00:.... (.. .. .. ..)";
+
+// one more than the value of each hex digit, 0 for anything else
+static const uint8_t hex_values[0x100] = {
+    ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,  ['5'] = 6,  ['6'] = 7,  ['7'] = 8,
+    ['8'] = 9,  ['9'] = 10, ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+// Decodes count hex digits, returns false on anything else.
+static bool decode_hex(const char *text, int count, uint16_t *value) {
+    uint16_t result = 0;
+    bool ok = true;
+    for (int i = 0; i < count; ++i) {
+        uint8_t digit = hex_values[(uint8_t)text[i]];
+        ok &= digit != 0;
+        result = result << 4 | (uint8_t)(digit - 1);
+    }
+    *value = result;
+    return ok;
+}
+
+static bool decode_line(const char *line, size_t length, DoctorState *state) {
+    if (length != LINE_LENGTH) {
+        return false;
+    }
+    bool ok = true;
+    for (size_t i = 0; i < LINE_LENGTH; ++i) {
+        ok &= layout[i] == '.' || line[i] == layout[i];
+    }
+    uint16_t value;
+    for (int i = 0; i < 8; ++i) {
+        ok &= decode_hex(&line[register_columns[i]], 2, &value);
+        state->registers[i] = value;
+    }
+    ok &= decode_hex(&line[SP_COLUMN], 4, &state->SP);
+    ok &= decode_hex(&line[PC_COLUMN], 4, &state->PC);
+    for (int i = 0; i < 4; ++i) {
+        ok &= decode_hex(&line[byte_columns[i]], 2, &value);
+        state->bytes[i] = value;
+    }
+    return ok;
+}
+
+static void encode_entry(const HistoryEntry *entry, DoctorState *state) {
+    const cpu_registers *reg = &entry->reg;
+    state->registers[0] = reg->A;
+    state->registers[1] = history_entry_flags(entry);
+    state->registers[2] = reg->B;
+    state->registers[3] = reg->C;
+    state->registers[4] = reg->D;
+    state->registers[5] = reg->E;
+    state->registers[6] = reg->H;
+    state->registers[7] = reg->L;
+    state->SP = reg->SP;
+    state->PC = reg->PC;
+    memcpy(state->bytes, entry->bytes, 4);
+}
+
+// the current line without its line break
+static const char *current_line(const DoctorLog *log, size_t *length) {
+    const char *line = log->data + log->offset;
+    const char *end = memchr(line, '\n', log->size - log->offset);
+    *length = end ? (size_t)(end - line) : log->size - log->offset;
+    if (*length > 0 && line[*length - 1] == '\r') {
+        (*length)--;
+    }
+    return line;
+}
+
+DoctorLog *doctor_open(const char *file) {
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        perror(file);
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        perror(file);
+        close(fd);
+        return NULL;
+    }
+
+    DoctorLog *log = calloc(1, sizeof(DoctorLog));
+    log->size = info.st_size;
+    log->line = 1;
+    if (log->size > 0) {
+        void *data = mmap(NULL, log->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            perror(file);
+            close(fd);
+            free(log);
+            return NULL;
+        }
+        posix_madvise(data, log->size, POSIX_MADV_SEQUENTIAL);
+        log->data = data;
+    }
+    // the mapping stays valid without the descriptor
+    close(fd);
+    return log;
+}
+
+void doctor_close(DoctorLog *log) {
+    if (log->data) {
+        munmap((void *)log->data, log->size);
+    }
+    free(log);
+}
+
+DoctorResult doctor_compare(DoctorLog *log, const HistoryEntry *entry) {
+    if (log->offset >= log->size) {
+        return DOCTOR_END;
+    }
+    size_t length;
+    const char *line = current_line(log, &length);
+    DoctorState expected;
+    DoctorState found;
+    if (!decode_line(line, length, &expected)) {
+        return DOCTOR_MALFORMED;
+    }
+    encode_entry(entry, &found);
+    if (memcmp(&expected, &found, sizeof(DoctorState)) != 0) {
+        return DOCTOR_MISMATCH;
+    }
+
+    log->offset += length;
+    if (log->offset < log->size && log->data[log->offset] == '\r') {
+        log->offset++;
+    }
+    if (log->offset < log->size && log->data[log->offset] == '\n') {
+        log->offset++;
+    }
+    log->line++;
+    return DOCTOR_MATCH;
+}
+
+void doctor_report(const DoctorLog *log, const HistoryEntry *entry, FILE *out) {
+    char found[HISTORY_LINE_SIZE];
+    history_format_doctor(entry, found);
+    if (log->offset >= log->size) {
+        fprintf(out, "Reference log ended after line %zu\nFound   : %s\n", log->line - 1, found);
+        return;
+    }
+
+    size_t length;
+    const char *line = current_line(log, &length);
+    fprintf(out, "Line %zu\n", log->line);
+    fprintf(out, "Expected: %.*s\n", (int)length, line);
+    fprintf(out, "Found   : %s\n", found);
+
+    char marks[LINE_LENGTH + 1];
+    size_t width = length < LINE_LENGTH ? length : LINE_LENGTH;
+    for (size_t i = 0; i < width; ++i) {
+        marks[i] = line[i] == found[i] ? ' ' : '^';
+    }
+    marks[width] = '\0';
+    fprintf(out, "          %s\n", marks);
+}
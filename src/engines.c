@@ -0,0 +1,58 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "engines.h"
+
+#include <string.h>
+#include <time.h>
+
+const char *const engine_names[ENGINE_COUNT] = {"cpu", "blocks", "jit"};
+
+bool engine_parse(const char *name, Engine *engine) {
+    for (size_t i = 0; i < ENGINES; ++i) {
+        if (strcmp(name, engine_names[i]) == 0) {
+            *engine = (Engine)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void engine_attach(GBCPU *cpu, Engine engine) {
+    if (engine == ENGINE_BLOCKS) {
+        block_cache_attach(cpu);
+    }
+#ifdef GB_JIT
+    if (engine == ENGINE_JIT) {
+        jit_attach(cpu);
+    }
+#endif
+}
+
+void engine_detach(GBCPU *cpu) {
+#ifdef GB_JIT
+    jit_detach(cpu);
+#endif
+    block_cache_detach(cpu);
+}
+
+void engine_run(GBCPU *cpu, void *context) {
+    engine_step(cpu, *(const Engine *)context);
+}
+
+void engine_run_eager(GBCPU *cpu, void *context) {
+#ifdef GB_JIT
+    if (*(const Engine *)context == ENGINE_JIT) {
+        Block *block = block_lookup(cpu);
+        if (block && block->native == NULL) {
+            block->hits = JIT_HOT_THRESHOLD - 1;
+        }
+    }
+#endif
+    engine_run(cpu, context);
+}
+
+double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gbcpu.h"
+#include "tools.h"
+
+// Translates a ROM image to C source for the runtime in aot.h.
+//
+// Usage: gb_aot rom.gb output.c
+//
+// Code is found by recursive descent from $0100 and the RST and interrupt
+// vectors, using the length field of the opcode tables. A block ends at the
+// same instructions as in the block cache; static jump, call and RST targets
+// and the fall-through of conditional branches and calls start new blocks.
+// JP (HL), RET and RETI end a path. Only the ROM area is translated.
+
+#define ROM_END 0x8000
+
+static uint8_t rom[0x10000];
+static bool queued[ROM_END];
+static uint16_t worklist[ROM_END];
+static size_t pending;
+
+typedef struct {
+    uint16_t start;
+    uint16_t end; // one past the last byte
+} Span;
+
+static Span *spans;
+static size_t span_count;
+
+static const OpInstr *decode(uint16_t addr, uint8_t *opcode) {
+    if (rom[addr] == 0xCB) {
+        *opcode = rom[addr + 1];
+        return &prefix_opcodes[*opcode];
+    }
+    *opcode = rom[addr];
+    return &opcodes[*opcode];
+}
+
+static bool is_jp(Instruction f) {
+    return f == jp || f == jp_c || f == jp_nc || f == jp_nz || f == jp_z;
+}
+
+static bool is_jr(Instruction f) {
+    return f == jr || f == jr_c || f == jr_nc || f == jr_nz || f == jr_z;
+}
+
+static bool is_call(Instruction f) {
+    return f == call || f == call_c || f == call_nc || f == call_nz || f == call_z;
+}
+
+static bool is_ret(Instruction f) {
+    return f == ret || f == ret_c || f == ret_nc || f == ret_nz || f == ret_z || f == reti;
+}
+
+static bool ends_block(Instruction f) {
+    return is_jp(f) || is_jr(f) || is_call(f) || is_ret(f) || f == rst || f == stop;
+}
+
+static bool falls_through(Instruction f) {
+    return !(f == jp || f == jr || f == ret || f == reti);
+}
+
+// whether the instruction may store to memory, including the stack
+static bool may_store(const OpInstr *instr) {
+    AddrModeFunc dst = instr->write_mode.addr_mode_func;
+    Instruction f = instr->instruction;
+    return dst == reg_bc_ptr || dst == reg_de_ptr || dst == reg_hl_ptr || dst == reg_c_ptr ||
+           dst == immediate_ptr || dst == immediate_ext_ptr || f == push || is_call(f) || f == rst;
+}
+
+static void enqueue(uint32_t addr) {
+    if (addr < ROM_END && !queued[addr]) {
+        queued[addr] = true;
+        worklist[pending++] = addr;
+    }
+}
+
+static void discover(uint16_t start) {
+    uint32_t addr = start;
+    uint8_t opcode;
+    const OpInstr *instr = NULL;
+
+    while (addr < ROM_END) {
+        const OpInstr *next = decode(addr, &opcode);
+        if (next->instruction == NULL || addr + next->length > ROM_END) {
+            // the interpreter reports the crash
+            break;
+        }
+        instr = next;
+        uint32_t operand = addr + (rom[addr] == 0xCB ? 2 : 1);
+        addr += instr->length;
+
+        Instruction f = instr->instruction;
+        if (!ends_block(f)) {
+            instr = NULL;
+            continue;
+        }
+        if ((is_jp(f) || is_call(f)) && instr->read_mode.addr_mode_func == immediate_ext) {
+            enqueue(rom[operand] | rom[operand + 1] << 8);
+        } else if (is_jr(f)) {
+            enqueue((uint16_t)(addr + (int8_t)rom[operand]));
+        } else if (f == rst) {
+            enqueue(opcode & 0x38);
+        }
+        if (falls_through(f)) {
+            enqueue(addr);
+        }
+        break;
+    }
+
+    if (addr > start) {
+        spans[span_count].start = start;
+        spans[span_count].end = addr;
+        span_count++;
+    }
+}
+
+static int by_start(const void *a, const void *b) {
+    return ((const Span *)a)->start - ((const Span *)b)->start;
+}
+
+static void write_instruction(FILE *out, uint16_t addr, const Span *span) {
+    uint8_t opcode;
+    const OpInstr *instr = decode(addr, &opcode);
+    const char *table = rom[addr] == 0xCB ? "prefix_opcodes" : "opcodes";
+    uint16_t operand = addr + (rom[addr] == 0xCB ? 2 : 1);
+    uint16_t next = addr + instr->length;
+
+    fprintf(out, "    // $%04X %s %s%s%s\n", addr, instr->name, instr->write_mode.repr,
+            instr->write_mode.repr[0] && instr->read_mode.repr[0] ? ", " : "", instr->read_mode.repr);
+    fprintf(out, "    cpu->reg.PC = 0x%04X;\n", operand);
+    fprintf(out, "    cpu->opcode = 0x%02X;\n", opcode);
+    if (instr->read_mode.addr_mode_func == implied) {
+        fprintf(out, "    cpu->src = (DataAccess){0};\n");
+    } else {
+        fprintf(out, "    %s[0x%02X].read_mode.addr_mode_func(cpu, &cpu->src);\n", table, opcode);
+    }
+    if (instr->write_mode.addr_mode_func == implied) {
+        fprintf(out, "    cpu->dst = (DataAccess){0};\n");
+    } else {
+        fprintf(out, "    %s[0x%02X].write_mode.addr_mode_func(cpu, &cpu->dst);\n", table, opcode);
+    }
+    fprintf(out, "    %s[0x%02X].instruction(cpu);\n", table, opcode);
+
+    char rest[32] = "NULL, 0";
+    if (may_store(instr) && next < span->end) {
+        snprintf(rest, sizeof(rest), "&rom[0x%04X], %u", next, span->end - next);
+    }
+    if (next < span->end) {
+        fprintf(out, "    if (!aot_retire(cpu, &%s[0x%02X], 0x%04X, 0x%04X, %s)) {\n        return;\n    }\n", table,
+                opcode, addr, next, rest);
+    } else {
+        fprintf(out, "    aot_retire(cpu, &%s[0x%02X], 0x%04X, 0x%04X, NULL, 0);\n", table, opcode, addr, next);
+    }
+}
+
+static void write_module(FILE *out, const char *name) {
+    uint16_t rom_size = 0;
+    for (size_t i = 0; i < span_count; ++i) {
+        rom_size = spans[i].end > rom_size ? spans[i].end : rom_size;
+    }
+
+    fprintf(out, "// Generated by gb_aot from %s, do not edit.\n\n", name);
+    fprintf(out, "#include \"aot.h\"\n\n");
+    fprintf(out, "static const uint8_t rom[0x%04X] = {\n", rom_size);
+    for (size_t i = 0; i < rom_size; ++i) {
+        fprintf(out, "%s0x%02X,%s", i % 16 == 0 ? "    " : "", rom[i], i % 16 == 15 || i + 1 == rom_size ? "\n" : " ");
+    }
+    fprintf(out, "};\n");
+
+    for (size_t i = 0; i < span_count; ++i) {
+        fprintf(out, "\nstatic void block_%04X(GBCPU *cpu) {\n", spans[i].start);
+        uint8_t opcode;
+        for (uint16_t addr = spans[i].start; addr < spans[i].end; addr += decode(addr, &opcode)->length) {
+            write_instruction(out, addr, &spans[i]);
+        }
+        fprintf(out, "}\n");
+    }
+
+    fprintf(out, "\nstatic const AotBlock blocks[] = {\n");
+    for (size_t i = 0; i < span_count; ++i) {
+        fprintf(out, "    {0x%04X, %u, &rom[0x%04X], block_%04X},\n", spans[i].start,
+                spans[i].end - spans[i].start, spans[i].start, spans[i].start);
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out, "const AotModule gb_aot_module = {AOT_VERSION, %zu, blocks};\n", span_count);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s rom.gb output.c\n", argv[0]);
+        return 2;
+    }
+    if (!read_binary(argv[1], rom)) {
+        return 2;
+    }
+
+    spans = malloc(ROM_END * sizeof(Span));
+    enqueue(0x0100);
+    for (uint16_t vector = 0x00; vector <= 0x60; vector += 0x08) {
+        enqueue(vector);
+    }
+    while (pending > 0) {
+        discover(worklist[--pending]);
+    }
+    qsort(spans, span_count, sizeof(Span), by_start);
+
+    FILE *out = fopen(argv[2], "w");
+    if (out == NULL) {
+        perror(argv[2]);
+        return 2;
+    }
+    write_module(out, argv[1]);
+    size_t bytes = 0;
+    for (size_t i = 0; i < span_count; ++i) {
+        bytes += spans[i].end - spans[i].start;
+    }
+    printf("%s: %zu blocks, %zu bytes of code\n", argv[1], span_count, bytes);
+    free(spans);
+    return fclose(out) == 0 ? 0 : 1;
+}
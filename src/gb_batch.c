@@ -0,0 +1,563 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "breakpoints.h"
+#include "gbcpu.h"
+#include "joypad.h"
+#include "memstats.h"
+#include "profile.h"
+#include "tools.h"
+
+// Runs a manifest of ROM jobs on a work-stealing thread pool.
+//
+// Manifest lines are tab separated, '#' starts a comment:
+//   <rom> <TAB> <movie|-> <TAB> <cycle budget, 0 = unlimited> <TAB> <stop condition>
+//
+// Stop conditions:
+//   serial:<text>  stop when a serial line equals <text> (e.g. serial:Passed)
+//   pc:<hex>       stop when PC reaches the address
+//   watch:<hex>    stop when a store changes the byte at the address
+//   crash          expect the CPU to crash (or loop forever) within the budget
+//
+// Movie files contain "<cycle> <buttons>" lines, e.g. "70224 A+START".
+//
+// Results are JSON lines on stdout, or in the -o file; the emulator's own
+// diagnostics on stdout are discarded.
+//
+// Built with GB_PROFILE, -p profile.csv profiles every job, prints the most
+// expensive opcodes of the whole run on stderr and writes all of them to the
+// CSV file.
+//
+// Built with GB_STATS, -m memory.csv counts the memory accesses of every job,
+// prints the totals per region and I/O register on stderr and writes the
+// per-address heatmap to the CSV file.
+
+#define MAX_SERIAL_OUTPUT 0x1000
+#define PROFILE_INTERVAL 64 // host time is sampled on one in 64 instructions
+
+typedef enum {
+    STOP_CRASH,
+    STOP_SERIAL,
+    STOP_PC,
+    STOP_WATCH,
+} StopKind;
+
+typedef enum {
+    STATUS_PASSED,
+    STATUS_BUDGET,
+    STATUS_CRASHED,
+    STATUS_ERROR,
+} JobStatus;
+
+typedef struct {
+    size_t cycle;
+    uint8_t buttons;
+} MovieEvent;
+
+typedef struct {
+    char *rom;
+    char *movie;
+    size_t cycle_budget;
+    StopKind stop;
+    char *stop_serial;
+    uint16_t stop_addr; // STOP_PC and STOP_WATCH
+
+    JobStatus status;
+    cpu_registers reg;
+    bool ime;
+    size_t cycles;
+    size_t instructions;
+    double wall_ms;
+    char serial[MAX_SERIAL_OUTPUT];
+    size_t serial_len;
+} Job;
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t *jobs;
+    size_t head; // thieves take from the head
+    size_t tail; // the owner pops from the tail
+} WorkQueue;
+
+typedef struct {
+    Job *jobs;
+    WorkQueue *queues;
+    size_t worker_count;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    size_t id;
+    GBCPU *cpu;
+    Profile *profile; // NULL unless -p was given
+    MemStats *stats;  // NULL unless -m was given
+} Worker;
+
+static const char *status_as_string(JobStatus status) {
+    switch (status) {
+    case STATUS_PASSED:
+        return "passed";
+    case STATUS_BUDGET:
+        return "budget";
+    case STATUS_CRASHED:
+        return "crashed";
+    case STATUS_ERROR:
+        return "error";
+    }
+    return "unknown";
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static char *copy_string(const char *str) {
+    char *copy = malloc(strlen(str) + 1);
+    strcpy(copy, str);
+    return copy;
+}
+
+static bool parse_job(char *line, Job *job) {
+    char *fields[4];
+    size_t count = 0;
+    char *save = NULL;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    for (char *field = strtok_r(line, "\t", &save); field && count < 4; field = strtok_r(NULL, "\t", &save)) {
+        fields[count++] = field;
+    }
+    if (count != 4) {
+        return false;
+    }
+
+    memset(job, 0, sizeof(Job));
+    job->rom = copy_string(fields[0]);
+    job->movie = strcmp(fields[1], "-") == 0 ? NULL : copy_string(fields[1]);
+    job->cycle_budget = strtoull(fields[2], NULL, 0);
+
+    if (strncmp(fields[3], "serial:", 7) == 0) {
+        job->stop = STOP_SERIAL;
+        job->stop_serial = copy_string(fields[3] + 7);
+    } else if (strncmp(fields[3], "pc:", 3) == 0) {
+        job->stop = STOP_PC;
+        job->stop_addr = strtoul(fields[3] + 3, NULL, 16);
+    } else if (strncmp(fields[3], "watch:", 6) == 0) {
+        job->stop = STOP_WATCH;
+        job->stop_addr = strtoul(fields[3] + 6, NULL, 16);
+    } else if (strcmp(fields[3], "crash") == 0) {
+        job->stop = STOP_CRASH;
+    } else {
+        free(job->rom);
+        free(job->movie);
+        return false;
+    }
+    return true;
+}
+
+static Job *read_manifest(const char *file, size_t *job_count) {
+    FILE *fd = fopen(file, "r");
+    if (!fd) {
+        perror("Manifest opening failed");
+        return NULL;
+    }
+
+    size_t capacity = 16;
+    Job *jobs = malloc(capacity * sizeof(Job));
+    char line[1024];
+    size_t line_number = 0;
+    *job_count = 0;
+
+    while (fgets(line, sizeof(line), fd)) {
+        line_number++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (*job_count == capacity) {
+            capacity *= 2;
+            jobs = realloc(jobs, capacity * sizeof(Job));
+        }
+        if (!parse_job(line, &jobs[*job_count])) {
+            fprintf(stderr, "%s:%zu: malformed job\n", file, line_number);
+            continue;
+        }
+        (*job_count)++;
+    }
+    fclose(fd);
+    return jobs;
+}
+
+static MovieEvent *read_movie(const char *file, size_t *event_count) {
+    FILE *fd = fopen(file, "r");
+    *event_count = 0;
+    if (!fd) {
+        perror("Movie opening failed");
+        return NULL;
+    }
+
+    size_t capacity = 64;
+    MovieEvent *events = malloc(capacity * sizeof(MovieEvent));
+    char buttons[64];
+    size_t cycle;
+
+    while (fscanf(fd, "%zu %63s", &cycle, buttons) == 2) {
+        if (*event_count == capacity) {
+            capacity *= 2;
+            events = realloc(events, capacity * sizeof(MovieEvent));
+        }
+        events[*event_count].cycle = cycle;
+        events[*event_count].buttons = strcmp(buttons, "-") == 0 ? 0x00 : joypad_parse(buttons);
+        (*event_count)++;
+    }
+    fclose(fd);
+    return events;
+}
+
+static void append_serial(Job *job, const char *text) {
+    size_t len = strlen(text);
+    if (job->serial_len + len >= MAX_SERIAL_OUTPUT) {
+        len = MAX_SERIAL_OUTPUT - job->serial_len - 1;
+    }
+    memcpy(job->serial + job->serial_len, text, len);
+    job->serial_len += len;
+    job->serial[job->serial_len] = '\0';
+}
+
+static bool serial_line_matches(SerialBuffer *buffer, const char *text) {
+    size_t len = strlen(text);
+    return buffer->pos == len + 1 && strncmp(buffer->buffer, text, len) == 0;
+}
+
+static void run_job(GBCPU *cpu, Job *job, Profile *profile, MemStats *stats) {
+    double start = now_ms();
+
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+#ifdef GB_PROFILE
+    cpu->profile = profile;
+#else
+    (void)profile;
+#endif
+#ifdef GB_STATS
+    cpu->stats = stats;
+#else
+    (void)stats;
+#endif
+    if (!read_binary(job->rom, cpu->memory)) {
+        job->status = STATUS_ERROR;
+        return;
+    }
+    cpu->memory[0xFF44] = 0x90; // LY
+
+    if (job->stop == STOP_PC || job->stop == STOP_WATCH) {
+        breakpoints_attach(cpu);
+        if (job->stop == STOP_PC) {
+            breakpoint_set(cpu, job->stop_addr);
+        } else {
+            watchpoint_set(cpu, job->stop_addr);
+        }
+    }
+
+    size_t event_count = 0;
+    size_t next_event = 0;
+    MovieEvent *events = job->movie ? read_movie(job->movie, &event_count) : NULL;
+
+    job->status = STATUS_BUDGET;
+    while (job->cycle_budget == 0 || cpu->cycles < job->cycle_budget) {
+        while (next_event < event_count && events[next_event].cycle <= cpu->cycles) {
+            joypad_set(cpu, events[next_event].buttons);
+            next_event++;
+        }
+
+        if (breakpoints_check(cpu)) {
+            job->status = STATUS_PASSED;
+            break;
+        }
+        cpu_clock(cpu, false, false);
+
+        if (cpu->crashed) {
+            job->status = STATUS_CRASHED;
+            break;
+        }
+
+        if (serial_buffer_eol(&cpu->buffer) || cpu->buffer.pos == SERIAL_BUFFER_SIZE - 1) {
+            bool matches = job->stop == STOP_SERIAL && serial_line_matches(&cpu->buffer, job->stop_serial);
+            append_serial(job, cpu->buffer.buffer);
+            serial_buffer_clear(&cpu->buffer);
+            if (matches) {
+                job->status = STATUS_PASSED;
+                break;
+            }
+        }
+    }
+    append_serial(job, cpu->buffer.buffer);
+
+    cpu_flags_sync(cpu);
+    job->reg = cpu->reg;
+    job->ime = cpu->ime;
+    job->cycles = cpu->cycles;
+    job->instructions = cpu->instruction_count;
+    job->wall_ms = now_ms() - start;
+    breakpoints_detach(cpu);
+    free(events);
+}
+
+static bool queue_pop(WorkQueue *queue, size_t *job) {
+    bool found = false;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail > queue->head) {
+        *job = queue->jobs[--queue->tail];
+        found = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static bool queue_steal(WorkQueue *queue, size_t *job) {
+    bool found = false;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail > queue->head) {
+        *job = queue->jobs[queue->head++];
+        found = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static void *worker_main(void *arg) {
+    Worker *worker = (Worker *)arg;
+    Pool *pool = worker->pool;
+    size_t job;
+
+    for (;;) {
+        bool found = queue_pop(&pool->queues[worker->id], &job);
+        for (size_t i = 1; !found && i < pool->worker_count; ++i) {
+            size_t victim = (worker->id + i) % pool->worker_count;
+            found = queue_steal(&pool->queues[victim], &job);
+        }
+        if (!found) {
+            // jobs are never added after start, so empty queues mean we are done
+            return NULL;
+        }
+        run_job(worker->cpu, &pool->jobs[job], worker->profile, worker->stats);
+    }
+}
+
+static void print_json_string(FILE *out, const char *str) {
+    fputc('"', out);
+    for (; *str; ++str) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c == '\n') {
+            fprintf(out, "\\n");
+        } else if (c < 0x20 || c >= 0x7F) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void print_result(FILE *out, size_t index, Job *job) {
+    fprintf(out, "{\"job\": %zu, \"rom\": ", index);
+    print_json_string(out, job->rom);
+    fprintf(out, ", \"status\": \"%s\"", status_as_string(job->status));
+    fprintf(out, ", \"cycles\": %zu, \"instructions\": %zu", job->cycles, job->instructions);
+    fprintf(out, ", \"wall_ms\": %.3f", job->wall_ms);
+    fprintf(out, ", \"registers\": {\"AF\": \"%04X\", \"BC\": \"%04X\", \"DE\": \"%04X\", ", job->reg.AF, job->reg.BC, job->reg.DE);
+    fprintf(out, "\"HL\": \"%04X\", \"SP\": \"%04X\", \"PC\": \"%04X\", ", job->reg.HL, job->reg.SP, job->reg.PC);
+    fprintf(out, "\"IME\": %s}, \"serial\": ", job->ime ? "true" : "false");
+    print_json_string(out, job->serial);
+    fprintf(out, "}\n");
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-j workers] [-o results.jsonl]", name);
+#ifdef GB_PROFILE
+    fprintf(stderr, " [-p profile.csv]");
+#endif
+#ifdef GB_STATS
+    fprintf(stderr, " [-m memory.csv]");
+#endif
+    fprintf(stderr, " manifest\n");
+}
+
+int main(int argc, char **argv) {
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *output = NULL;
+    const char *profile_csv = NULL;
+    const char *stats_csv = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:m:o:p:")) != -1) {
+        switch (opt) {
+        case 'j':
+            workers = strtol(optarg, NULL, 10);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+#ifdef GB_PROFILE
+        case 'p':
+            profile_csv = optarg;
+            break;
+#endif
+#ifdef GB_STATS
+        case 'm':
+            stats_csv = optarg;
+            break;
+#endif
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    size_t job_count;
+    Job *jobs = read_manifest(argv[optind], &job_count);
+    if (!jobs) {
+        return 2;
+    }
+
+    // the JSON goes to a copy of stdout, the emulator's own diagnostics on
+    // stdout are discarded
+    FILE *out = output ? fopen(output, "w") : fdopen(dup(STDOUT_FILENO), "w");
+    if (!out) {
+        perror(output ? output : "stdout");
+        return 2;
+    }
+    if (!freopen("/dev/null", "w", stdout)) {
+        perror("/dev/null");
+        return 2;
+    }
+
+    Pool pool;
+    pool.jobs = jobs;
+    pool.worker_count = workers < 1 ? 1 : (size_t)workers;
+    if (pool.worker_count > job_count && job_count > 0) {
+        pool.worker_count = job_count;
+    }
+    pool.queues = calloc(pool.worker_count, sizeof(WorkQueue));
+
+    for (size_t i = 0; i < pool.worker_count; ++i) {
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        pool.queues[i].jobs = malloc((job_count / pool.worker_count + 1) * sizeof(size_t));
+    }
+    for (size_t i = 0; i < job_count; ++i) {
+        WorkQueue *queue = &pool.queues[i % pool.worker_count];
+        queue->jobs[queue->tail++] = i;
+    }
+
+    Worker *worker = calloc(pool.worker_count, sizeof(Worker));
+    pthread_t *threads = calloc(pool.worker_count, sizeof(pthread_t));
+    size_t started = 0;
+    for (; started < pool.worker_count; ++started) {
+        Worker *w = &worker[started];
+        w->pool = &pool;
+        w->id = started;
+        w->cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+        if (!w->cpu) {
+            fprintf(stderr, "worker %zu: out of memory\n", started);
+            break;
+        }
+#ifdef GB_PROFILE
+        w->profile = profile_csv ? profile_create(PROFILE_INTERVAL) : NULL;
+#endif
+#ifdef GB_STATS
+        w->stats = stats_csv ? memstats_create() : NULL;
+#endif
+        int error = pthread_create(&threads[started], NULL, worker_main, w);
+        if (error != 0) {
+            fprintf(stderr, "worker %zu: %s\n", started, strerror(error));
+            free(w->profile);
+            free(w->stats);
+            free(w->cpu);
+            w->profile = NULL;
+            w->stats = NULL;
+            break;
+        }
+    }
+    // the workers already running still drain every queue by stealing
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+#ifdef GB_PROFILE
+        if (worker[i].profile && i > 0) {
+            profile_merge(worker[0].profile, worker[i].profile);
+            free(worker[i].profile);
+        }
+#endif
+#ifdef GB_STATS
+        if (worker[i].stats && i > 0) {
+            memstats_merge(worker[0].stats, worker[i].stats);
+            free(worker[i].stats);
+        }
+#endif
+        free(worker[i].cpu);
+    }
+    for (size_t i = 0; i < pool.worker_count; ++i) {
+        free(pool.queues[i].jobs);
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    }
+
+    // a pool that could not start completely reports nothing
+    bool failed = started < pool.worker_count;
+    int exit_code = failed ? 2 : 0;
+#ifdef GB_PROFILE
+    if (worker[0].profile) {
+        if (!failed) {
+            profile_report(worker[0].profile, stderr, 20);
+            if (!profile_write_csv(worker[0].profile, profile_csv)) {
+                exit_code = 2;
+            }
+        }
+        free(worker[0].profile);
+    }
+#else
+    (void)profile_csv;
+#endif
+#ifdef GB_STATS
+    if (worker[0].stats) {
+        if (!failed) {
+            memstats_report(worker[0].stats, stderr);
+            if (!memstats_write_csv(worker[0].stats, stats_csv)) {
+                exit_code = 2;
+            }
+        }
+        free(worker[0].stats);
+    }
+#else
+    (void)stats_csv;
+#endif
+    for (size_t i = 0; i < job_count && !failed; ++i) {
+        print_result(out, i, &jobs[i]);
+        bool expected_crash = jobs[i].stop == STOP_CRASH && jobs[i].status == STATUS_CRASHED;
+        if (jobs[i].status != STATUS_PASSED && !expected_crash) {
+            exit_code = 1;
+        }
+    }
+    for (size_t i = 0; i < job_count; ++i) {
+        free(jobs[i].rom);
+        free(jobs[i].movie);
+        free(jobs[i].stop_serial);
+    }
+    fclose(out);
+
+    free(threads);
+    free(worker);
+    free(pool.queues);
+    free(jobs);
+    return exit_code;
+}
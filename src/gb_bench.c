@@ -0,0 +1,302 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "engines.h"
+#include "gbcpu.h"
+#include "tools.h"
+
+// Measures emulator speed on a set of ROMs, headless.
+//
+// Usage: gb_bench [-e engine] [-i instructions | -c cycles] [-w warmups] [-r repeats] [-o out.json] rom...
+//
+// Every ROM runs for a fixed budget of guest instructions (default 10M) or
+// cycles, restarting from the beginning whenever it crashes or reaches its
+// final infinite loop, so every run does the same work. Each ROM is run
+// warmups times untimed, then repeats times timed. The engine is cpu
+// (cpu_clock), blocks (block_run) or, built with GB_JIT, jit (jit_run).
+//
+// The result is one JSON object with instructions/s, emulated cycles/s and
+// host ns per emulated frame of the fastest repeat and the median repeat
+// for every ROM, and the peak RSS of the whole process once at the end.
+// With blocks and jit, every ROM also lists the guest instructions each
+// fused handler ran and how often one fell back to block_step. Only the
+// stepping is timed, not setting up an instance or restarting it. The
+// emulator's own diagnostics on stdout are discarded so the JSON can be
+// piped, and its stderr is silenced while the ROMs run. A ROM that crashes
+// before retiring a single instruction can never use up the budget; it is
+// reported with a "failed" reason instead, and the exit status is 1.
+//
+// `cmake --build . --target bench` runs it on tests/roms/*.gb and writes
+// bench.json in the build directory.
+
+#define FRAME_CYCLES 70224 // 154 lines of 456 dots
+#define MAX_REPEATS 1000
+
+typedef struct {
+    size_t instructions;
+    size_t cycles;
+    size_t restarts;
+    double seconds;
+    bool failed; // crashed before retiring an instruction, so restarting would loop forever
+    size_t fused[FUSE_COUNT]; // from the block cache of blocks and jit
+    size_t fuse_fallbacks;
+} RunResult;
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // kilobytes on Linux
+}
+
+static void start_instance(GBCPU *cpu, const uint8_t *image, Engine engine) {
+    engine_detach(cpu);
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    memcpy(cpu->memory, image, 0x10000);
+    cpu->memory[0xFF44] = 0x90; // LY
+    engine_attach(cpu, engine);
+}
+
+// Steps the engine until the instance crashes or the budgets are used up,
+// counting what earlier instances of the run already did.
+static void run_instance(GBCPU *cpu, Engine engine, size_t instruction_budget, size_t cycle_budget,
+                         const RunResult *done) {
+    while (!cpu->crashed) {
+        size_t instructions = done->instructions + cpu->instruction_count;
+        size_t cycles = done->cycles + cpu->cycles;
+        if ((instruction_budget && instructions >= instruction_budget) || (cycle_budget && cycles >= cycle_budget)) {
+            return;
+        }
+
+        engine_step(cpu, engine);
+        if (serial_buffer_eol(&cpu->buffer)) {
+            serial_buffer_clear(&cpu->buffer);
+        }
+    }
+}
+
+// Adds the fused handler counters of the instance's block cache, if any.
+static void count_fused(const GBCPU *cpu, RunResult *result) {
+    if (!cpu->blocks) {
+        return;
+    }
+    for (size_t f = 0; f < FUSE_COUNT; ++f) {
+        result->fused[f] += cpu->blocks->fused[f];
+    }
+    result->fuse_fallbacks += cpu->blocks->fuse_fallbacks;
+}
+
+// Only the stepping is timed, not starting the instances.
+static RunResult run(GBCPU *cpu, const uint8_t *image, Engine engine, size_t instruction_budget, size_t cycle_budget) {
+    RunResult result = {0};
+
+    start_instance(cpu, image, engine);
+    for (;;) {
+        double start = now_s();
+        run_instance(cpu, engine, instruction_budget, cycle_budget, &result);
+        result.seconds += now_s() - start;
+
+        result.instructions += cpu->instruction_count;
+        result.cycles += cpu->cycles;
+        count_fused(cpu, &result);
+        if (!cpu->crashed) {
+            break;
+        }
+        if (cpu->instruction_count == 0) {
+            result.failed = true;
+            break;
+        }
+        result.restarts++;
+        start_instance(cpu, image, engine);
+    }
+
+    engine_detach(cpu);
+    return result;
+}
+
+// The final infinite loop of a ROM is reported on stderr by cpu_clock,
+// which would repeat on every restart. Returns the descriptor to restore.
+static int silence_stderr() {
+    fflush(stderr);
+    int saved = dup(STDERR_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    if (null >= 0) {
+        dup2(null, STDERR_FILENO);
+        close(null);
+    }
+    return saved;
+}
+
+static void restore_stderr(int saved) {
+    if (saved >= 0) {
+        dup2(saved, STDERR_FILENO);
+        close(saved);
+    }
+}
+
+static int by_seconds(const void *a, const void *b) {
+    double x = ((const RunResult *)a)->seconds;
+    double y = ((const RunResult *)b)->seconds;
+    return (x > y) - (x < y);
+}
+
+static void print_json_string(FILE *out, const char *str) {
+    fputc('"', out);
+    for (; *str; ++str) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20 || c >= 0x7F) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void print_rates(FILE *out, const char *name, const RunResult *run) {
+    fprintf(out, "\"%s\": {\"seconds\": %.6f, \"instructions_per_s\": %.0f, \"cycles_per_s\": %.0f, \"ns_per_frame\": %.0f}",
+            name, run->seconds, run->instructions / run->seconds, run->cycles / run->seconds,
+            run->seconds * 1e9 * FRAME_CYCLES / run->cycles);
+}
+
+static void print_fused(FILE *out, const RunResult *run) {
+    fprintf(out, "\"fused\": {");
+    for (size_t f = FUSE_NONE + 1; f < FUSE_COUNT; ++f) {
+        fprintf(out, "%s", f > FUSE_NONE + 1 ? ", " : "");
+        print_json_string(out, block_fuse_names[f]);
+        fprintf(out, ": %zu", run->fused[f]);
+    }
+    fprintf(out, "}, \"fuse_fallbacks\": %zu, ", run->fuse_fallbacks);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-e cpu|blocks", name);
+#ifdef GB_JIT
+    fprintf(stderr, "|jit");
+#endif
+    fprintf(stderr, "] [-i instructions | -c cycles] [-w warmups] [-r repeats] [-o out.json] rom...\n");
+}
+
+int main(int argc, char **argv) {
+    Engine engine = ENGINE_CPU;
+    size_t instruction_budget = 10000000;
+    size_t cycle_budget = 0;
+    long warmups = 1;
+    long repeats = 5;
+    const char *output = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:e:i:o:r:w:")) != -1) {
+        switch (opt) {
+        case 'c':
+            cycle_budget = strtoull(optarg, NULL, 0);
+            instruction_budget = 0;
+            break;
+        case 'e':
+            if (!engine_parse(optarg, &engine)) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'i':
+            instruction_budget = strtoull(optarg, NULL, 0);
+            cycle_budget = 0;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'r':
+            repeats = strtol(optarg, NULL, 10);
+            break;
+        case 'w':
+            warmups = strtol(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind == argc || (instruction_budget == 0 && cycle_budget == 0) || repeats < 1 || repeats > MAX_REPEATS ||
+        warmups < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *out = output ? fopen(output, "w") : fdopen(dup(STDOUT_FILENO), "w");
+    if (!out) {
+        perror(output ? output : "stdout");
+        return 2;
+    }
+    if (!freopen("/dev/null", "w", stdout)) {
+        perror("/dev/null");
+        return 2;
+    }
+
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    uint8_t *image = malloc(0x10000);
+    RunResult *runs = malloc(repeats * sizeof(RunResult));
+    size_t rom_count = 0;
+    int exit_code = 0;
+
+    fprintf(out, "{\"engine\": \"%s\", ", engine_names[engine]);
+    if (instruction_budget) {
+        fprintf(out, "\"instruction_budget\": %zu, ", instruction_budget);
+    } else {
+        fprintf(out, "\"cycle_budget\": %zu, ", cycle_budget);
+    }
+    fprintf(out, "\"warmups\": %ld, \"repeats\": %ld, \"roms\": [", warmups, repeats);
+    for (int i = optind; i < argc; ++i) {
+        memset(image, 0, 0x10000);
+        if (!read_binary(argv[i], image)) {
+            exit_code = 2;
+            continue;
+        }
+        // the guest work is the same in every run, so one that fails fails them all
+        int saved_stderr = silence_stderr();
+        bool failed = false;
+        for (long n = 0; n < warmups && !failed; ++n) {
+            failed = run(cpu, image, engine, instruction_budget, cycle_budget).failed;
+        }
+        for (long n = 0; n < repeats && !failed; ++n) {
+            runs[n] = run(cpu, image, engine, instruction_budget, cycle_budget);
+            failed = runs[n].failed;
+        }
+        restore_stderr(saved_stderr);
+
+        fprintf(out, "%s\n  {\"rom\": ", rom_count++ ? "," : "");
+        print_json_string(out, argv[i]);
+        if (failed) {
+            fprintf(out, ", \"failed\": \"crashed before its first instruction\"}");
+            exit_code = 1;
+            continue;
+        }
+        qsort(runs, repeats, sizeof(RunResult), by_seconds);
+        fprintf(out, ", \"instructions\": %zu, \"cycles\": %zu, \"frames\": %.1f, \"restarts\": %zu, ",
+                runs[0].instructions, runs[0].cycles, (double)runs[0].cycles / FRAME_CYCLES, runs[0].restarts);
+        if (engine != ENGINE_CPU) {
+            print_fused(out, &runs[0]);
+        }
+        print_rates(out, "best", &runs[0]);
+        fprintf(out, ", ");
+        print_rates(out, "median", &runs[repeats / 2]);
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n], \"peak_rss_kb\": %ld}\n", peak_rss_kb());
+
+    free(runs);
+    free(image);
+    free(cpu);
+    if (fclose(out) != 0) {
+        exit_code = 2;
+    }
+    return exit_code;
+}
@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "gbcpu.h"
+#include "tools.h"
+
+// Time slices many GBCPU instances on one core, the way a batch worker does,
+// and reports host time and L1 data cache read misses per guest instruction.
+//
+// Usage: gb_cache_bench [-n instances] [-s slice] [-i instructions] rom
+
+static void load_instance(GBCPU *cpu, const uint8_t *image) {
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    memcpy(cpu->memory, image, 0x10000);
+    cpu->memory[0xFF44] = 0x90; // LY
+}
+
+static int open_l1d_counter() {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+int main(int argc, char **argv) {
+    size_t instance_count = 64;
+    size_t slice = 1000;
+    size_t total = 20000000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:i:")) != -1) {
+        switch (opt) {
+        case 'n':
+            instance_count = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            slice = strtoull(optarg, NULL, 0);
+            break;
+        case 'i':
+            total = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n instances] [-s slice] [-i instructions] rom\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind != argc - 1 || instance_count == 0 || slice == 0) {
+        fprintf(stderr, "Usage: %s [-n instances] [-s slice] [-i instructions] rom\n", argv[0]);
+        return 2;
+    }
+
+    uint8_t *image = calloc(0x10000, 1);
+    if (!read_binary(argv[optind], image)) {
+        return 2;
+    }
+
+    GBCPU **cpus = malloc(instance_count * sizeof(GBCPU *));
+    for (size_t i = 0; i < instance_count; ++i) {
+        cpus[i] = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+        load_instance(cpus[i], image);
+    }
+
+    int counter = open_l1d_counter();
+    if (counter >= 0) {
+#ifdef __linux__
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    size_t executed = 0;
+    while (executed < total) {
+        for (size_t i = 0; i < instance_count; ++i) {
+            GBCPU *cpu = cpus[i];
+            for (size_t n = 0; n < slice; ++n) {
+                cpu_clock(cpu, false, false);
+                if (cpu->crashed) {
+                    load_instance(cpu, image);
+                }
+                if (serial_buffer_eol(&cpu->buffer)) {
+                    serial_buffer_clear(&cpu->buffer);
+                }
+            }
+            executed += slice;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    long long misses = -1;
+    if (counter >= 0) {
+#ifdef __linux__
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counter, &misses, sizeof(misses)) != sizeof(misses)) {
+            misses = -1;
+        }
+#endif
+        close(counter);
+    }
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("instances        : %zu\n", instance_count);
+    printf("slice            : %zu\n", slice);
+    printf("instructions     : %zu\n", executed);
+    printf("ns/instruction   : %.2f\n", seconds * 1e9 / executed);
+    if (misses >= 0) {
+        printf("L1D misses/instr : %.4f\n", (double)misses / executed);
+    } else {
+        printf("L1D misses/instr : n/a (perf_event_open unavailable)\n");
+    }
+
+    for (size_t i = 0; i < instance_count; ++i) {
+        free(cpus[i]);
+    }
+    free(cpus);
+    free(image);
+    return 0;
+}
@@ -0,0 +1,98 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "blocks.h"
+#include "callstack.h"
+#include "gbcpu.h"
+#include "tools.h"
+
+// Profiles a ROM at the guest call stack level, see include/callstack.h.
+//
+// Usage: gb_flame [-b] [-c cycles] [-i interval] [-s rom.sym] rom.gb out.folded
+//
+// Runs the ROM until it crashes (the test ROMs end in an infinite loop) or
+// for the given number of guest cycles, sampling the call stack every
+// interval cycles, and writes the folded stacks, e.g. for
+//   flamegraph.pl out.folded > out.svg
+// -b runs on the block cache instead of cpu_clock, -s names frames from a
+// symbol file.
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-b] [-c cycles] [-i interval] [-s rom.sym] rom.gb out.folded\n", name);
+}
+
+int main(int argc, char **argv) {
+    bool blocks = false;
+    size_t cycle_budget = 0;
+    size_t interval = CALLSTACK_INTERVAL;
+    const char *symbols = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "bc:i:s:")) != -1) {
+        switch (opt) {
+        case 'b':
+            blocks = true;
+            break;
+        case 'c':
+            cycle_budget = strtoull(optarg, NULL, 0);
+            break;
+        case 'i':
+            interval = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            symbols = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind + 2 != argc || interval == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    if (!read_binary(argv[optind], cpu->memory)) {
+        return 2;
+    }
+    cpu->memory[0xFF44] = 0x90; // LY
+    callstack_attach(cpu, interval);
+    if (symbols && !callstack_load_symbols(cpu->calls, symbols)) {
+        return 2;
+    }
+    if (blocks) {
+        block_cache_attach(cpu);
+    }
+
+    while (!cpu->crashed && (cycle_budget == 0 || cpu->cycles < cycle_budget)) {
+        if (blocks) {
+            block_run(cpu);
+        } else {
+            cpu_clock(cpu, false, false);
+        }
+        callstack_poll(cpu);
+        if (serial_buffer_eol(&cpu->buffer)) {
+            serial_buffer_clear(&cpu->buffer);
+        }
+    }
+
+    FILE *out = fopen(argv[optind + 1], "w");
+    if (!out) {
+        perror(argv[optind + 1]);
+        return 2;
+    }
+    callstack_write_folded(cpu->calls, out);
+    fclose(out);
+    fprintf(stderr, "%s: %zu cycles, %u stacks\n", argv[optind + 1], cpu->cycles, cpu->calls->node_count);
+
+    callstack_detach(cpu);
+    block_cache_detach(cpu);
+    free(cpu);
+    return 0;
+}
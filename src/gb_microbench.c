@@ -0,0 +1,185 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "engines.h"
+#include "gbcpu.h"
+
+// Times the handlers of one opcode group at a time on tiny programs built in
+// GBCPU.memory, so a regression shows up in the group it is in instead of
+// disappearing in a whole-ROM average.
+//
+// Usage: gb_microbench [-n instructions] [-r repeats] [group...]
+//
+// A program is UNIT_COPIES copies of a short unit of instructions from the
+// group at $C000, closed by a JP back to the start, and runs for about n
+// guest instructions (default 2M) on every engine: cpu_clock, the block
+// cache and, built with GB_JIT, the recompiler. The fastest of the repeats
+// is reported as host ns per guest instruction; the closing JP is one
+// instruction in every loop pass and is included. Exits with 1 when a
+// program crashed or left its loop, so it doubles as a smoke test.
+
+#define UNIT_COPIES 16
+#define PROGRAM 0xC000
+#define SUBROUTINE 0xD000 // a RET for the CALLs of the jump group
+#define DATA 0xC800       // (HL) operand and LD (nn),SP target
+
+typedef struct {
+    const char *name;
+    uint8_t unit[16];
+    uint8_t size;
+    bool relocate; // unit[3] is the JP target as an offset into the unit, unit[6..7] become SUBROUTINE
+} Group;
+
+static const Group groups[] = {
+    // ADD A,B; SUB C; AND D; OR E; XOR H; CP L; ADC A,B; SBC A,C
+    {"alu_r_r", {0x80, 0x91, 0xA2, 0xB3, 0xAC, 0xBD, 0x88, 0x99}, 8, false},
+    // the same operations on (HL)
+    {"alu_r_hl", {0x86, 0x96, 0xA6, 0xB6, 0xAE, 0xBE, 0x8E, 0x9E}, 8, false},
+    // LD BC,nn; LD DE,nn; LD HL,nn; LD (nn),SP
+    {"ld16", {0x01, 0x34, 0x12, 0x11, 0x78, 0x56, 0x21, 0x00, 0xC8, 0x08, 0x00, 0xC8}, 12, false},
+    // JR +0; JP next; CALL SUBROUTINE, and the RET there
+    {"jump_call", {0x18, 0x00, 0xC3, 0x05, 0x00, 0xCD, 0x00, 0x00}, 8, true},
+    // RLC B; SWAP C; BIT 3,D; SET 2,E; RES 1,L; SRL L; RL A; SLA B
+    {"cb", {0xCB, 0x00, 0xCB, 0x31, 0xCB, 0x5A, 0xCB, 0xD3, 0xCB, 0x8D, 0xCB, 0x3D, 0xCB, 0x17, 0xCB, 0x20}, 16, false},
+    // PUSH BC; PUSH DE; POP HL; POP BC; PUSH AF; POP AF
+    {"stack", {0xC5, 0xD5, 0xE1, 0xC1, 0xF5, 0xF1}, 6, false},
+};
+
+#define GROUP_COUNT (sizeof(groups) / sizeof(groups[0]))
+
+static const Group *find_group(const char *name) {
+    for (size_t g = 0; g < GROUP_COUNT; ++g) {
+        if (strcmp(name, groups[g].name) == 0) {
+            return &groups[g];
+        }
+    }
+    return NULL;
+}
+
+static void emit_unit(GBCPU *cpu, const Group *group, uint16_t at) {
+    memcpy(&cpu->memory[at], group->unit, group->size);
+    if (group->relocate) {
+        uint16_t next = at + group->unit[3];
+        cpu->memory[at + 3] = next & 0xFF;
+        cpu->memory[at + 4] = next >> 8;
+        cpu->memory[at + 6] = SUBROUTINE & 0xFF;
+        cpu->memory[at + 7] = SUBROUTINE >> 8;
+    }
+}
+
+// the address one past the closing JP
+static uint16_t load_program(GBCPU *cpu, const Group *group) {
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    memset(cpu->memory, 0, sizeof(cpu->memory));
+    uint16_t at = PROGRAM;
+    for (size_t i = 0; i < UNIT_COPIES; ++i) {
+        emit_unit(cpu, group, at);
+        at += group->size;
+    }
+    cpu->memory[at++] = 0xC3; // JP PROGRAM
+    cpu->memory[at++] = PROGRAM & 0xFF;
+    cpu->memory[at++] = PROGRAM >> 8;
+    cpu->memory[SUBROUTINE] = 0xC9; // RET
+
+    cpu->reg.PC = PROGRAM;
+    cpu->reg.SP = 0xDFFE;
+    cpu->reg.HL = DATA;
+    cpu->reg.BC = 0x1234;
+    cpu->reg.DE = 0x5678;
+    return at;
+}
+
+// ns per instruction, negative when the program crashed or left its loop
+static double run(GBCPU *cpu, const Group *group, Engine engine, size_t instructions) {
+    uint16_t end = load_program(cpu, group);
+    engine_attach(cpu, engine);
+
+    double start = now_s();
+    while (cpu->instruction_count < instructions && !cpu->crashed) {
+        engine_step(cpu, engine);
+    }
+    double seconds = now_s() - start;
+
+    engine_detach(cpu);
+    bool in_loop = (cpu->reg.PC >= PROGRAM && cpu->reg.PC < end) || cpu->reg.PC == SUBROUTINE;
+    if (cpu->crashed || !in_loop) {
+        fprintf(stderr, "%s on %s left its loop at $%04X\n", group->name, engine_names[engine], cpu->reg.PC);
+        return -1.0;
+    }
+    return seconds * 1e9 / cpu->instruction_count;
+}
+
+int main(int argc, char **argv) {
+    size_t instructions = 2000000;
+    long repeats = 3;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch (opt) {
+        case 'n':
+            instructions = strtoull(optarg, NULL, 0);
+            break;
+        case 'r':
+            repeats = strtol(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n instructions] [-r repeats] [group...]\n", argv[0]);
+            return 2;
+        }
+    }
+    for (int i = optind; i < argc; ++i) {
+        if (!find_group(argv[i])) {
+            fprintf(stderr, "Unknown group %s\n", argv[i]);
+            repeats = 0;
+        }
+    }
+    if (repeats < 1) {
+        fprintf(stderr, "Usage: %s [-n instructions] [-r repeats] [group...]\n", argv[0]);
+        return 2;
+    }
+
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    int exit_code = 0;
+
+    printf("%-10s", "group");
+    for (Engine engine = 0; engine < ENGINES; ++engine) {
+        printf("  %9s", engine_names[engine]);
+    }
+    printf("  (ns/instruction)\n");
+
+    for (size_t g = 0; g < GROUP_COUNT; ++g) {
+        bool selected = optind == argc;
+        for (int i = optind; i < argc; ++i) {
+            selected |= find_group(argv[i]) == &groups[g];
+        }
+        if (!selected) {
+            continue;
+        }
+
+        printf("%-10s", groups[g].name);
+        for (Engine engine = 0; engine < ENGINES; ++engine) {
+            double best = -1.0;
+            for (long n = 0; n < repeats; ++n) {
+                double ns = run(cpu, &groups[g], engine, instructions);
+                if (ns < 0) {
+                    exit_code = 1;
+                    break;
+                }
+                if (best < 0 || ns < best) {
+                    best = ns;
+                }
+            }
+            printf("  %9.2f", best);
+        }
+        printf("\n");
+    }
+
+    free(cpu);
+    return exit_code;
+}
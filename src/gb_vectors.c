@@ -0,0 +1,124 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "breakpoints.h"
+#include "engines.h"
+#include "gbcpu.h"
+#include "vectors.h"
+
+// Writes or checks single-instruction test vectors, see include/vectors.h.
+//
+// Usage: gb_vectors -w [-n vectors] [-s seed] file
+//        gb_vectors [-e cpu|blocks|jit] [opcode...] file
+//
+// -w runs n vectors per opcode (default 64) through cpu_clock and writes
+// their results; the file in tests/ was written that way and is only
+// written again when cpu_clock is meant to change. Otherwise every opcode,
+// or the given ones in hex (CB37 for a prefixed one), is checked on an
+// engine. Each opcode with differing vectors is listed with its first
+// failure, and the exit code is 1 when there was any.
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s -w [-n vectors] [-s seed] file\n", name);
+#ifdef GB_JIT
+    fprintf(stderr, "       %s [-e cpu|blocks|jit] [opcode...] file\n", name);
+#else
+    fprintf(stderr, "       %s [-e cpu|blocks] [opcode...] file\n", name);
+#endif
+}
+
+int main(int argc, char **argv) {
+    bool write = false;
+    unsigned per_opcode = VECTORS_PER_OPCODE;
+    uint64_t seed = 0;
+    Engine engine = ENGINE_CPU;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "wn:s:e:")) != -1) {
+        switch (opt) {
+        case 'w':
+            write = true;
+            break;
+        case 'n':
+            per_opcode = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'e':
+            if (!engine_parse(optarg, &engine)) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc || per_opcode == 0 || per_opcode > UINT16_MAX) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char *file = argv[argc - 1];
+    if (write) {
+        if (optind != argc - 1) {
+            usage(argv[0]);
+            return 2;
+        }
+        return vectors_write(file, seed, per_opcode) ? 0 : 2;
+    }
+
+    bool selected[VECTOR_OPCODES];
+    memset(selected, optind == argc - 1, sizeof(selected));
+    for (int i = optind; i < argc - 1; ++i) {
+        unsigned long opcode = strtoul(argv[i], NULL, 16);
+        if (opcode >= 0xCB00 && opcode <= 0xCBFF) {
+            opcode = 0x100 + (opcode & 0xFF);
+        }
+        if (!vector_opcode_defined(opcode)) {
+            fprintf(stderr, "No vectors for opcode %s\n", argv[i]);
+            return 2;
+        }
+        selected[opcode] = true;
+    }
+
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    memset(cpu->memory, 0, sizeof(cpu->memory));
+    engine_attach(cpu, engine);
+
+    Vectors *vectors = vectors_open(file);
+    if (vectors == NULL) {
+        return 2;
+    }
+    size_t opcodes_checked = 0;
+    size_t opcodes_failed = 0;
+    size_t vectors_failed = 0;
+    for (unsigned opcode = 0; opcode < VECTOR_OPCODES; ++opcode) {
+        if (!selected[opcode] || !vector_opcode_defined(opcode)) {
+            continue;
+        }
+        size_t failed = vectors_check(vectors, cpu, opcode, engine_run_eager, &engine, stderr);
+        if (failed) {
+            fprintf(stderr, "%zu of %u vectors differ\n\n", failed, vectors->header->per_opcode);
+            opcodes_failed++;
+            vectors_failed += failed;
+        }
+        opcodes_checked++;
+    }
+    fprintf(stderr, "%s: %zu opcodes, %zu differ in %zu vectors\n", engine_names[engine], opcodes_checked, opcodes_failed,
+            vectors_failed);
+
+    vectors_close(vectors);
+    // vector_run attached breakpoints along with the block cache
+    breakpoints_detach(cpu);
+    engine_detach(cpu);
+    free(cpu);
+    return opcodes_failed ? 1 : 0;
+}
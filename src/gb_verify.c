@@ -0,0 +1,124 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "engines.h"
+#include "gbcpu.h"
+#include "tools.h"
+#include "verify.h"
+
+// Runs an engine against cpu_clock in lockstep, see include/verify.h.
+//
+// Usage: gb_verify [-e blocks|jit] [-n instructions] [-r programs] [-s seed] [rom...]
+//
+// Every ROM runs until it crashes (the test ROMs end in an infinite loop) or
+// for n instructions, then -r random programs of 512 bytes starting from
+// seed. The first divergence is reported on stderr and ends the run with
+// exit code 1.
+
+#define PROGRAM 0xC000
+#define PROGRAM_SIZE 0x200
+
+static GBCPU *new_cpu() {
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    return cpu;
+}
+
+// verifies an engine instance copied from reference
+static bool verify(GBCPU *reference, Engine kind, size_t instructions, const char *name) {
+    GBCPU *engine = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    memcpy(engine, reference, sizeof(GBCPU));
+    engine_attach(engine, kind);
+
+    Verifier verifier;
+    verify_attach(&verifier, reference, engine, engine_run, &kind);
+    bool ok = verify_run(&verifier, instructions);
+    if (!ok) {
+        fprintf(stderr, "%s:\n", name);
+        verify_report(&verifier, stderr);
+    }
+    verify_detach(&verifier);
+
+    engine_detach(engine);
+    free(engine);
+    return ok;
+}
+
+static void usage(const char *name) {
+#ifdef GB_JIT
+    fprintf(stderr, "Usage: %s [-e blocks|jit] [-n instructions] [-r programs] [-s seed] [rom...]\n", name);
+#else
+    fprintf(stderr, "Usage: %s [-e blocks] [-n instructions] [-r programs] [-s seed] [rom...]\n", name);
+#endif
+}
+
+int main(int argc, char **argv) {
+    Engine engine = ENGINE_BLOCKS;
+    size_t instructions = 0;
+    uint64_t programs = 0;
+    uint64_t seed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:n:r:s:")) != -1) {
+        switch (opt) {
+        case 'e':
+            // cpu_clock is the reference
+            if (!engine_parse(optarg, &engine) || engine == ENGINE_CPU) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'n':
+            instructions = strtoull(optarg, NULL, 0);
+            break;
+        case 'r':
+            programs = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind == argc && programs == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    for (int i = optind; i < argc; ++i) {
+        GBCPU *reference = new_cpu();
+        if (!read_binary(argv[i], reference->memory)) {
+            return 2;
+        }
+        reference->memory[0xFF44] = 0x90; // LY
+        bool ok = verify(reference, engine, instructions, argv[i]);
+        fprintf(stderr, "%s: %s, %zu instructions\n", argv[i], ok ? "ok" : "diverged", reference->instruction_count);
+        free(reference);
+        if (!ok) {
+            return 1;
+        }
+    }
+
+    for (uint64_t n = seed; n < seed + programs; ++n) {
+        GBCPU *reference = new_cpu();
+        verify_random_program(reference, n, PROGRAM, PROGRAM_SIZE);
+        char name[32];
+        snprintf(name, sizeof(name), "seed %llu", (unsigned long long)n);
+        bool ok = verify(reference, engine, instructions, name);
+        free(reference);
+        if (!ok) {
+            return 1;
+        }
+    }
+    if (programs) {
+        fprintf(stderr, "%llu random programs: ok\n", (unsigned long long)programs);
+    }
+    return 0;
+}
@@ -1,10 +1,23 @@
 #include "gbcpu.h"
-
+#include "alu_tables.h"
+#include "blocks.h"
+#include "breakpoints.h"
+#include "callstack.h"
+#include "disasm.h"
+#include "joypad.h"
+#include "memstats.h"
+#include "profile.h"
+#include "verify.h"
+
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
+_Static_assert(offsetof(GBCPU, memory) <= 2 * GBCPU_CACHE_LINE, "GBCPU hot fields must fit in two cache lines");
+
 void cpu_initialize(GBCPU *cpu) {
     cpu->reg.AF = 0x0000;
+    cpu->lazy.op = LAZY_NONE;
     cpu->reg.BC = 0x0000;
     cpu->reg.DE = 0x0000;
     cpu->reg.HL = 0x0000;
@@ -13,18 +26,31 @@ void cpu_initialize(GBCPU *cpu) {
 
     cpu->ime = false;
     cpu->opcode = 0x00;
+    cpu->joypad = 0x00;
     cpu->instruction_count = 0;
+    cpu->cycles = 0;
 
     cpu->src.ptr = NULL;
     cpu->src.addr = 0x000;
     cpu->src.reg = false;
 
     cpu->crashed = false;
+    cpu->blocks = NULL;
+    cpu->breakpoints = NULL;
+    cpu->calls = NULL;
+    cpu->writes = NULL;
+#ifdef GB_PROFILE
+    cpu->profile = NULL;
+#endif
+#ifdef GB_STATS
+    cpu->stats = NULL;
+#endif
     serial_buffer_clear(&cpu->buffer);
 }
 
 void cpu_reset(GBCPU *cpu) {
     cpu->reg.AF = 0x01B0;
+    cpu->lazy.op = LAZY_NONE;
     cpu->reg.BC = 0x0013;
     cpu->reg.DE = 0x00D8;
     cpu->reg.HL = 0x014D;
@@ -32,10 +58,15 @@ void cpu_reset(GBCPU *cpu) {
     cpu->reg.PC = 0x0100;
 
     memset(cpu->memory, '\0', 0x10000);
+    if (cpu->blocks) {
+        block_cache_flush(cpu->blocks);
+    }
 
     cpu->ime = false;
     cpu->opcode = 0x00;
+    cpu->joypad = 0x00;
     cpu->instruction_count = 0;
+    cpu->cycles = 0;
 
     cpu->src.ptr = NULL;
     cpu->src.addr = cpu->reg.PC;
@@ -49,6 +80,25 @@ void cpu_reset(GBCPU *cpu) {
     serial_buffer_clear(&cpu->buffer);
 }
 
+static uint8_t flags_resolve(uint8_t F, const LazyFlags *lazy) {
+    switch (lazy->op) {
+    case LAZY_ADD:
+        return (F & 0x0F) | alu_add[lazy->carry][ALU_PAIR(lazy->a, lazy->b)] >> 8;
+    case LAZY_SUB:
+        return (F & 0x0F) | alu_sub[lazy->carry][ALU_PAIR(lazy->a, lazy->b)] >> 8;
+    case LAZY_INC:
+        return (F & 0x0F) | lazy->carry << 4 | alu_inc[lazy->a] >> 8;
+    case LAZY_DEC:
+        return (F & 0x0F) | lazy->carry << 4 | alu_dec[lazy->a] >> 8;
+    }
+    return F;
+}
+
+void cpu_flags_materialize(GBCPU *cpu) {
+    cpu->reg.F = flags_resolve(cpu->reg.F, &cpu->lazy);
+    cpu->lazy.op = LAZY_NONE;
+}
+
 uint8_t cpu_read(GBCPU *cpu) {
     uint8_t data = cpu->memory[cpu->reg.PC];
     cpu->reg.PC++;
@@ -56,72 +106,123 @@ uint8_t cpu_read(GBCPU *cpu) {
 }
 
 void cpu_push(GBCPU *cpu, uint8_t value) {
+    memstats_write(cpu, cpu->reg.SP - 1);
+    breakpoints_store(cpu, cpu->reg.SP - 1, value);
+    verify_store(cpu, cpu->reg.SP - 1, value);
     cpu->memory[--cpu->reg.SP] = value;
+    if (cpu->blocks) {
+        block_cache_write(cpu->blocks, cpu->reg.SP);
+    }
 }
 
 uint8_t cpu_pop(GBCPU *cpu) {
+    memstats_read(cpu, cpu->reg.SP);
     return cpu->memory[cpu->reg.SP++];
 }
 
-static void disassemble(GBCPU *cpu, OpInstr *instr, uint16_t addr) {
-    sprintf(cpu->disassembly, "%8zu ", cpu->instruction_count);
-    sprintf(cpu->disassembly + 9, "$%04X ", addr);
-    sprintf(cpu->disassembly + 15, "[0x%02X ", cpu->memory[addr]);
-
-    if (instr->length > 1) {
-        sprintf(cpu->disassembly + 21, "0x%02X ", cpu->memory[addr + 1]);
-    } else {
-        sprintf(cpu->disassembly + 21, "     ");
-    }
+static char *append(char *out, const char *text) {
+    size_t length = strlen(text);
+    memcpy(out, text, length);
+    return out + length;
+}
 
-    if (instr->length > 2) {
-        sprintf(cpu->disassembly + 26, "0x%02X] ", cpu->memory[addr + 2]);
-    } else {
-        sprintf(cpu->disassembly + 26, "    ] ");
-    }
+uint8_t history_entry_flags(const HistoryEntry *entry) {
+    return flags_resolve(entry->reg.F, &entry->lazy);
+}
 
-    char op[20];
-    sprintf(op, "%s ", instr->name);
+void history_format_disassembly(const HistoryEntry *entry, size_t instruction, char *line) {
+    const cpu_registers *reg = &entry->reg;
+    uint8_t F = history_entry_flags(entry);
+    char op[GB_DISASM_SIZE];
+    uint8_t length = gb_disasm(entry->bytes, reg->PC, op);
 
-    if (instr->write_mode.repr[0] != '\0') {
-        sprintf(op + strlen(op), "%s", instr->write_mode.repr);
+    char *out = disasm_decimal(line, instruction, 8);
+    out = append(out, " $");
+    out = disasm_hex16(out, reg->PC);
+    out = append(out, " [0x");
+    out = disasm_hex8(out, entry->bytes[0]);
+    out = append(out, length > 1 ? " 0x" : "     ");
+    if (length > 1) {
+        out = disasm_hex8(out, entry->bytes[1]);
     }
-    if (instr->write_mode.repr[0] != '\0' && instr->read_mode.repr[0] != '\0') {
-        sprintf(op + strlen(op), ", ");
+    out = append(out, length > 2 ? " 0x" : "     ");
+    if (length > 2) {
+        out = disasm_hex8(out, entry->bytes[2]);
     }
-    if (instr->read_mode.repr[0] != '\0') {
-        sprintf(op + strlen(op), "%s", instr->read_mode.repr);
+    out = append(out, "] ");
+
+    // the longest text, LDH A, ($FF00+$xx), is 18 characters
+    size_t op_length = strlen(op);
+    op_length = op_length < 18 ? op_length : 18;
+    memcpy(out, op, op_length);
+    memset(out + op_length, ' ', 18 - op_length);
+    out += 18;
+
+    out = append(out, " A=");
+    out = disasm_hex8(out, reg->A);
+    out = append(out, " BC=");
+    out = disasm_hex16(out, reg->BC);
+    out = append(out, " DE=");
+    out = disasm_hex16(out, reg->DE);
+    out = append(out, " HL=");
+    out = disasm_hex16(out, reg->HL);
+    out = append(out, " SP=");
+    out = disasm_hex16(out, reg->SP);
+    *out++ = ' ';
+    *out++ = F & FLAG_Z ? 'z' : '.';
+    *out++ = F & FLAG_N ? 'n' : '.';
+    *out++ = F & FLAG_H ? 'h' : '.';
+    *out++ = F & FLAG_C ? 'c' : '.';
+    out = append(out, " F=");
+    out = disasm_hex8(out, F);
+    *out++ = ' ';
+    *out = '\0';
+}
+
+void history_format_doctor(const HistoryEntry *entry, char *line) {
+    const cpu_registers *reg = &entry->reg;
+    const uint8_t registers[] = {reg->A, history_entry_flags(entry), reg->B, reg->C, reg->D, reg->E,
+                                 reg->H, reg->L};
+    const char *names = "AFBCDEHL";
+
+    char *out = line;
+    for (size_t i = 0; i < sizeof(registers); ++i) {
+        *out++ = names[i];
+        *out++ = ':';
+        *out++ = ' ';
+        out = disasm_hex8(out, registers[i]);
+        *out++ = ' ';
     }
+    out = append(out, "SP: ");
+    out = disasm_hex16(out, reg->SP);
+    out = append(out, " PC: 00:");
+    out = disasm_hex16(out, reg->PC);
+    out = append(out, " (");
+    for (size_t i = 0; i < 4; ++i) {
+        out = disasm_hex8(out, entry->bytes[i]);
+        *out++ = i < 3 ? ' ' : ')';
+    }
+    *out = '\0';
+}
 
-    sprintf(cpu->disassembly + 32, "%-18s ", op);
-    sprintf(cpu->disassembly + 50, "A=%02X ", cpu->reg.A);
-    sprintf(cpu->disassembly + 55, "BC=%04X ", cpu->reg.BC);
-    sprintf(cpu->disassembly + 63, "DE=%04X ", cpu->reg.DE);
-    sprintf(cpu->disassembly + 71, "HL=%04X ", cpu->reg.HL);
-    sprintf(cpu->disassembly + 79, "SP=%04X ", cpu->reg.SP);
+static void disassemble(GBCPU *cpu, uint16_t addr) {
+    HistoryEntry entry;
+    history_entry_capture(&entry, cpu, addr);
+    history_format_disassembly(&entry, cpu->instruction_count, cpu->disassembly);
+}
 
-    sprintf(cpu->disassembly + 87, "%s", cpu->reg.flags.z ? "z" : ".");
-    sprintf(cpu->disassembly + 88, "%s", cpu->reg.flags.n ? "n" : ".");
-    sprintf(cpu->disassembly + 89, "%s", cpu->reg.flags.h ? "h" : ".");
-    sprintf(cpu->disassembly + 90, "%s", cpu->reg.flags.c ? "c" : ".");
-    sprintf(cpu->disassembly + 91, " F=%02X ", cpu->reg.F);
+bool cpu_history_line(const GBCPU *cpu, size_t instruction, char *line) {
+    if (instruction >= cpu->instruction_count || cpu->instruction_count - instruction > HISTORY_SIZE) {
+        return false;
+    }
+    history_format_disassembly(&cpu->history[instruction & (HISTORY_SIZE - 1)], instruction, line);
+    return true;
 }
 
 static void print_flags(GBCPU *cpu, uint16_t addr) {
-    sprintf(cpu->debug, "A: %02X ", cpu->reg.A);
-    sprintf(cpu->debug + 6, "F: %02X ", cpu->reg.F);
-    sprintf(cpu->debug + 12, "B: %02X ", cpu->reg.B);
-    sprintf(cpu->debug + 18, "C: %02X ", cpu->reg.C);
-    sprintf(cpu->debug + 24, "D: %02X ", cpu->reg.D);
-    sprintf(cpu->debug + 30, "E: %02X ", cpu->reg.E);
-    sprintf(cpu->debug + 36, "H: %02X ", cpu->reg.H);
-    sprintf(cpu->debug + 42, "L: %02X ", cpu->reg.L);
-    sprintf(cpu->debug + 48, "SP: %04X ", cpu->reg.SP);
-    sprintf(cpu->debug + 57, "PC: 00:%04X ", addr);
-    sprintf(cpu->debug + 69, "(%02X ", cpu->memory[addr + 0]);
-    sprintf(cpu->debug + 73, "%02X ", cpu->memory[addr + 1]);
-    sprintf(cpu->debug + 76, "%02X ", cpu->memory[addr + 2]);
-    sprintf(cpu->debug + 79, "%02X)", cpu->memory[addr + 3]);
+    HistoryEntry entry;
+    history_entry_capture(&entry, cpu, addr);
+    history_format_doctor(&entry, cpu->debug);
 }
 
 void cpu_clock(GBCPU *cpu, bool debug, bool disassembly) {
@@ -130,8 +231,9 @@ void cpu_clock(GBCPU *cpu, bool debug, bool disassembly) {
     cpu->opcode = opcode;
 
     OpInstr instr;
+    bool prefixed = opcode == 0xCB;
 
-    if (opcode == 0xCB) {
+    if (prefixed) {
         opcode = cpu_read(cpu);
         cpu->opcode = opcode;
 
@@ -151,9 +253,10 @@ void cpu_clock(GBCPU *cpu, bool debug, bool disassembly) {
         }
         instr = opcodes[opcode];
     }
+    cpu_history_record(cpu, addr);
 
     if (disassembly) {
-        disassemble(cpu, &instr, addr);
+        disassemble(cpu, addr);
     } else {
         cpu->disassembly[0] = '\0';
     }
@@ -163,34 +266,50 @@ void cpu_clock(GBCPU *cpu, bool debug, bool disassembly) {
         cpu->debug[0] = '\0';
     }
 
+#ifdef GB_PROFILE
+    uint64_t start = profile_begin(cpu->profile);
+#endif
     instr.read_mode.addr_mode_func(cpu, &cpu->src);
     instr.write_mode.addr_mode_func(cpu, &cpu->dst);
     instr.instruction(cpu);
+    cpu->cycles += instr.cycles;
+#ifdef GB_PROFILE
+    profile_end(cpu->profile, prefixed, opcode, instr.cycles, start);
+#endif
 
     if (cpu->memory[0xFF02] == 0x81) {
-        serial_buffer_push(&cpu->buffer, cpu->memory[0xFF01]);
-        // printf("%c", );
-        // if(cpu->memory[0xFF01] == 'P') {
-        //     cpu->crashed = true;
-        // }
-        cpu->memory[0xFF02] = 0x01;
+        cpu_serial_transfer(cpu);
     }
 
     if (addr == cpu->reg.PC) {
         // check for infinite loop
-        if (!disassembly) {
-            disassemble(cpu, &instr, addr);
-        }
-        cpu->crashed = true;
-        fprintf(stderr, "\033[0;31m");
-        fprintf(stderr, "Infinite loop, aborting!\n");
-        fprintf(stderr, "%s\n", &cpu->disassembly[0]);
-        fprintf(stderr, "\033[0m");
+        cpu_infinite_loop(cpu, addr);
     }
 
     cpu->instruction_count++;
 }
 
+void cpu_serial_transfer(GBCPU *cpu) {
+    serial_buffer_push(&cpu->buffer, cpu->memory[0xFF01]);
+    // printf("%c", );
+    // if(cpu->memory[0xFF01] == 'P') {
+    //     cpu->crashed = true;
+    // }
+    cpu->memory[0xFF02] = 0x01;
+}
+
+void cpu_infinite_loop(GBCPU *cpu, uint16_t addr) {
+    // keep the pre-execution disassembly when tracing was on
+    if (cpu->disassembly[0] == '\0') {
+        disassemble(cpu, addr);
+    }
+    cpu->crashed = true;
+    fprintf(stderr, "\033[0;31m");
+    fprintf(stderr, "Infinite loop, aborting!\n");
+    fprintf(stderr, "%s\n", &cpu->disassembly[0]);
+    fprintf(stderr, "\033[0m");
+}
+
 static void cpu_print_read_src(GBCPU *cpu, char *label) {
     printf("%s", &cpu->disassembly[0]);
     uint8_t value = cpu->memory[cpu->src.addr];
@@ -217,6 +336,7 @@ static void cpu_print_read_dst_16(GBCPU *cpu, char *label) {
 
 uint8_t cpu_read_from_src(GBCPU *cpu) {
     if (!cpu->src.reg) {
+        memstats_read(cpu, cpu->src.addr);
         if (cpu->dst.addr >= 0xE000 && cpu->src.addr < 0xFDFF) {
             cpu_print_read_src(cpu, "Echo RAM");
         } else if (cpu->src.addr == 0xFF0F) {
@@ -250,6 +370,8 @@ uint8_t cpu_read_from_src(GBCPU *cpu) {
 
 uint16_t cpu_read_from_src_16(GBCPU *cpu) {
     if (!cpu->src.reg) {
+        memstats_read(cpu, cpu->src.addr);
+        memstats_read(cpu, cpu->src.addr + 1);
         if (cpu->dst.addr >= 0xE000 && cpu->dst.addr < 0xFDFF) {
             cpu_print_read_src_16(cpu, "Echo RAM");
         } else if (cpu->src.addr == 0xFF0F) {
@@ -265,6 +387,7 @@ uint16_t cpu_read_from_src_16(GBCPU *cpu) {
 
 uint8_t cpu_read_from_dst(GBCPU *cpu) {
     if (!cpu->dst.reg) {
+        memstats_read(cpu, cpu->dst.addr);
         if (cpu->dst.addr >= 0xE000 && cpu->dst.addr < 0xFDFF) {
             cpu_print_read_dst(cpu, "Echo RAM");
         } else if (cpu->src.addr == 0xFF0F) {
@@ -294,6 +417,8 @@ uint8_t cpu_read_from_dst(GBCPU *cpu) {
 
 uint16_t cpu_read_from_dst_16(GBCPU *cpu) {
     if (!cpu->dst.reg) {
+        memstats_read(cpu, cpu->dst.addr);
+        memstats_read(cpu, cpu->dst.addr + 1);
         if (cpu->dst.addr >= 0xE000 && cpu->dst.addr < 0xFDFF) {
             cpu_print_read_dst_16(cpu, "Echo RAM");
         } else if (cpu->dst.addr == 0xDF7D) {
@@ -324,6 +449,8 @@ void cpu_write_to_dst(GBCPU *cpu, uint8_t value) {
     }
 
     if (!cpu->dst.reg) {
+        // counted before an interrupt raised through $FF0F returns early
+        memstats_write(cpu, cpu->dst.addr);
         if (cpu->dst.addr < 0x4000) {
             cpu_print_write(cpu, "ROM Bank 0", value);
         } else if (cpu->dst.addr >= 0x4000 && cpu->dst.addr < 0x8000) {
@@ -409,6 +536,7 @@ void cpu_write_to_dst(GBCPU *cpu, uint8_t value) {
                     }
 
                     cpu->reg.PC = addr;
+                    callstack_enter(cpu, addr);
                     return;
                 }
             } else if (cpu->dst.addr == 0xFF50) {
@@ -443,7 +571,18 @@ void cpu_write_to_dst(GBCPU *cpu, uint8_t value) {
         }
     }
 
+    if (!cpu->dst.reg) {
+        breakpoints_store(cpu, cpu->dst.addr, value);
+        verify_store(cpu, cpu->dst.addr, value);
+    }
     *((uint8_t *)cpu->dst.ptr) = value;
+
+    if (!cpu->dst.reg && cpu->dst.addr == 0xFF00) {
+        joypad_update(cpu);
+    }
+    if (!cpu->dst.reg && cpu->blocks) {
+        block_cache_write(cpu->blocks, cpu->dst.addr);
+    }
 }
 
 void cpu_write_to_dst_16(GBCPU *cpu, uint16_t value) {
@@ -478,8 +617,21 @@ void cpu_write_to_dst_16(GBCPU *cpu, uint16_t value) {
         }
     }
 
+    if (!cpu->dst.reg) {
+        memstats_write(cpu, cpu->dst.addr);
+        memstats_write(cpu, cpu->dst.addr + 1);
+        breakpoints_store(cpu, cpu->dst.addr, value & 0x00FF);
+        breakpoints_store(cpu, cpu->dst.addr + 1, (value >> 8) & 0x00FF);
+        verify_store(cpu, cpu->dst.addr, value & 0x00FF);
+        verify_store(cpu, cpu->dst.addr + 1, (value >> 8) & 0x00FF);
+    }
     *((uint8_t *)cpu->dst.ptr) = value & 0x00FF;
     *((uint8_t *)cpu->dst.ptr + 1) = (value >> 8) & 0x00FF;
+
+    if (!cpu->dst.reg && cpu->blocks) {
+        block_cache_write(cpu->blocks, cpu->dst.addr);
+        block_cache_write(cpu->blocks, cpu->dst.addr + 1);
+    }
 }
 
 void implied(GBCPU *cpu, DataAccess *data_access) {
@@ -571,6 +723,8 @@ void reg_l(GBCPU *cpu, DataAccess *data_access) {
 }
 
 void reg_af(GBCPU *cpu, DataAccess *data_access) {
+    // PUSH AF reads F, POP AF must not be overwritten by a pending operation
+    cpu_flags_sync(cpu);
     data_access->addr = 0x0000;
     data_access->ptr = (char *)&cpu->reg.AF;
     data_access->reg = true;
@@ -0,0 +1,126 @@
+#include "gbenv.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gbcpu.h"
+#include "joypad.h"
+#include "tools.h"
+
+#define LINE_CYCLES 456
+#define LINES_PER_FRAME 154
+
+struct GBEnv {
+    GBCPU *cpu;
+    uint8_t *rom;
+    unsigned frame_skip;
+    size_t line_cycles;
+    GBEnvObservation observation;
+};
+
+int gb_env_api_version(void) {
+    return GB_ENV_API_VERSION;
+}
+
+GBEnv *gb_env_create(const char *rom) {
+    GBEnv *env = calloc(1, sizeof(GBEnv));
+    if (!env) {
+        return NULL;
+    }
+    env->rom = calloc(0x10000, 1);
+    env->cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+
+    if (!env->rom || !env->cpu || !read_binary(rom, env->rom)) {
+        gb_env_destroy(env);
+        return NULL;
+    }
+
+    gb_env_reset(env);
+    return env;
+}
+
+void gb_env_destroy(GBEnv *env) {
+    if (env) {
+        free(env->cpu);
+        free(env->rom);
+        free(env);
+    }
+}
+
+void gb_env_reset(GBEnv *env) {
+    GBCPU *cpu = env->cpu;
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    memcpy(cpu->memory, env->rom, 0x10000);
+    cpu->memory[0xFF44] = 0x00; // LY
+    env->line_cycles = 0;
+
+    GBEnvObservation *observation = &env->observation;
+    observation->vram = &cpu->memory[0x8000];
+    observation->oam = &cpu->memory[0xFE00];
+    observation->memory = cpu->memory;
+    observation->serial = cpu->buffer.buffer;
+    observation->frame = 0;
+    observation->cycles = 0;
+    observation->crashed = false;
+}
+
+void gb_env_set_frame_skip(GBEnv *env, unsigned frame_skip) {
+    env->frame_skip = frame_skip;
+}
+
+bool gb_env_observe_range(GBEnv *env, uint16_t start, uint16_t length) {
+    GBEnvObservation *observation = &env->observation;
+    if (observation->range_count == GB_ENV_MAX_RANGES || start + (size_t)length > 0x10000) {
+        return false;
+    }
+
+    GBEnvRange *range = &observation->ranges[observation->range_count++];
+    range->ptr = &env->cpu->memory[start];
+    range->start = start;
+    range->length = length;
+    return true;
+}
+
+static void advance_ly(GBEnv *env, size_t cycles) {
+    // no PPU, but games poll LY to find VBlank so keep it moving
+    env->line_cycles += cycles;
+    while (env->line_cycles >= LINE_CYCLES) {
+        env->line_cycles -= LINE_CYCLES;
+        uint8_t *ly = &env->cpu->memory[0xFF44];
+        *ly = (*ly + 1) % LINES_PER_FRAME;
+    }
+}
+
+size_t gb_env_step(GBEnv *env, uint8_t buttons, size_t frames) {
+    GBCPU *cpu = env->cpu;
+    size_t frames_run = 0;
+
+    joypad_set(cpu, buttons);
+    // a line that was observed after the previous step is consumed
+    if (serial_buffer_eol(&cpu->buffer)) {
+        serial_buffer_clear(&cpu->buffer);
+    }
+
+    for (; frames_run < frames && !cpu->crashed; ++frames_run) {
+        size_t frame_end = cpu->cycles + GB_ENV_FRAME_CYCLES * (env->frame_skip + 1);
+        while (cpu->cycles < frame_end && !cpu->crashed) {
+            size_t cycles = cpu->cycles;
+            cpu_clock(cpu, false, false);
+            advance_ly(env, cpu->cycles - cycles);
+            if (cpu->buffer.pos == SERIAL_BUFFER_SIZE - 1) {
+                // keeps the buffer from filling up on output without line breaks
+                serial_buffer_clear(&cpu->buffer);
+            }
+        }
+        env->observation.frame += env->frame_skip + 1;
+    }
+
+    env->observation.cycles = cpu->cycles;
+    env->observation.crashed = cpu->crashed;
+    return frames_run;
+}
+
+const GBEnvObservation *gb_env_observe(GBEnv *env) {
+    return &env->observation;
+}
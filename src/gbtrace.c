@@ -0,0 +1,199 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "doctor.h"
+#include "gbcpu.h"
+#include "tools.h"
+#include "trace.h"
+
+// Records and renders binary traces, see include/trace.h.
+//
+// Usage:
+//   gbtrace -r rom.gb [-i instructions] trace.bin
+//   gbtrace [-d] [-p start-end] [-o opcode] [-s instruction] [-n count] trace.bin
+//   gbtrace -c reference.txt trace.bin
+//
+// -r runs the ROM in cpu_clock, the way test_roms does, until it crashes or
+// after the given number of instructions, and writes every instruction.
+// Otherwise the trace is printed in the disassembly format, or with -d in
+// the Gameboy Doctor format. -p keeps instructions with PC in the inclusive
+// hex range, -o those with one opcode (hex, CB37 for prefixed ones), -s
+// starts at an instruction number and -n stops after printing count lines.
+//
+// -c compares the trace from its start with a Gameboy Doctor log and stops
+// at the first difference, printing the instructions that led up to it.
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s -r rom.gb [-i instructions] trace.bin\n", name);
+    fprintf(stderr, "       %s [-d] [-p start-end] [-o opcode] [-s instruction] [-n count] trace.bin\n", name);
+    fprintf(stderr, "       %s -c reference.txt trace.bin\n", name);
+}
+
+static int record(const char *rom, const char *file, size_t last_instruction) {
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    if (!read_binary(rom, cpu->memory)) {
+        free(cpu);
+        return 2;
+    }
+    cpu->memory[0xFF44] = 0x90; // LY
+
+    TraceWriter *trace = trace_open(file, cpu);
+    if (trace == NULL) {
+        free(cpu);
+        return 2;
+    }
+    bool ok = true;
+    while (ok && !cpu->crashed && cpu->instruction_count < last_instruction) {
+        cpu_clock(cpu, false, false);
+        if (cpu->instruction_count % (HISTORY_SIZE / 2) == 0) {
+            ok = trace_sync(trace, cpu);
+        }
+    }
+    ok = trace_sync(trace, cpu) && ok;
+    ok = trace_close(trace) && ok;
+    fprintf(stderr, "%s: %zu instructions\n", file, cpu->instruction_count);
+    free(cpu);
+    return ok ? 0 : 1;
+}
+
+#define CONTEXT 8
+
+static int compare(TraceReader *reader, const char *file) {
+    DoctorLog *log = doctor_open(file);
+    if (log == NULL) {
+        return 2;
+    }
+
+    HistoryEntry context[CONTEXT];
+    uint64_t instruction = 0;
+    uint64_t compared = 0;
+    DoctorResult result = DOCTOR_MATCH;
+    while (trace_next(reader, &context[compared % CONTEXT], &instruction)) {
+        result = doctor_compare(log, &context[compared % CONTEXT]);
+        if (result != DOCTOR_MATCH) {
+            break;
+        }
+        compared++;
+    }
+
+    int status = 0;
+    if (result == DOCTOR_END) {
+        printf("%llu instructions match, the log ends before the trace\n", (unsigned long long)compared);
+    } else if (result != DOCTOR_MATCH) {
+        char line[HISTORY_LINE_SIZE];
+        uint64_t first = compared >= CONTEXT - 1 ? compared - (CONTEXT - 1) : 0;
+        for (uint64_t i = first; i <= compared; ++i) {
+            history_format_disassembly(&context[i % CONTEXT], instruction - (compared - i), line);
+            puts(line);
+        }
+        printf("%s\n", result == DOCTOR_MALFORMED ? "Malformed reference line" : "Divergence");
+        doctor_report(log, &context[compared % CONTEXT], stdout);
+        status = 1;
+    } else {
+        printf("%llu instructions match\n", (unsigned long long)compared);
+    }
+    doctor_close(log);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    const char *rom = NULL;
+    const char *reference = NULL;
+    size_t last_instruction = SIZE_MAX;
+    bool doctor = false;
+    unsigned start_pc = 0x0000;
+    unsigned end_pc = 0xFFFF;
+    long opcode = -1; // prefixed opcodes are 0x100 + the second byte
+    uint64_t first = 0;
+    size_t lines = SIZE_MAX;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:i:dp:o:s:n:c:")) != -1) {
+        switch (opt) {
+        case 'r':
+            rom = optarg;
+            break;
+        case 'i':
+            last_instruction = strtoull(optarg, NULL, 10);
+            break;
+        case 'd':
+            doctor = true;
+            break;
+        case 'p':
+            if (sscanf(optarg, "%x-%x", &start_pc, &end_pc) != 2) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'o':
+            opcode = strtol(optarg, NULL, 16);
+            if (opcode > 0xFF) {
+                if ((opcode >> 8) != 0xCB) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                opcode = 0x100 | (opcode & 0xFF);
+            }
+            break;
+        case 's':
+            first = strtoull(optarg, NULL, 10);
+            break;
+        case 'n':
+            lines = strtoull(optarg, NULL, 10);
+            break;
+        case 'c':
+            reference = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (rom != NULL) {
+        return record(rom, argv[optind], last_instruction);
+    }
+
+    TraceReader *reader = trace_reader_open(argv[optind]);
+    if (reader == NULL) {
+        return 2;
+    }
+    if (reference != NULL) {
+        int status = compare(reader, reference);
+        trace_reader_close(reader);
+        return status;
+    }
+    if (first > reader->header.first && !trace_seek(reader, first)) {
+        fprintf(stderr, "Instruction %llu is not in the trace\n", (unsigned long long)first);
+        trace_reader_close(reader);
+        return 1;
+    }
+
+    HistoryEntry entry;
+    uint64_t instruction;
+    char line[HISTORY_LINE_SIZE];
+    while (lines > 0 && trace_next(reader, &entry, &instruction)) {
+        long op = entry.bytes[0] == 0xCB ? 0x100 | entry.bytes[1] : entry.bytes[0];
+        if (entry.reg.PC < start_pc || entry.reg.PC > end_pc || (opcode >= 0 && op != opcode)) {
+            continue;
+        }
+        if (doctor) {
+            history_format_doctor(&entry, line);
+        } else {
+            history_format_disassembly(&entry, instruction, line);
+        }
+        puts(line);
+        lines--;
+    }
+    trace_reader_close(reader);
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "alu_tables.h"
+
+// Writes the ALU lookup tables declared in alu_tables.h as a C source file.
+//
+// Usage: gen_alu_tables output.c
+
+#define FLAG_Z 0x80
+#define FLAG_N 0x40
+#define FLAG_H 0x20
+#define FLAG_C 0x10
+
+static uint16_t entry(uint8_t result, uint8_t f) {
+    return (f | (result == 0 ? FLAG_Z : 0)) << 8 | result;
+}
+
+static uint16_t add(uint8_t a, uint8_t b, uint8_t carry) {
+    uint16_t result = a + b + carry;
+    uint8_t f = 0;
+    f |= ((a & 0x0F) + (b & 0x0F) + carry) > 0x0F ? FLAG_H : 0;
+    f |= result > 0xFF ? FLAG_C : 0;
+    return entry(result & 0xFF, f);
+}
+
+static uint16_t sub(uint8_t a, uint8_t b, uint8_t carry) {
+    uint8_t f = FLAG_N;
+    f |= (a & 0x0F) < (b & 0x0F) + carry ? FLAG_H : 0;
+    f |= a < b + carry ? FLAG_C : 0;
+    return entry((a - b - carry) & 0xFF, f);
+}
+
+static uint16_t inc(uint8_t value) {
+    uint8_t result = value + 1;
+    return entry(result, (result & 0x0F) == 0x00 ? FLAG_H : 0);
+}
+
+static uint16_t dec(uint8_t value) {
+    uint8_t result = value - 1;
+    return entry(result, FLAG_N | ((result & 0x0F) == 0x0F ? FLAG_H : 0));
+}
+
+static uint16_t daa(uint8_t value, uint8_t nhc) {
+    bool n = nhc & 0x04;
+    bool h = nhc & 0x02;
+    bool c = nhc & 0x01;
+    uint16_t a = value;
+    bool carry = false;
+
+    if (h) {
+        a += n ? 0x0A : 0x06;
+    } else if (!n && (a & 0x0F) > 0x09) {
+        a += 0x06;
+    }
+
+    if (c) {
+        if (n && h) {
+            a += 0x90;
+        } else if (n) {
+            a += 0xA0;
+        } else {
+            a += 0x60;
+        }
+        carry = true;
+    } else if (n && h) {
+        a += 0xF0;
+    } else if (!n && (a & 0xFFF0) > 0x90) {
+        a += 0x60;
+        carry = true;
+    }
+
+    return entry(a & 0xFF, (n ? FLAG_N : 0) | (carry ? FLAG_C : 0));
+}
+
+static uint16_t shift(int op, uint8_t value, uint8_t carry) {
+    uint8_t result = 0;
+    bool carry_out = false;
+    switch (op) {
+    case ALU_RLC:
+        result = value << 1 | value >> 7;
+        carry_out = value & 0x80;
+        break;
+    case ALU_RRC:
+        result = value >> 1 | value << 7;
+        carry_out = value & 0x01;
+        break;
+    case ALU_RL:
+        result = value << 1 | carry;
+        carry_out = value & 0x80;
+        break;
+    case ALU_RR:
+        result = value >> 1 | carry << 7;
+        carry_out = value & 0x01;
+        break;
+    case ALU_SLA:
+        result = value << 1;
+        carry_out = value & 0x80;
+        break;
+    case ALU_SRA:
+        result = (value & 0x80) | value >> 1;
+        carry_out = value & 0x01;
+        break;
+    case ALU_SWAP:
+        result = value << 4 | value >> 4;
+        break;
+    case ALU_SRL:
+        result = value >> 1;
+        carry_out = value & 0x01;
+        break;
+    }
+    return entry(result, carry_out ? FLAG_C : 0);
+}
+
+static void write_values(FILE *out, const uint16_t *values, size_t count, const char *indent) {
+    for (size_t i = 0; i < count; ++i) {
+        if (i % 16 == 0) {
+            fprintf(out, "%s", indent);
+        }
+        fprintf(out, "0x%04X,%s", values[i], i % 16 == 15 ? "\n" : " ");
+    }
+}
+
+static void write_pairs(FILE *out, const char *name, uint16_t (*op)(uint8_t, uint8_t, uint8_t)) {
+    static uint16_t values[0x10000];
+    fprintf(out, "const uint16_t %s[2][0x10000] = {\n", name);
+    for (uint8_t carry = 0; carry < 2; ++carry) {
+        for (uint32_t pair = 0; pair < 0x10000; ++pair) {
+            values[pair] = op(pair >> 8, pair & 0xFF, carry);
+        }
+        fprintf(out, "    {\n");
+        write_values(out, values, 0x10000, "        ");
+        fprintf(out, "    },\n");
+    }
+    fprintf(out, "};\n\n");
+}
+
+static void write_bytes(FILE *out, const char *name, uint16_t (*op)(uint8_t)) {
+    uint16_t values[0x100];
+    for (uint16_t value = 0; value < 0x100; ++value) {
+        values[value] = op(value);
+    }
+    fprintf(out, "const uint16_t %s[0x100] = {\n", name);
+    write_values(out, values, 0x100, "    ");
+    fprintf(out, "};\n\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s output.c\n", argv[0]);
+        return 1;
+    }
+    FILE *out = fopen(argv[1], "w");
+    if (out == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    uint16_t values[0x100];
+    fprintf(out, "// Generated by gen_alu_tables, do not edit.\n\n");
+    fprintf(out, "#include \"alu_tables.h\"\n\n");
+
+    write_pairs(out, "alu_add", add);
+    write_pairs(out, "alu_sub", sub);
+    write_bytes(out, "alu_inc", inc);
+    write_bytes(out, "alu_dec", dec);
+
+    fprintf(out, "const uint16_t alu_daa[8][0x100] = {\n");
+    for (uint8_t nhc = 0; nhc < 8; ++nhc) {
+        for (uint16_t value = 0; value < 0x100; ++value) {
+            values[value] = daa(value, nhc);
+        }
+        fprintf(out, "    {\n");
+        write_values(out, values, 0x100, "        ");
+        fprintf(out, "    },\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "const uint16_t alu_shift[8][2][0x100] = {\n");
+    for (int op = ALU_RLC; op <= ALU_SRL; ++op) {
+        fprintf(out, "    {\n");
+        for (uint8_t carry = 0; carry < 2; ++carry) {
+            for (uint16_t value = 0; value < 0x100; ++value) {
+                values[value] = shift(op, value, carry);
+            }
+            fprintf(out, "        {\n");
+            write_values(out, values, 0x100, "            ");
+            fprintf(out, "        },\n");
+        }
+        fprintf(out, "    },\n");
+    }
+    fprintf(out, "};\n");
+
+    return fclose(out) == 0 ? 0 : 1;
+}
@@ -1,18 +1,25 @@
 #include <stdio.h>
 
+#include "alu_tables.h"
+#include "callstack.h"
 #include "gbcpu.h"
 
+static inline void lazy_record(GBCPU *cpu, uint8_t op, uint8_t a, uint8_t b, uint8_t carry) {
+    cpu->lazy.op = op;
+    cpu->lazy.a = a;
+    cpu->lazy.b = b;
+    cpu->lazy.carry = carry;
+}
+
 void sbc(GBCPU *cpu) {
     // Subtract n from dst with carry
+    cpu_flags_sync(cpu);
     uint8_t a = cpu_read_from_dst(cpu);
     uint8_t b = cpu_read_from_src(cpu);
-    uint16_t result = a + ~(b - 1) - cpu->reg.flags.c;
-
-    cpu->reg.flags.z = ((result & 0xFF) == 0);
-    cpu->reg.flags.n = 1;
-    cpu->reg.flags.h = (a & 0x0f) < ((b & 0x0f) + cpu->reg.flags.c);
-    cpu->reg.flags.c = a < (b + cpu->reg.flags.c);
+    uint8_t carry = get_flag(&cpu->reg, FLAG_C);
+    uint16_t result = a + ~(b - 1) - carry;
 
+    lazy_record(cpu, LAZY_SUB, a, b, carry);
     cpu->reg.A = result & 0xFF;
 }
 
@@ -22,21 +29,15 @@ void sub(GBCPU *cpu) {
     uint8_t b = cpu_read_from_src(cpu);
     uint16_t result = a + ~(b - 1);
 
-    cpu->reg.flags.z = ((result & 0xFF) == 0);
-    cpu->reg.flags.n = 1;
-    cpu->reg.flags.h = (a & 0x0f) < (b & 0x0f);
-    cpu->reg.flags.c = a < b;
-
+    lazy_record(cpu, LAZY_SUB, a, b, 0);
     cpu->reg.A = result & 0xFF;
 }
 
 uint8_t add(GBCPU *cpu, uint8_t a, uint8_t b, bool carry) {
     // add a to b with carry, update flags
-    uint16_t result = a + b + carry;
-    cpu->reg.flags.z = ((result & 0xFF) == 0);
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.h = (((a & 0xF) + (b & 0xF) + carry) & 0x10) == 0x10;
-    cpu->reg.flags.c = result > 0xFF;
+    cpu_flags_sync(cpu);
+    uint16_t result = alu_add[carry][ALU_PAIR(a, b)];
+    cpu->reg.F = (cpu->reg.F & 0x0F) | result >> 8;
     return result & 0xFF;
 }
 
@@ -44,20 +45,21 @@ void add_8(GBCPU *cpu) {
     // Add src to dst
     uint8_t a = cpu_read_from_dst(cpu);
     uint8_t b = cpu_read_from_src(cpu);
-    uint8_t result = add(cpu, a, b, 0);
-    cpu_write_to_dst(cpu, result);
+    uint16_t result = a + b;
+    lazy_record(cpu, LAZY_ADD, a, b, 0);
+    cpu_write_to_dst(cpu, result & 0xFF);
 }
 
 void add_16(GBCPU *cpu) {
     // Add src to dst
-    uint8_t z = cpu->reg.flags.z;
+    cpu_flags_sync(cpu);
+    uint8_t z = cpu->reg.F & FLAG_Z;
     uint16_t a = cpu_read_from_dst_16(cpu);
     uint16_t b = cpu_read_from_src_16(cpu);
 
     uint8_t lo = add(cpu, a & 0xFF, b & 0xFF, 0);
-    uint8_t hi = add(cpu, (a >> 8) & 0xFF, (b >> 8) & 0xFF, cpu->reg.flags.c);
-    cpu->reg.flags.z = z;
-    cpu->reg.flags.n = 0;
+    uint8_t hi = add(cpu, (a >> 8) & 0xFF, (b >> 8) & 0xFF, get_flag(&cpu->reg, FLAG_C));
+    cpu->reg.F = (cpu->reg.F & ~(FLAG_Z | FLAG_N)) | z;
     cpu_write_to_dst_16(cpu, (hi << 8) | lo);
 }
 
@@ -66,9 +68,9 @@ uint16_t add_rel(GBCPU *cpu, uint16_t a, uint8_t b) {
     uint8_t hi = (a >> 8) & 0xFF;
 
     if ((b & 0x80) == 0x80) {
-        hi -= !cpu->reg.flags.c;
+        hi -= !get_flag(&cpu->reg, FLAG_C);
     } else {
-        hi += cpu->reg.flags.c;
+        hi += get_flag(&cpu->reg, FLAG_C);
     }
 
     return (hi << 8) | lo;
@@ -76,10 +78,13 @@ uint16_t add_rel(GBCPU *cpu, uint16_t a, uint8_t b) {
 
 void adc(GBCPU *cpu) {
     // add with carry
+    cpu_flags_sync(cpu);
     uint8_t a = cpu_read_from_dst(cpu);
     uint8_t b = cpu_read_from_src(cpu);
-    uint8_t result = add(cpu, a, b, cpu->reg.flags.c);
+    uint8_t carry = get_flag(&cpu->reg, FLAG_C);
+    uint16_t result = a + b + carry;
 
+    lazy_record(cpu, LAZY_ADD, a, b, carry);
     cpu_write_to_dst(cpu, result & 0xFF);
 }
 
@@ -90,8 +95,7 @@ void add_sp(GBCPU *cpu) {
 
     sp = add_rel(cpu, sp, r8);
 
-    cpu->reg.flags.z = 0;
-    cpu->reg.flags.n = 0;
+    cpu->reg.F &= ~(FLAG_Z | FLAG_N);
 
     cpu_write_to_dst_16(cpu, sp);
 }
@@ -100,67 +104,30 @@ void cp(GBCPU *cpu) {
     // Compare A with read value
     // USE SBC
     uint8_t value = cpu_read_from_src(cpu);
-    cpu->reg.flags.n = 1;
-    cpu->reg.flags.z = cpu->reg.A == value;
-    cpu->reg.flags.c = cpu->reg.A < value;
-    cpu->reg.flags.h = (cpu->reg.A & 0x0f) < (value & 0x0f);
+    lazy_record(cpu, LAZY_SUB, cpu->reg.A, value, 0);
 }
 
 void cpl(GBCPU *cpu) {
+    cpu_flags_sync(cpu);
     cpu->reg.A = ~cpu->reg.A;
-    cpu->reg.flags.h = 1;
-    cpu->reg.flags.n = 1;
+    cpu->reg.F |= FLAG_N | FLAG_H;
 }
 
 void ccf(GBCPU *cpu) {
-    cpu->reg.flags.h = 0;
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.c = ~cpu->reg.flags.c;
+    cpu_flags_sync(cpu);
+    cpu->reg.F = (cpu->reg.F & ~(FLAG_N | FLAG_H)) ^ FLAG_C;
 }
 
 void scf(GBCPU *cpu) {
-    cpu->reg.flags.h = 0;
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.c = 1;
+    cpu_flags_sync(cpu);
+    cpu->reg.F = (cpu->reg.F & ~(FLAG_N | FLAG_H)) | FLAG_C;
 }
 
 void daa(GBCPU *cpu) {
-    uint16_t a = cpu->reg.A;
-    bool carry = false;
-
-    if (cpu->reg.flags.h) {
-        if (cpu->reg.flags.n) {
-            a += 0x0A;
-        } else {
-            a += 0x06;
-        }
-    } else if (!cpu->reg.flags.n && ((a & 0x0F) > 0x09)) {
-        a += 0x06;
-    }
-
-    if (cpu->reg.flags.c) {
-        if (cpu->reg.flags.n && cpu->reg.flags.h) {
-            a += 0x90;
-        } else if (cpu->reg.flags.n) {
-            a += 0xA0;
-        } else {
-            a += 0x60;
-        }
-        carry = true;
-    } else if (cpu->reg.flags.n && cpu->reg.flags.h) {
-        a += 0xF0;
-    } else if (cpu->reg.flags.n) {
-        a += 0x00;
-    } else if ((a & 0xFFF0) > 0x90) {
-        a += 0x60;
-        carry = true;
-    }
-
-    cpu->reg.flags.z = ((a & 0x00FF) == 0);
-    cpu->reg.flags.h = 0;
-    cpu->reg.flags.c = carry;
-
-    cpu->reg.A = a & 0x00FF;
+    cpu_flags_sync(cpu);
+    uint16_t result = alu_daa[ALU_NHC(cpu->reg.F)][cpu->reg.A];
+    cpu->reg.F = (cpu->reg.F & 0x0F) | result >> 8;
+    cpu->reg.A = result & 0xFF;
 }
 
 void di(GBCPU *cpu) {
@@ -178,7 +145,8 @@ void jp(GBCPU *cpu) {
 }
 
 void jp_c(GBCPU *cpu) {
-    if (cpu->reg.flags.c) {
+    cpu_flags_sync(cpu);
+    if (cpu->reg.F & FLAG_C) {
         jp(cpu);
         // cycles 16
     } else {
@@ -187,7 +155,8 @@ void jp_c(GBCPU *cpu) {
 }
 
 void jp_z(GBCPU *cpu) {
-    if (cpu->reg.flags.z) {
+    cpu_flags_sync(cpu);
+    if (cpu->reg.F & FLAG_Z) {
         jp(cpu);
         // cycles 16
     } else {
@@ -196,7 +165,8 @@ void jp_z(GBCPU *cpu) {
 }
 
 void jp_nc(GBCPU *cpu) {
-    if (!(cpu->reg.flags.c)) {
+    cpu_flags_sync(cpu);
+    if (!(cpu->reg.F & FLAG_C)) {
         jp(cpu);
         // cycles 16
     } else {
@@ -205,7 +175,8 @@ void jp_nc(GBCPU *cpu) {
 }
 
 void jp_nz(GBCPU *cpu) {
-    if (!(cpu->reg.flags.z)) {
+    cpu_flags_sync(cpu);
+    if (!(cpu->reg.F & FLAG_Z)) {
         jp(cpu);
         // cycles 16
     } else {
@@ -219,7 +190,8 @@ void jr(GBCPU *cpu) {
 }
 
 void jr_c(GBCPU *cpu) {
-    if (cpu->reg.flags.c) {
+    cpu_flags_sync(cpu);
+    if (cpu->reg.F & FLAG_C) {
         jr(cpu);
         // cycles 12
     } else {
@@ -228,7 +200,8 @@ void jr_c(GBCPU *cpu) {
 }
 
 void jr_nc(GBCPU *cpu) {
-    if (!(cpu->reg.flags.c)) {
+    cpu_flags_sync(cpu);
+    if (!(cpu->reg.F & FLAG_C)) {
         jr(cpu);
         // cycles 12
     } else {
@@ -237,7 +210,8 @@ void jr_nc(GBCPU *cpu) {
 }
 
 void jr_nz(GBCPU *cpu) {
-    if (!(cpu->reg.flags.z)) {
+    cpu_flags_sync(cpu);
+    if (!(cpu->reg.F & FLAG_Z)) {
         jr(cpu);
         // cycles 12
     } else {
@@ -246,7 +220,8 @@ void jr_nz(GBCPU *cpu) {
 }
 
 void jr_z(GBCPU *cpu) {
-    if (cpu->reg.flags.z) {
+    cpu_flags_sync(cpu);
+    if (cpu->reg.F & FLAG_Z) {
         jr(cpu);
         // cycles 12
     } else {
@@ -282,8 +257,7 @@ void ldhl(GBCPU *cpu) {
 
     sp = add_rel(cpu, sp, rel);
     cpu->reg.HL = sp;
-    cpu->reg.flags.z = 0;
-    cpu->reg.flags.n = 0;
+    cpu->reg.F &= ~(FLAG_Z | FLAG_N);
 }
 
 void nop(GBCPU *cpu) {
@@ -296,21 +270,18 @@ void inc_16(GBCPU *cpu) {
 }
 
 void inc_8(GBCPU *cpu) {
-    bool carry = cpu->reg.flags.c;
+    // c is kept, so the pending one moves along into the record
+    uint8_t carry = cpu_flag_carry(cpu);
     uint8_t val = cpu_read_from_dst(cpu);
-    val = add(cpu, val, 1, false);
-    cpu->reg.flags.c = carry;
-    cpu_write_to_dst(cpu, val);
+    lazy_record(cpu, LAZY_INC, val, 0, carry);
+    cpu_write_to_dst(cpu, val + 1);
 }
 
 void dec_8(GBCPU *cpu) {
+    uint8_t carry = cpu_flag_carry(cpu);
     uint8_t val = cpu_read_from_dst(cpu); //*((uint8_t*)(cpu->dst));
-    val--;
-
-    cpu->reg.flags.z = val == 0;
-    cpu->reg.flags.n = 1;
-    cpu->reg.flags.h = ((val + 1) & 0x0f) < (val & 0x0f);
-    cpu_write_to_dst(cpu, val);
+    lazy_record(cpu, LAZY_DEC, val, 0, carry);
+    cpu_write_to_dst(cpu, val - 1);
 }
 
 void dec_16(GBCPU *cpu) {
@@ -322,67 +293,54 @@ void or (GBCPU * cpu) {
     uint8_t value = cpu_read_from_src(cpu);
     value = cpu->reg.A | value;
     cpu->reg.A = value;
-    cpu->reg.F = 0x00;
-    cpu->reg.flags.z = (value == 0);
+    cpu->reg.F = (value == 0) << 7;
+    cpu->lazy.op = LAZY_NONE;
 }
 
 void and (GBCPU * cpu) {
     uint8_t value = cpu_read_from_src(cpu);
     value = cpu->reg.A & value;
     cpu->reg.A = value;
-    cpu->reg.F = 0x00;
-    cpu->reg.flags.z = (value == 0);
-    cpu->reg.flags.h = 1;
+    cpu->reg.F = (value == 0) << 7 | 0x20;
+    cpu->lazy.op = LAZY_NONE;
 }
 
 void xor (GBCPU * cpu) {
     uint8_t value = cpu_read_from_src(cpu);
     value = cpu->reg.A ^ value;
     cpu->reg.A = value;
-    cpu->reg.F = 0x00;
-    cpu->reg.flags.z = (value == 0);
+    cpu->reg.F = (value == 0) << 7;
+    cpu->lazy.op = LAZY_NONE;
 }
 
-    void rla(GBCPU *cpu) {
-    // rotate A left insert carry at bit 0, new carry is msb
-    uint8_t value = cpu->reg.A;
-    uint8_t carry = cpu->reg.flags.c;
-    cpu->reg.F = 0x00;
-    cpu->reg.flags.c = (value & 0x80) == 0x80;
+static void rotate_a(GBCPU *cpu, uint8_t op, uint8_t carry) {
+    // unlike the CB versions these always clear z
+    uint16_t result = alu_shift[op][carry][cpu->reg.A];
+    cpu->reg.F = (result >> 8) & 0x10;
+    cpu->lazy.op = LAZY_NONE;
+    cpu->reg.A = result & 0xFF;
+}
 
-    value = (value << 1) | carry;
-    cpu->reg.A = value;
+void rla(GBCPU *cpu) {
+    // rotate A left insert carry at bit 0, new carry is msb
+    cpu_flags_sync(cpu);
+    rotate_a(cpu, ALU_RL, get_flag(&cpu->reg, FLAG_C));
 }
 
 void rlca(GBCPU *cpu) {
     // rotate A left insert msb at bit 0, new carry is msb
-    uint8_t value = cpu->reg.A;
-    cpu->reg.F = 0x00;
-    cpu->reg.flags.c = (value & 0x80) == 0x80;
-
-    value = (value << 1) | cpu->reg.flags.c;
-    cpu->reg.A = value;
+    rotate_a(cpu, ALU_RLC, 0);
 }
 
 void rra(GBCPU *cpu) {
     // rotate A right insert carry at bit 7, new carry is lsb
-    uint8_t value = cpu->reg.A;
-    uint8_t carry = cpu->reg.flags.c;
-    cpu->reg.F = 0x00;
-    cpu->reg.flags.c = value & 0x01;
-
-    value = (carry << 7) | (value >> 1);
-    cpu->reg.A = value;
+    cpu_flags_sync(cpu);
+    rotate_a(cpu, ALU_RR, get_flag(&cpu->reg, FLAG_C));
 }
 
 void rrca(GBCPU *cpu) {
     // rotate A right insert lsb at bit 7, new carry is lsb
-    uint8_t value = cpu->reg.A;
-    cpu->reg.F = 0x00;
-    cpu->reg.flags.c = value & 0x01;
-
-    value = (cpu->reg.flags.c << 7) | (value >> 1);
-    cpu->reg.A = value;
+    rotate_a(cpu, ALU_RRC, 0);
 }
 
 void call(GBCPU *cpu) {
@@ -390,10 +348,12 @@ void call(GBCPU *cpu) {
     cpu_push(cpu, cpu->reg.PC & 0x00FF);
 
     cpu->reg.PC = cpu_read_from_src_16(cpu);
+    callstack_enter(cpu, cpu->reg.PC);
 }
 
 void call_nz(GBCPU *cpu) {
-    if (!(cpu->reg.flags.z)) {
+    cpu_flags_sync(cpu);
+    if (!(cpu->reg.F & FLAG_Z)) {
         call(cpu);
     } else {
         // 12
@@ -401,7 +361,8 @@ void call_nz(GBCPU *cpu) {
 }
 
 void call_z(GBCPU *cpu) {
-    if (cpu->reg.flags.z) {
+    cpu_flags_sync(cpu);
+    if (cpu->reg.F & FLAG_Z) {
         call(cpu);
     } else {
         // 12
@@ -409,7 +370,8 @@ void call_z(GBCPU *cpu) {
 }
 
 void call_nc(GBCPU *cpu) {
-    if (!(cpu->reg.flags.c)) {
+    cpu_flags_sync(cpu);
+    if (!(cpu->reg.F & FLAG_C)) {
         call(cpu);
     } else {
         // 12
@@ -417,7 +379,8 @@ void call_nc(GBCPU *cpu) {
 }
 
 void call_c(GBCPU *cpu) {
-    if (cpu->reg.flags.c) {
+    cpu_flags_sync(cpu);
+    if (cpu->reg.F & FLAG_C) {
         call(cpu);
     } else {
         // 12
@@ -433,6 +396,7 @@ void rst(GBCPU *cpu) {
     cpu_push(cpu, cpu->reg.PC & 0x00FF);
 
     cpu->reg.PC = (0x00 << 8) | p;
+    callstack_enter(cpu, p);
 }
 
 void push(GBCPU *cpu) {
@@ -456,6 +420,7 @@ void pop(GBCPU *cpu) {
 }
 
 void ret(GBCPU *cpu) {
+    callstack_leave(cpu);
     uint8_t lo = cpu_pop(cpu);
     uint8_t hi = cpu_pop(cpu);
 
@@ -468,7 +433,8 @@ void reti(GBCPU *cpu) {
 }
 
 void ret_c(GBCPU *cpu) {
-    if (cpu->reg.flags.c) {
+    cpu_flags_sync(cpu);
+    if (cpu->reg.F & FLAG_C) {
         ret(cpu);
     } else {
         // 8
@@ -476,7 +442,8 @@ void ret_c(GBCPU *cpu) {
 }
 
 void ret_z(GBCPU *cpu) {
-    if (cpu->reg.flags.z) {
+    cpu_flags_sync(cpu);
+    if (cpu->reg.F & FLAG_Z) {
         ret(cpu);
     } else {
         // 8
@@ -484,7 +451,8 @@ void ret_z(GBCPU *cpu) {
 }
 
 void ret_nc(GBCPU *cpu) {
-    if (!cpu->reg.flags.c) {
+    cpu_flags_sync(cpu);
+    if (!(cpu->reg.F & FLAG_C)) {
         ret(cpu);
     } else {
         // 8
@@ -492,7 +460,8 @@ void ret_nc(GBCPU *cpu) {
 }
 
 void ret_nz(GBCPU *cpu) {
-    if (!cpu->reg.flags.z) {
+    cpu_flags_sync(cpu);
+    if (!(cpu->reg.F & FLAG_Z)) {
         ret(cpu);
     } else {
         // 8
@@ -502,122 +471,3 @@ void ret_nz(GBCPU *cpu) {
 void stop(GBCPU *cpu) {
     printf("Stopped at $%04X\n", cpu->reg.PC);
 }
-
-void bit(GBCPU *cpu) {
-    uint8_t bit_num = (cpu->opcode >> 3) & 0x07;
-    uint8_t value = cpu_read_from_dst(cpu);
-    uint8_t res = value & (0x01 << bit_num);
-
-    cpu->reg.flags.z = (res == 0);
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.h = 1;
-}
-
-void res(GBCPU *cpu) {
-    uint8_t bit_num = (cpu->opcode >> 3) & 0x07;
-    uint8_t value = cpu_read_from_dst(cpu);
-    uint8_t res = value & ~(0x01 << bit_num);
-    cpu_write_to_dst(cpu, res);
-}
-
-void set(GBCPU *cpu) {
-    uint8_t bit_num = (cpu->opcode >> 3) & 0x07;
-    uint8_t value = cpu_read_from_dst(cpu);
-    uint8_t res = value | (0x01 << bit_num);
-    cpu_write_to_dst(cpu, res);
-}
-
-void srl(GBCPU *cpu) {
-    uint8_t value = cpu_read_from_dst(cpu);
-
-    cpu->reg.flags.c = value & 0x01;
-
-    value = value >> 1;
-    cpu->reg.flags.z = (value == 0);
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.h = 0;
-    cpu_write_to_dst(cpu, value);
-}
-
-void sla(GBCPU *cpu) {
-    // shift left, bit 7 -> carry
-    uint8_t value = cpu_read_from_dst(cpu);
-    cpu->reg.flags.c = (value & 0x80) == 0x80;
-
-    value = value << 1;
-    cpu->reg.flags.z = (value == 0);
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.h = 0;
-    cpu_write_to_dst(cpu, value);
-}
-
-void sra(GBCPU *cpu) {
-    // shift right, bit 0 -> carry
-    uint8_t value = cpu_read_from_dst(cpu);
-    uint8_t bit_7 = value & 0x80;
-    cpu->reg.flags.c = value & 0x01;
-
-    value = bit_7 | (value >> 1);
-    cpu->reg.flags.z = (value == 0);
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.h = 0;
-    cpu_write_to_dst(cpu, value);
-}
-
-void rr(GBCPU *cpu) {
-    // rotate right through carry, LSB -> carry
-    uint8_t value = cpu_read_from_dst(cpu);
-    uint8_t carry = cpu->reg.flags.c;
-    cpu->reg.flags.c = value & 0x01;
-
-    value = (carry << 7) | value >> 1;
-    cpu->reg.flags.z = (value == 0);
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.h = 0;
-    cpu_write_to_dst(cpu, value);
-}
-
-void rrc(GBCPU *cpu) {
-    // rotate right LSB -> carry
-    uint8_t value = cpu_read_from_dst(cpu);
-    cpu->reg.flags.c = value & 0x01;
-    value = (cpu->reg.flags.c << 7) | value >> 1;
-    cpu->reg.flags.z = (value == 0);
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.h = 0;
-    cpu_write_to_dst(cpu, value);
-}
-
-void rl(GBCPU *cpu) {
-    uint8_t value = cpu_read_from_dst(cpu);
-    uint8_t carry = cpu->reg.flags.c;
-    cpu->reg.flags.c = (value & 0x80) == 0x80;
-
-    value = (value << 1) | carry;
-    cpu->reg.flags.z = (value == 0);
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.h = 0;
-    cpu_write_to_dst(cpu, value);
-}
-
-void rlc(GBCPU *cpu) {
-    uint8_t value = cpu_read_from_dst(cpu);
-    cpu->reg.flags.c = (value & 0x80) == 0x80;
-
-    value = (value << 1) | cpu->reg.flags.c;
-    cpu->reg.flags.z = (value == 0);
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.h = 0;
-    cpu_write_to_dst(cpu, value);
-}
-
-void swap(GBCPU *cpu) {
-    uint8_t value = cpu_read_from_dst(cpu);
-    value = ((value & 0x0F) << 4 | (value & 0xF0) >> 4);
-
-    cpu->reg.flags.z = (value == 0);
-    cpu->reg.flags.n = 0;
-    cpu->reg.flags.h = 0;
-    cpu->reg.flags.c = 0;
-    cpu_write_to_dst(cpu, value);
-}
@@ -0,0 +1,814 @@
+#define _DEFAULT_SOURCE
+#include "jit.h"
+#include "breakpoints.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "the recompiler only targets Linux x86-64"
+#endif
+
+// headroom for the largest possible block, every instruction going through
+// the (HL) read path
+#define JIT_MAX_BLOCK_CODE (BLOCK_MAX_INSTRUCTIONS * 512)
+
+enum {
+    RAX = 0,
+    RCX,
+    RDX,
+    RBX,
+    RSP,
+    RBP,
+    RSI,
+    RDI,
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15,
+};
+
+// x86 condition codes
+#define CC_E 0x4
+#define CC_NE 0x5
+
+// group 1 /digit
+#define OP_ADD 0
+#define OP_OR 1
+#define OP_AND 4
+#define OP_SUB 5
+#define OP_XOR 6
+#define OP_CMP 7
+
+// guest register index, same encoding as LANE_* in lockstep.h
+#define GUEST_B 0
+#define GUEST_C 1
+#define GUEST_D 2
+#define GUEST_E 3
+#define GUEST_H 4
+#define GUEST_L 5
+#define GUEST_F 6
+#define GUEST_A 7
+#define GUEST_NONE 8
+#define GUEST_IMMEDIATE 9
+#define GUEST_HL_PTR 10
+
+static const uint8_t host_reg[8] = {R10, R11, R12, R13, R14, R15, R9, R8};
+
+#define HOST_A R8
+#define HOST_F R9
+#define HOST_H R14
+#define HOST_L R15
+
+typedef enum {
+    NATIVE_NONE = 0, // call back into block_step
+    NATIVE_NOP,
+    NATIVE_LD,
+    NATIVE_ADD,
+    NATIVE_ADC,
+    NATIVE_SUB,
+    NATIVE_SBC,
+    NATIVE_AND,
+    NATIVE_XOR,
+    NATIVE_OR,
+    NATIVE_CP,
+    NATIVE_INC,
+    NATIVE_DEC,
+    NATIVE_CPL,
+    NATIVE_SCF,
+    NATIVE_CCF,
+    NATIVE_JUMP, // JP nn / JR e, taken or conditional
+} NativeKind;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t src;
+    uint8_t dst;
+    uint8_t flag_mask;  // flag tested by a conditional jump, 0 if unconditional
+    bool flag_set;      // jump when the flag is set
+    bool flags_dead;    // the next instruction overwrites every flag this one writes
+    uint16_t target;    // static jump target
+} NativeOp;
+
+typedef struct {
+    uint8_t *code;
+    size_t pos;
+    size_t exit_patches[BLOCK_MAX_INSTRUCTIONS];
+    size_t exit_count;
+    size_t pending_cycles;
+    size_t pending_instructions;
+} Emitter;
+
+static void emit8(Emitter *e, uint8_t value) {
+    e->code[e->pos++] = value;
+}
+
+static void emit32(Emitter *e, uint32_t value) {
+    memcpy(&e->code[e->pos], &value, 4);
+    e->pos += 4;
+}
+
+static void emit64(Emitter *e, uint64_t value) {
+    memcpy(&e->code[e->pos], &value, 8);
+    e->pos += 8;
+}
+
+static void emit_rex(Emitter *e, bool w, uint8_t reg, uint8_t index, uint8_t rm, bool force) {
+    uint8_t rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (rm >> 3);
+    if (rex != 0x40 || force) {
+        emit8(e, rex);
+    }
+}
+
+static void emit_modrm(Emitter *e, uint8_t mod, uint8_t reg, uint8_t rm) {
+    emit8(e, (mod << 6) | ((reg & 7) << 3) | (rm & 7));
+}
+
+// op r/m32, r32
+static void emit_rr(Emitter *e, uint8_t opcode, uint8_t dst, uint8_t src) {
+    emit_rex(e, false, src, 0, dst, false);
+    emit8(e, opcode);
+    emit_modrm(e, 3, src, dst);
+}
+
+static void emit_mov(Emitter *e, uint8_t dst, uint8_t src) {
+    emit_rr(e, 0x89, dst, src);
+}
+
+static void emit_alu(Emitter *e, uint8_t op, uint8_t dst, uint8_t src) {
+    emit_rr(e, (op << 3) | 0x01, dst, src);
+}
+
+static void emit_alu_imm(Emitter *e, uint8_t op, uint8_t dst, uint32_t imm) {
+    emit_rex(e, false, 0, 0, dst, false);
+    emit8(e, 0x81);
+    emit_modrm(e, 3, op, dst);
+    emit32(e, imm);
+}
+
+static void emit_mov_imm(Emitter *e, uint8_t dst, uint32_t imm) {
+    emit_rex(e, false, 0, 0, dst, false);
+    emit8(e, 0xB8 + (dst & 7));
+    emit32(e, imm);
+}
+
+static void emit_shl(Emitter *e, uint8_t dst, uint8_t count) {
+    emit_rex(e, false, 0, 0, dst, false);
+    emit8(e, 0xC1);
+    emit_modrm(e, 3, 4, dst);
+    emit8(e, count);
+}
+
+static void emit_shr(Emitter *e, uint8_t dst, uint8_t count) {
+    emit_rex(e, false, 0, 0, dst, false);
+    emit8(e, 0xC1);
+    emit_modrm(e, 3, 5, dst);
+    emit8(e, count);
+}
+
+// movzx dst, low byte of src (al, cl or dl)
+static void emit_zero_extend(Emitter *e, uint8_t dst, uint8_t src) {
+    emit_rex(e, false, dst, 0, src, false);
+    emit8(e, 0x0F);
+    emit8(e, 0xB6);
+    emit_modrm(e, 3, dst, src);
+}
+
+// movzx dst, byte [rbx + disp]
+static void emit_load8(Emitter *e, uint8_t dst, uint32_t disp) {
+    emit_rex(e, false, dst, 0, RBX, false);
+    emit8(e, 0x0F);
+    emit8(e, 0xB6);
+    emit_modrm(e, 2, dst, RBX);
+    emit32(e, disp);
+}
+
+// movzx dst, byte [rbx + index + disp]
+static void emit_load8_indexed(Emitter *e, uint8_t dst, uint8_t index, uint32_t disp) {
+    emit_rex(e, false, dst, index, RBX, false);
+    emit8(e, 0x0F);
+    emit8(e, 0xB6);
+    emit_modrm(e, 2, dst, RSP); // SIB follows
+    emit8(e, ((index & 7) << 3) | RBX);
+    emit32(e, disp);
+}
+
+// mov byte [rbx + disp], low byte of src
+static void emit_store8(Emitter *e, uint8_t src, uint32_t disp) {
+    emit_rex(e, false, src, 0, RBX, src >= RSP);
+    emit8(e, 0x88);
+    emit_modrm(e, 2, src, RBX);
+    emit32(e, disp);
+}
+
+static void emit_store8_imm(Emitter *e, uint32_t disp, uint8_t imm) {
+    emit8(e, 0xC6);
+    emit_modrm(e, 2, 0, RBX);
+    emit32(e, disp);
+    emit8(e, imm);
+}
+
+static void emit_store16_imm(Emitter *e, uint32_t disp, uint16_t imm) {
+    emit8(e, 0x66);
+    emit8(e, 0xC7);
+    emit_modrm(e, 2, 0, RBX);
+    emit32(e, disp);
+    emit8(e, imm & 0xFF);
+    emit8(e, imm >> 8);
+}
+
+// add qword [rbx + disp], imm
+static void emit_add_mem64(Emitter *e, uint32_t disp, uint32_t imm) {
+    emit_rex(e, true, 0, 0, RBX, false);
+    emit8(e, 0x81);
+    emit_modrm(e, 2, OP_ADD, RBX);
+    emit32(e, disp);
+    emit32(e, imm);
+}
+
+static void emit_test_imm(Emitter *e, uint8_t reg, uint32_t imm) {
+    emit_rex(e, false, 0, 0, reg, false);
+    emit8(e, 0xF7);
+    emit_modrm(e, 3, 0, reg);
+    emit32(e, imm);
+}
+
+static size_t emit_jcc(Emitter *e, uint8_t cc) {
+    emit8(e, 0x0F);
+    emit8(e, 0x80 | cc);
+    emit32(e, 0);
+    return e->pos - 4;
+}
+
+static size_t emit_jmp(Emitter *e) {
+    emit8(e, 0xE9);
+    emit32(e, 0);
+    return e->pos - 4;
+}
+
+static void patch_here(Emitter *e, size_t patch) {
+    uint32_t rel = e->pos - (patch + 4);
+    memcpy(&e->code[patch], &rel, 4);
+}
+
+static void emit_push(Emitter *e, uint8_t reg) {
+    emit_rex(e, false, 0, 0, reg, false);
+    emit8(e, 0x50 + (reg & 7));
+}
+
+static void emit_pop(Emitter *e, uint8_t reg) {
+    emit_rex(e, false, 0, 0, reg, false);
+    emit8(e, 0x58 + (reg & 7));
+}
+
+static void emit_mov_imm64(Emitter *e, uint8_t dst, uint64_t imm) {
+    emit_rex(e, true, 0, 0, dst, false);
+    emit8(e, 0xB8 + (dst & 7));
+    emit64(e, imm);
+}
+
+static uint32_t guest_offset(uint8_t guest) {
+    switch (guest) {
+    case GUEST_B:
+        return offsetof(GBCPU, reg.B);
+    case GUEST_C:
+        return offsetof(GBCPU, reg.C);
+    case GUEST_D:
+        return offsetof(GBCPU, reg.D);
+    case GUEST_E:
+        return offsetof(GBCPU, reg.E);
+    case GUEST_H:
+        return offsetof(GBCPU, reg.H);
+    case GUEST_L:
+        return offsetof(GBCPU, reg.L);
+    case GUEST_F:
+        return offsetof(GBCPU, reg.F);
+    default:
+        return offsetof(GBCPU, reg.A);
+    }
+}
+
+static void emit_load_guest(Emitter *e) {
+    for (uint8_t i = 0; i < 8; ++i) {
+        emit_load8(e, host_reg[i], guest_offset(i));
+    }
+}
+
+static void emit_store_guest(Emitter *e) {
+    for (uint8_t i = 0; i < 8; ++i) {
+        emit_store8(e, host_reg[i], guest_offset(i));
+    }
+}
+
+static void emit_flush_counters(Emitter *e) {
+    if (e->pending_instructions) {
+        emit_add_mem64(e, offsetof(GBCPU, cycles), e->pending_cycles);
+        emit_add_mem64(e, offsetof(GBCPU, instruction_count), e->pending_instructions);
+        e->pending_cycles = 0;
+        e->pending_instructions = 0;
+    }
+}
+
+static void emit_epilogue(Emitter *e) {
+    emit_pop(e, R15);
+    emit_pop(e, R14);
+    emit_pop(e, R13);
+    emit_pop(e, R12);
+    emit_pop(e, RBX);
+    emit8(e, 0xC3);
+}
+
+// native code keeps F in a host register, so flags recorded lazily by the
+// interpreted instruction are materialised before they are reloaded
+static bool jit_step(GBCPU *cpu, const Block *block, const BlockInstr *d) {
+    bool next = block_step(cpu, block, d);
+    cpu_flags_sync(cpu);
+    return next;
+}
+
+// run one instruction through jit_step, leave the block if it did not
+// fall through
+static void emit_interpreted(Emitter *e, const Block *block, const BlockInstr *d, bool last) {
+    emit_flush_counters(e);
+    emit_store_guest(e);
+    emit_mov_imm64(e, RSI, (uintptr_t)block);
+    emit_mov_imm64(e, RDX, (uintptr_t)d);
+    emit_mov_imm64(e, RAX, (uintptr_t)jit_step);
+    emit_rex(e, true, RBX, 0, RDI, false);
+    emit8(e, 0x89); // mov rdi, rbx
+    emit_modrm(e, 3, RBX, RDI);
+    emit8(e, 0xFF); // call rax
+    emit_modrm(e, 3, 2, RAX);
+    if (last) {
+        // jit_step already set PC and wrote the guest state back
+        emit_epilogue(e);
+        return;
+    }
+    emit8(e, 0x84); // test al, al
+    emit_modrm(e, 3, RAX, RAX);
+    e->exit_patches[e->exit_count++] = emit_jcc(e, CC_E);
+    emit_load_guest(e);
+}
+
+static uint8_t guest_operand(AddrModeFunc func) {
+    if (func == reg_b) {
+        return GUEST_B;
+    } else if (func == reg_c) {
+        return GUEST_C;
+    } else if (func == reg_d) {
+        return GUEST_D;
+    } else if (func == reg_e) {
+        return GUEST_E;
+    } else if (func == reg_h) {
+        return GUEST_H;
+    } else if (func == reg_l) {
+        return GUEST_L;
+    } else if (func == reg_a) {
+        return GUEST_A;
+    } else if (func == immediate) {
+        return GUEST_IMMEDIATE;
+    } else if (func == reg_hl_ptr) {
+        return GUEST_HL_PTR;
+    } else if (func == implied) {
+        return GUEST_NONE;
+    }
+    return 0xFF;
+}
+
+static bool is_register(uint8_t guest) {
+    return guest < 8;
+}
+
+static NativeOp classify(GBCPU *cpu, const BlockInstr *d) {
+    NativeOp op = {NATIVE_NONE, GUEST_NONE, GUEST_NONE, 0, false, false, 0};
+    const OpInstr *instr = d->instr;
+    if (instr == &prefix_opcodes[d->opcode]) {
+        return op;
+    }
+
+    Instruction f = instr->instruction;
+    uint8_t src = guest_operand(instr->read_mode.addr_mode_func);
+    uint8_t dst = guest_operand(instr->write_mode.addr_mode_func);
+    bool alu_src = is_register(src) || src == GUEST_IMMEDIATE || src == GUEST_HL_PTR;
+    bool alu_a = alu_src && (dst == GUEST_A || dst == GUEST_NONE);
+    op.src = src;
+    op.dst = dst;
+
+    if (f == nop) {
+        op.kind = NATIVE_NOP;
+    } else if (f == ld_8 && alu_src && is_register(dst)) {
+        op.kind = NATIVE_LD;
+    } else if (f == add_8 && alu_a) {
+        op.kind = NATIVE_ADD;
+    } else if (f == adc && alu_a) {
+        op.kind = NATIVE_ADC;
+    } else if (f == sub && alu_a) {
+        op.kind = NATIVE_SUB;
+    } else if (f == sbc && alu_a) {
+        op.kind = NATIVE_SBC;
+    } else if (f == and && alu_a) {
+        op.kind = NATIVE_AND;
+    } else if (f == xor && alu_a) {
+        op.kind = NATIVE_XOR;
+    } else if (f == or && alu_a) {
+        op.kind = NATIVE_OR;
+    } else if (f == cp && alu_a) {
+        op.kind = NATIVE_CP;
+    } else if (f == inc_8 && is_register(dst)) {
+        op.kind = NATIVE_INC;
+    } else if (f == dec_8 && is_register(dst)) {
+        op.kind = NATIVE_DEC;
+    } else if (f == cpl) {
+        op.kind = NATIVE_CPL;
+    } else if (f == scf) {
+        op.kind = NATIVE_SCF;
+    } else if (f == ccf) {
+        op.kind = NATIVE_CCF;
+    } else if (src == GUEST_IMMEDIATE && (f == jr || f == jr_nz || f == jr_z || f == jr_nc || f == jr_c)) {
+        op.kind = NATIVE_JUMP;
+        op.target = d->next + (int8_t)cpu->memory[d->src.addr];
+    } else if (instr->read_mode.addr_mode_func == immediate_ext && (f == jp || f == jp_nz || f == jp_z || f == jp_nc || f == jp_c)) {
+        op.kind = NATIVE_JUMP;
+        op.target = cpu->memory[d->src.addr] | (cpu->memory[d->src.addr + 1] << 8);
+    }
+
+    if (op.kind == NATIVE_JUMP) {
+        op.flag_mask = (f == jr_nz || f == jr_z || f == jp_nz || f == jp_z) ? 0x80 : (f == jr || f == jp) ? 0x00 : 0x10;
+        op.flag_set = f == jr_z || f == jr_c || f == jp_z || f == jp_c;
+        if (op.target == d->addr) {
+            // leave the infinite loop report to the interpreter
+            op.kind = NATIVE_NONE;
+        }
+    }
+    return op;
+}
+
+static bool clears_low_nibble(uint8_t kind) {
+    return kind == NATIVE_AND || kind == NATIVE_XOR || kind == NATIVE_OR;
+}
+
+static bool overwrites_flags(uint8_t kind) {
+    return kind == NATIVE_ADD || kind == NATIVE_SUB || kind == NATIVE_CP || clears_low_nibble(kind);
+}
+
+static void mark_dead_flags(NativeOp *ops, uint8_t count) {
+    // AND/OR/XOR replace F entirely, ADD/SUB/CP keep the low nibble, which
+    // only AND/OR/XOR would have changed
+    for (uint8_t i = 0; i + 1 < count; ++i) {
+        uint8_t next = ops[i + 1].kind;
+        ops[i].flags_dead = clears_low_nibble(next) || (overwrites_flags(next) && !clears_low_nibble(ops[i].kind));
+    }
+}
+
+// ecx = operand, eax = address for (HL)
+static void emit_operand(Emitter *e, GBCPU *cpu, const BlockInstr *d, uint8_t src) {
+    if (src == GUEST_IMMEDIATE) {
+        emit_mov_imm(e, RCX, cpu->memory[d->src.addr]);
+    } else if (src == GUEST_HL_PTR) {
+        emit_mov(e, RAX, HOST_H);
+        emit_shl(e, RAX, 8);
+        emit_alu(e, OP_OR, RAX, HOST_L);
+        emit_load8_indexed(e, RCX, RAX, offsetof(GBCPU, memory));
+    } else {
+        emit_mov(e, RCX, host_reg[src]);
+    }
+}
+
+// edi = 0x80 if eax is zero
+static void emit_zero_flag(Emitter *e) {
+    emit_alu_imm(e, OP_CMP, RAX, 1);
+    emit_rr(e, 0x19, RDI, RDI); // sbb edi, edi
+    emit_alu_imm(e, OP_AND, RDI, 0x80);
+}
+
+// edx = carry flag as 0 or 1
+static void emit_carry_in(Emitter *e) {
+    emit_mov(e, RDX, HOST_F);
+    emit_shr(e, RDX, 4);
+    emit_alu_imm(e, OP_AND, RDX, 1);
+}
+
+static void emit_add(Emitter *e, const NativeOp *op) {
+    bool carry = op->kind == NATIVE_ADC;
+    if (carry) {
+        emit_carry_in(e);
+    }
+    emit_mov(e, RAX, HOST_A);
+    emit_alu(e, OP_ADD, RAX, RCX);
+    if (carry) {
+        emit_alu(e, OP_ADD, RAX, RDX);
+    }
+
+    if (!op->flags_dead) {
+        // h from the low nibbles, c from bit 8 of the sum
+        emit_mov(e, RSI, HOST_A);
+        emit_alu_imm(e, OP_AND, RSI, 0x0F);
+        emit_alu_imm(e, OP_AND, RCX, 0x0F);
+        emit_alu(e, OP_ADD, RSI, RCX);
+        if (carry) {
+            emit_alu(e, OP_ADD, RSI, RDX);
+        }
+        emit_alu_imm(e, OP_AND, RSI, 0x10);
+        emit_shl(e, RSI, 1);
+        emit_mov(e, RDX, RAX);
+        emit_shr(e, RDX, 4);
+        emit_alu_imm(e, OP_AND, RDX, 0x10);
+        emit_alu(e, OP_OR, RSI, RDX);
+        emit_zero_extend(e, RAX, RAX);
+        emit_zero_flag(e);
+        emit_alu(e, OP_OR, RSI, RDI);
+        emit_alu_imm(e, OP_AND, HOST_F, 0x0F);
+        emit_alu(e, OP_OR, HOST_F, RSI);
+    }
+    emit_zero_extend(e, HOST_A, RAX);
+}
+
+static void emit_sub(Emitter *e, const NativeOp *op) {
+    bool carry = op->kind == NATIVE_SBC;
+    if (carry) {
+        emit_carry_in(e);
+    }
+    emit_mov(e, RAX, HOST_A);
+    emit_alu(e, OP_SUB, RAX, RCX);
+    if (carry) {
+        emit_alu(e, OP_SUB, RAX, RDX);
+    }
+
+    if (!op->flags_dead) {
+        // borrows show up as the sign of the 32-bit differences
+        emit_mov(e, RSI, HOST_A);
+        emit_alu_imm(e, OP_AND, RSI, 0x0F);
+        emit_alu_imm(e, OP_AND, RCX, 0x0F);
+        emit_alu(e, OP_SUB, RSI, RCX);
+        if (carry) {
+            emit_alu(e, OP_SUB, RSI, RDX);
+        }
+        emit_shr(e, RSI, 31);
+        emit_shl(e, RSI, 5);
+        emit_mov(e, RDX, RAX);
+        emit_shr(e, RDX, 31);
+        emit_shl(e, RDX, 4);
+        emit_alu(e, OP_OR, RSI, RDX);
+        emit_zero_extend(e, RAX, RAX);
+        emit_zero_flag(e);
+        emit_alu(e, OP_OR, RSI, RDI);
+        emit_alu_imm(e, OP_OR, RSI, 0x40);
+        emit_alu_imm(e, OP_AND, HOST_F, 0x0F);
+        emit_alu(e, OP_OR, HOST_F, RSI);
+    }
+    if (op->kind != NATIVE_CP) {
+        emit_zero_extend(e, HOST_A, RAX);
+    }
+}
+
+static void emit_logic(Emitter *e, const NativeOp *op) {
+    uint8_t alu = op->kind == NATIVE_AND ? OP_AND : op->kind == NATIVE_OR ? OP_OR : OP_XOR;
+    emit_alu(e, alu, HOST_A, RCX);
+    if (!op->flags_dead) {
+        emit_mov(e, RAX, HOST_A);
+        emit_zero_flag(e);
+        if (op->kind == NATIVE_AND) {
+            emit_alu_imm(e, OP_OR, RDI, 0x20);
+        }
+        emit_mov(e, HOST_F, RDI);
+    }
+}
+
+static void emit_inc_dec(Emitter *e, const NativeOp *op) {
+    uint8_t reg = host_reg[op->dst];
+    bool inc = op->kind == NATIVE_INC;
+
+    // h is set when the low nibble wraps
+    emit_mov(e, RSI, reg);
+    emit_alu_imm(e, OP_AND, RSI, 0x0F);
+    if (inc) {
+        emit_alu_imm(e, OP_ADD, RSI, 1);
+        emit_alu_imm(e, OP_AND, RSI, 0x10);
+        emit_shl(e, RSI, 1);
+    } else {
+        emit_alu_imm(e, OP_SUB, RSI, 1);
+        emit_shr(e, RSI, 31);
+        emit_shl(e, RSI, 5);
+        emit_alu_imm(e, OP_OR, RSI, 0x40);
+    }
+
+    emit_mov(e, RAX, reg);
+    emit_alu_imm(e, inc ? OP_ADD : OP_SUB, RAX, 1);
+    emit_zero_extend(e, RAX, RAX);
+    emit_mov(e, reg, RAX);
+    emit_zero_flag(e);
+    emit_alu(e, OP_OR, RSI, RDI);
+    emit_alu_imm(e, OP_AND, HOST_F, 0x1F);
+    emit_alu(e, OP_OR, HOST_F, RSI);
+}
+
+static void emit_native(Emitter *e, GBCPU *cpu, const BlockInstr *d, const NativeOp *op) {
+    if (op->kind != NATIVE_NOP && op->kind != NATIVE_CPL && op->kind != NATIVE_SCF && op->kind != NATIVE_CCF &&
+        op->kind != NATIVE_INC && op->kind != NATIVE_DEC) {
+        emit_operand(e, cpu, d, op->src);
+    }
+
+    switch (op->kind) {
+    case NATIVE_NOP:
+        break;
+    case NATIVE_LD:
+        emit_mov(e, host_reg[op->dst], RCX);
+        break;
+    case NATIVE_ADD:
+    case NATIVE_ADC:
+        emit_add(e, op);
+        break;
+    case NATIVE_SUB:
+    case NATIVE_SBC:
+    case NATIVE_CP:
+        emit_sub(e, op);
+        break;
+    case NATIVE_AND:
+    case NATIVE_XOR:
+    case NATIVE_OR:
+        emit_logic(e, op);
+        break;
+    case NATIVE_INC:
+    case NATIVE_DEC:
+        emit_inc_dec(e, op);
+        break;
+    case NATIVE_CPL:
+        emit_alu_imm(e, OP_XOR, HOST_A, 0xFF);
+        emit_alu_imm(e, OP_OR, HOST_F, 0x60);
+        break;
+    case NATIVE_SCF:
+        emit_alu_imm(e, OP_AND, HOST_F, 0x8F);
+        emit_alu_imm(e, OP_OR, HOST_F, 0x10);
+        break;
+    case NATIVE_CCF:
+        emit_alu_imm(e, OP_AND, HOST_F, 0x9F);
+        emit_alu_imm(e, OP_XOR, HOST_F, 0x10);
+        break;
+    }
+}
+
+// leave the block: write back registers, counters, PC and the last opcode
+static void emit_exit(Emitter *e, const BlockInstr *d, const NativeOp *op) {
+    emit_flush_counters(e);
+    emit_store_guest(e);
+    emit_store8_imm(e, offsetof(GBCPU, opcode), d->opcode);
+    emit_store16_imm(e, offsetof(GBCPU, reg.PC), d->next);
+
+    if (op->kind == NATIVE_JUMP) {
+        size_t skip = 0;
+        if (op->flag_mask) {
+            emit_test_imm(e, HOST_F, op->flag_mask);
+            skip = emit_jcc(e, op->flag_set ? CC_E : CC_NE);
+        }
+        emit_store16_imm(e, offsetof(GBCPU, reg.PC), op->target);
+        if (op->flag_mask) {
+            patch_here(e, skip);
+        }
+    }
+    emit_epilogue(e);
+}
+
+static void compile_block(Emitter *e, GBCPU *cpu, const Block *block) {
+    NativeOp ops[BLOCK_MAX_INSTRUCTIONS];
+    for (uint8_t i = 0; i < block->count; ++i) {
+        ops[i] = classify(cpu, &block->instrs[i]);
+    }
+    mark_dead_flags(ops, block->count);
+
+    emit_push(e, RBX);
+    emit_push(e, R12);
+    emit_push(e, R13);
+    emit_push(e, R14);
+    emit_push(e, R15);
+    emit_rex(e, true, RDI, 0, RBX, false);
+    emit8(e, 0x89); // mov rbx, rdi
+    emit_modrm(e, 3, RDI, RBX);
+    emit_load_guest(e);
+
+    bool exited = false;
+    for (uint8_t i = 0; i < block->count; ++i) {
+        const BlockInstr *d = &block->instrs[i];
+        const NativeOp *op = &ops[i];
+
+        if (op->kind == NATIVE_NONE) {
+            exited = i + 1 == block->count;
+            emit_interpreted(e, block, d, exited);
+        } else if (op->kind == NATIVE_JUMP) {
+            e->pending_cycles += d->cycles;
+            e->pending_instructions++;
+            emit_exit(e, d, op);
+            exited = true;
+        } else if (op->src == GUEST_HL_PTR) {
+            // the I/O page has side effects, leave it to the interpreter
+            emit_flush_counters(e);
+            emit_alu_imm(e, OP_CMP, HOST_H, 0xFF);
+            size_t fast = emit_jcc(e, CC_NE);
+            emit_interpreted(e, block, d, false);
+            size_t done = emit_jmp(e);
+            patch_here(e, fast);
+            emit_native(e, cpu, d, op);
+            emit_add_mem64(e, offsetof(GBCPU, cycles), d->cycles);
+            emit_add_mem64(e, offsetof(GBCPU, instruction_count), 1);
+            patch_here(e, done);
+        } else {
+            emit_native(e, cpu, d, op);
+            e->pending_cycles += d->cycles;
+            e->pending_instructions++;
+        }
+    }
+
+    if (!exited) {
+        emit_exit(e, &block->instrs[block->count - 1], &ops[block->count - 1]);
+    }
+
+    // interpreted instructions that did not fall through already wrote the
+    // guest state back
+    for (size_t i = 0; i < e->exit_count; ++i) {
+        patch_here(e, e->exit_patches[i]);
+    }
+    emit_epilogue(e);
+}
+
+JitArena *jit_arena(GBCPU *cpu) {
+    return cpu->blocks ? cpu->blocks->jit : NULL;
+}
+
+void jit_attach(GBCPU *cpu) {
+    block_cache_attach(cpu);
+    if (cpu->blocks->jit == NULL) {
+        JitArena *arena = calloc(1, sizeof(JitArena));
+        arena->code = mmap(NULL, JIT_ARENA_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (arena->code == MAP_FAILED) {
+            arena->code = NULL;
+        }
+        cpu->blocks->jit = arena;
+    }
+}
+
+void jit_detach(GBCPU *cpu) {
+    JitArena *arena = jit_arena(cpu);
+    if (arena) {
+        if (arena->code) {
+            munmap(arena->code, JIT_ARENA_SIZE);
+        }
+        free(arena);
+        cpu->blocks->jit = NULL;
+    }
+    block_cache_detach(cpu);
+}
+
+static void compile(GBCPU *cpu, JitArena *arena, Block *block) {
+    if (arena->code == NULL) {
+        return;
+    }
+    if (arena->used + JIT_MAX_BLOCK_CODE > JIT_ARENA_SIZE) {
+        // start over, every block including this one gets decoded again
+        block_cache_flush(cpu->blocks);
+        arena->used = 0;
+        return;
+    }
+
+    // keep the arena W^X, it is only writable while a block is emitted
+    Emitter e = {.code = arena->code + arena->used};
+    mprotect(arena->code, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE);
+    compile_block(&e, cpu, block);
+    mprotect(arena->code, JIT_ARENA_SIZE, PROT_READ | PROT_EXEC);
+
+    // ISO C has no object to function pointer cast, POSIX guarantees the representation
+    void *entry = arena->code + arena->used;
+    memcpy(&block->native, &entry, sizeof(entry));
+    arena->used += (e.pos + 15) & ~(size_t)15;
+    arena->compiled++;
+}
+
+void jit_run(GBCPU *cpu) {
+    if (breakpoints_check(cpu)) {
+        return;
+    }
+    Block *block = block_lookup(cpu);
+    if (block == NULL) {
+        cpu_clock(cpu, false, false);
+        return;
+    }
+
+    JitArena *arena = cpu->blocks->jit;
+    if (block->native == NULL && ++block->hits >= JIT_HOT_THRESHOLD) {
+        compile(cpu, arena, block);
+        block = block_lookup(cpu);
+    }
+
+    if (block->native) {
+        cpu->blocks->executed++;
+        arena->native_runs++;
+        cpu_flags_sync(cpu);
+        block->native(cpu);
+    } else {
+        block_execute(cpu, block);
+    }
+}
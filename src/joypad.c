@@ -0,0 +1,44 @@
+#include "joypad.h"
+
+#include <string.h>
+
+void joypad_set(GBCPU *cpu, uint8_t buttons) {
+    cpu->joypad = buttons;
+    joypad_update(cpu);
+}
+
+void joypad_update(GBCPU *cpu) {
+    // P1 ($FF00): bit 4 low selects the directions, bit 5 low selects the
+    // action buttons. Pressed buttons read as 0 in the lower nibble.
+    uint8_t select = cpu->memory[0xFF00] & 0x30;
+    uint8_t pressed = 0x00;
+
+    if (!(select & 0x10)) {
+        pressed |= cpu->joypad & 0x0F;
+    }
+    if (!(select & 0x20)) {
+        pressed |= (cpu->joypad >> 4) & 0x0F;
+    }
+
+    cpu->memory[0xFF00] = 0xC0 | select | (~pressed & 0x0F);
+}
+
+uint8_t joypad_parse(const char *buttons) {
+    // "A+START", "RIGHT+B" or "-" for no buttons pressed
+    static const char *names[] = {"RIGHT", "LEFT", "UP", "DOWN", "A", "B", "SELECT", "START"};
+    uint8_t value = 0x00;
+
+    while (*buttons != '\0') {
+        size_t len = strcspn(buttons, "+");
+        for (size_t i = 0; i < 8; ++i) {
+            if (strlen(names[i]) == len && strncmp(names[i], buttons, len) == 0) {
+                value |= 0x01 << i;
+            }
+        }
+        buttons += len;
+        if (*buttons == '+') {
+            buttons++;
+        }
+    }
+    return value;
+}
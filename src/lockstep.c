@@ -0,0 +1,333 @@
+#include "lockstep.h"
+
+#include <string.h>
+
+#define WIDEN(v) __builtin_convertvector(v, lane_u16)
+#define NARROW(v) __builtin_convertvector(v, lane_u8)
+#define MASK(cond) ((lane_u16)(cond))
+
+#define LANE_IMMEDIATE 8
+#define LANE_NO_OPERAND 9
+#define LANE_INVALID 0xFF
+
+typedef enum {
+    LANE_SCALAR = 0,
+    LANE_NOP,
+    LANE_LD,
+    LANE_ADD,
+    LANE_ADC,
+    LANE_SUB,
+    LANE_SBC,
+    LANE_AND,
+    LANE_XOR,
+    LANE_OR,
+    LANE_CP,
+    LANE_INC,
+    LANE_DEC,
+    LANE_CPL,
+    LANE_SCF,
+    LANE_CCF,
+} LaneKind;
+
+static uint8_t lane_operand(AddrModeFunc func) {
+    if (func == reg_b) {
+        return LANE_B;
+    } else if (func == reg_c) {
+        return LANE_C;
+    } else if (func == reg_d) {
+        return LANE_D;
+    } else if (func == reg_e) {
+        return LANE_E;
+    } else if (func == reg_h) {
+        return LANE_H;
+    } else if (func == reg_l) {
+        return LANE_L;
+    } else if (func == reg_a) {
+        return LANE_A;
+    } else if (func == immediate) {
+        return LANE_IMMEDIATE;
+    } else if (func == implied) {
+        return LANE_NO_OPERAND;
+    }
+    return LANE_INVALID;
+}
+
+static LaneOp lane_decode(uint8_t opcode) {
+    // derive the vector form from the shared opcode table
+    const OpInstr *instr = &opcodes[opcode];
+    LaneOp op = {LANE_SCALAR, LANE_NO_OPERAND, LANE_NO_OPERAND, 1};
+
+    if (opcode == 0xCB || instr->instruction == NULL) {
+        return op;
+    }
+
+    uint8_t src = lane_operand(instr->read_mode.addr_mode_func);
+    uint8_t dst = lane_operand(instr->write_mode.addr_mode_func);
+    if (src == LANE_INVALID || dst == LANE_INVALID) {
+        return op;
+    }
+
+    Instruction f = instr->instruction;
+    bool has_src = src != LANE_NO_OPERAND;
+    bool has_dst = dst != LANE_NO_OPERAND;
+    bool alu_a = has_src && (dst == LANE_A || !has_dst);
+
+    if (f == nop && !has_src && !has_dst) {
+        op.kind = LANE_NOP;
+    } else if (f == ld_8 && has_src && has_dst && dst != LANE_IMMEDIATE) {
+        op.kind = LANE_LD;
+    } else if (f == add_8 && alu_a) {
+        op.kind = LANE_ADD;
+    } else if (f == adc && alu_a) {
+        op.kind = LANE_ADC;
+    } else if (f == sub && alu_a) {
+        op.kind = LANE_SUB;
+    } else if (f == sbc && alu_a) {
+        op.kind = LANE_SBC;
+    } else if (f == and && alu_a) {
+        op.kind = LANE_AND;
+    } else if (f == xor && alu_a) {
+        op.kind = LANE_XOR;
+    } else if (f == or && alu_a) {
+        op.kind = LANE_OR;
+    } else if (f == cp && alu_a) {
+        op.kind = LANE_CP;
+    } else if (f == inc_8 && !has_src && has_dst && dst != LANE_IMMEDIATE) {
+        op.kind = LANE_INC;
+    } else if (f == dec_8 && !has_src && has_dst && dst != LANE_IMMEDIATE) {
+        op.kind = LANE_DEC;
+    } else if (f == cpl && !has_src && !has_dst) {
+        op.kind = LANE_CPL;
+    } else if (f == scf && !has_src && !has_dst) {
+        op.kind = LANE_SCF;
+    } else if (f == ccf && !has_src && !has_dst) {
+        op.kind = LANE_CCF;
+    }
+
+    op.src = src;
+    op.dst = dst;
+    // the table length is not reliable for every entry, count what
+    // the addressing modes actually consume
+    op.length = src == LANE_IMMEDIATE ? 2 : 1;
+    return op;
+}
+
+bool lockstep_vectorizable(uint8_t opcode) {
+    return lane_decode(opcode).kind != LANE_SCALAR;
+}
+
+static void lane_load(Lockstep *lockstep, size_t lane) {
+    GBCPU *cpu = lockstep->cpus[lane];
+    cpu_flags_sync(cpu);
+    lockstep->r[LANE_A][lane] = cpu->reg.A;
+    lockstep->r[LANE_F][lane] = cpu->reg.F;
+    lockstep->r[LANE_B][lane] = cpu->reg.B;
+    lockstep->r[LANE_C][lane] = cpu->reg.C;
+    lockstep->r[LANE_D][lane] = cpu->reg.D;
+    lockstep->r[LANE_E][lane] = cpu->reg.E;
+    lockstep->r[LANE_H][lane] = cpu->reg.H;
+    lockstep->r[LANE_L][lane] = cpu->reg.L;
+    lockstep->sp[lane] = cpu->reg.SP;
+    lockstep->pc[lane] = cpu->reg.PC;
+}
+
+static void lane_store(Lockstep *lockstep, size_t lane) {
+    GBCPU *cpu = lockstep->cpus[lane];
+    cpu->reg.A = lockstep->r[LANE_A][lane];
+    cpu->reg.F = lockstep->r[LANE_F][lane];
+    cpu->lazy.op = LAZY_NONE;
+    cpu->reg.B = lockstep->r[LANE_B][lane];
+    cpu->reg.C = lockstep->r[LANE_C][lane];
+    cpu->reg.D = lockstep->r[LANE_D][lane];
+    cpu->reg.E = lockstep->r[LANE_E][lane];
+    cpu->reg.H = lockstep->r[LANE_H][lane];
+    cpu->reg.L = lockstep->r[LANE_L][lane];
+    cpu->reg.SP = lockstep->sp[lane];
+    cpu->reg.PC = lockstep->pc[lane];
+}
+
+void lockstep_initialize(Lockstep *lockstep, GBCPU **cpus, size_t lanes) {
+    memset(lockstep, 0, sizeof(Lockstep));
+    lockstep->lanes = lanes;
+
+    for (size_t i = 0; i < 256; ++i) {
+        lockstep->ops[i] = lane_decode(i);
+    }
+
+    // unused lanes mirror lane 0 so the vector code never sees garbage
+    for (size_t i = 0; i < LOCKSTEP_LANES; ++i) {
+        lockstep->cpus[i] = cpus[i < lanes ? i : 0];
+        lane_load(lockstep, i);
+    }
+}
+
+void lockstep_sync(Lockstep *lockstep) {
+    for (size_t i = 0; i < lockstep->lanes; ++i) {
+        lane_store(lockstep, i);
+    }
+}
+
+static lane_u8 lane_immediate(Lockstep *lockstep) {
+    lane_u8 value = lockstep->r[LANE_A];
+    for (size_t i = 0; i < lockstep->lanes; ++i) {
+        GBCPU *cpu = lockstep->cpus[i];
+        value[i] = cpu->memory[(uint16_t)(lockstep->pc[i] + 1)];
+    }
+    return value;
+}
+
+static void lane_alu(Lockstep *lockstep, uint8_t kind, lane_u8 value) {
+    lane_u16 a = WIDEN(lockstep->r[LANE_A]);
+    lane_u16 b = WIDEN(value);
+    lane_u16 f = WIDEN(lockstep->r[LANE_F]);
+    lane_u16 zero = {0};
+    lane_u16 carry_in = (kind == LANE_ADC || kind == LANE_SBC) ? (f >> 4) & 0x01 : zero;
+    lane_u16 result;
+    lane_u16 flags;
+
+    switch (kind) {
+    case LANE_ADD:
+    case LANE_ADC:
+        result = a + b + carry_in;
+        flags = (f & 0x0F) | (MASK(((a & 0x0F) + (b & 0x0F) + carry_in) > 0x0F) & 0x20) | (MASK(result > 0xFF) & 0x10);
+        break;
+    case LANE_SUB:
+    case LANE_SBC:
+    case LANE_CP:
+        result = a - b - carry_in;
+        flags = (f & 0x0F) | 0x40 | (MASK((a & 0x0F) < (b & 0x0F) + carry_in) & 0x20) | (MASK(a < b + carry_in) & 0x10);
+        break;
+    case LANE_AND:
+        result = a & b;
+        flags = zero | 0x20;
+        break;
+    case LANE_XOR:
+        result = a ^ b;
+        flags = zero;
+        break;
+    default: // LANE_OR
+        result = a | b;
+        flags = zero;
+        break;
+    }
+
+    flags |= MASK((result & 0xFF) == 0) & 0x80;
+    if (kind != LANE_CP) {
+        lockstep->r[LANE_A] = NARROW(result);
+    }
+    lockstep->r[LANE_F] = NARROW(flags);
+}
+
+static void lane_inc_dec(Lockstep *lockstep, uint8_t kind, uint8_t reg) {
+    lane_u16 value = WIDEN(lockstep->r[reg]);
+    lane_u16 f = WIDEN(lockstep->r[LANE_F]);
+    lane_u16 result;
+    lane_u16 flags;
+
+    if (kind == LANE_INC) {
+        result = value + 1;
+        flags = (f & 0x1F) | (MASK((value & 0x0F) == 0x0F) & 0x20);
+    } else {
+        result = value - 1;
+        flags = (f & 0x1F) | 0x40 | (MASK((value & 0x0F) == 0x00) & 0x20);
+    }
+    flags |= MASK((result & 0xFF) == 0) & 0x80;
+
+    lockstep->r[reg] = NARROW(result);
+    lockstep->r[LANE_F] = NARROW(flags);
+}
+
+static void lane_execute(Lockstep *lockstep, LaneOp op) {
+    lane_u8 value = lockstep->r[LANE_A];
+    if (op.src == LANE_IMMEDIATE) {
+        value = lane_immediate(lockstep);
+    } else if (op.src != LANE_NO_OPERAND) {
+        value = lockstep->r[op.src];
+    }
+
+    switch (op.kind) {
+    case LANE_NOP:
+        break;
+    case LANE_LD:
+        lockstep->r[op.dst] = value;
+        break;
+    case LANE_INC:
+    case LANE_DEC:
+        lane_inc_dec(lockstep, op.kind, op.dst);
+        break;
+    case LANE_CPL:
+        lockstep->r[LANE_A] = ~lockstep->r[LANE_A];
+        lockstep->r[LANE_F] |= 0x60;
+        break;
+    case LANE_SCF:
+        lockstep->r[LANE_F] = (lockstep->r[LANE_F] & 0x8F) | 0x10;
+        break;
+    case LANE_CCF:
+        lockstep->r[LANE_F] = (lockstep->r[LANE_F] & 0x9F) ^ 0x10;
+        break;
+    default:
+        lane_alu(lockstep, op.kind, value);
+        break;
+    }
+
+    lockstep->pc += op.length;
+}
+
+static bool lanes_converged(Lockstep *lockstep, uint8_t *opcode) {
+    uint16_t pc = lockstep->pc[0];
+    *opcode = lockstep->cpus[0]->memory[pc];
+
+    for (size_t i = 0; i < lockstep->lanes; ++i) {
+        GBCPU *cpu = lockstep->cpus[i];
+        if (cpu->crashed || lockstep->pc[i] != pc || cpu->memory[pc] != *opcode) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the lowest PC of the running lanes
+static uint16_t lagging_pc(Lockstep *lockstep) {
+    uint16_t pc = 0xFFFF;
+    for (size_t i = 0; i < lockstep->lanes; ++i) {
+        if (!lockstep->cpus[i]->crashed && lockstep->pc[i] < pc) {
+            pc = lockstep->pc[i];
+        }
+    }
+    return pc;
+}
+
+void lockstep_step(Lockstep *lockstep) {
+    uint8_t opcode;
+
+    bool converged = lanes_converged(lockstep, &opcode);
+    if (converged) {
+        LaneOp op = lockstep->ops[opcode];
+        if (op.kind != LANE_SCALAR) {
+            lane_execute(lockstep, op);
+            for (size_t i = 0; i < lockstep->lanes; ++i) {
+                GBCPU *cpu = lockstep->cpus[i];
+                cpu->opcode = opcode;
+                cpu->cycles += opcodes[opcode].cycles;
+                cpu->instruction_count++;
+            }
+            lockstep->vector_steps++;
+            return;
+        }
+    }
+
+    // Apart, only the lanes at the lowest PC run, the way diverged SIMT lanes
+    // are brought back together: lanes past a loop wait at its exit for the
+    // ones still in it.
+    uint16_t pc = converged ? lockstep->pc[0] : lagging_pc(lockstep);
+    for (size_t i = 0; i < lockstep->lanes; ++i) {
+        GBCPU *cpu = lockstep->cpus[i];
+        if (cpu->crashed || lockstep->pc[i] != pc) {
+            continue;
+        }
+        lane_store(lockstep, i);
+        cpu_clock(cpu, false, false);
+        lane_load(lockstep, i);
+    }
+    lockstep->scalar_steps++;
+}
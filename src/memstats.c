@@ -0,0 +1,131 @@
+#include "memstats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+const char *const memstats_region_names[REGION_COUNT] = {
+    [REGION_ROM0] = "ROM Bank 0",
+    [REGION_ROM1] = "ROM Bank 1",
+    [REGION_VRAM] = "VRAM",
+    [REGION_EXTERNAL] = "External RAM",
+    [REGION_WRAM] = "WRAM",
+    [REGION_ECHO] = "Echo RAM",
+    [REGION_OAM] = "OAM",
+    [REGION_UNUSABLE] = "Unusable",
+    [REGION_IO] = "I/O Registers",
+    [REGION_HRAM] = "HRAM",
+    [REGION_IE] = "Interrupt Enable",
+};
+
+static const char *const io_names[0x80] = {
+    [0x00] = "P1",   [0x01] = "SB",   [0x02] = "SC",   [0x04] = "DIV",  [0x05] = "TIMA", [0x06] = "TMA",
+    [0x07] = "TAC",  [0x0F] = "IF",   [0x10] = "NR10", [0x11] = "NR11", [0x12] = "NR12", [0x13] = "NR13",
+    [0x14] = "NR14", [0x16] = "NR21", [0x17] = "NR22", [0x18] = "NR23", [0x19] = "NR24", [0x1A] = "NR30",
+    [0x1B] = "NR31", [0x1C] = "NR32", [0x1D] = "NR33", [0x1E] = "NR34", [0x20] = "NR41", [0x21] = "NR42",
+    [0x22] = "NR43", [0x23] = "NR44", [0x24] = "NR50", [0x25] = "NR51", [0x26] = "NR52", [0x30] = "WAVE0",
+    [0x31] = "WAVE1", [0x32] = "WAVE2", [0x33] = "WAVE3", [0x34] = "WAVE4", [0x35] = "WAVE5", [0x36] = "WAVE6",
+    [0x37] = "WAVE7", [0x38] = "WAVE8", [0x39] = "WAVE9", [0x3A] = "WAVEA", [0x3B] = "WAVEB", [0x3C] = "WAVEC",
+    [0x3D] = "WAVED", [0x3E] = "WAVEE", [0x3F] = "WAVEF", [0x40] = "LCDC", [0x41] = "STAT", [0x42] = "SCY",
+    [0x43] = "SCX",  [0x44] = "LY",   [0x45] = "LYC",  [0x46] = "DMA",  [0x47] = "BGP",  [0x48] = "OBP0",
+    [0x49] = "OBP1", [0x4A] = "WY",   [0x4B] = "WX",   [0x50] = "BOOT",
+};
+
+MemRegion memstats_region(uint16_t addr) {
+    if (addr < 0x4000) {
+        return REGION_ROM0;
+    } else if (addr < 0x8000) {
+        return REGION_ROM1;
+    } else if (addr < 0xA000) {
+        return REGION_VRAM;
+    } else if (addr < 0xC000) {
+        return REGION_EXTERNAL;
+    } else if (addr < 0xE000) {
+        return REGION_WRAM;
+    } else if (addr < 0xFE00) {
+        return REGION_ECHO;
+    } else if (addr < 0xFEA0) {
+        return REGION_OAM;
+    } else if (addr < 0xFF00) {
+        return REGION_UNUSABLE;
+    } else if (addr < 0xFF80) {
+        return REGION_IO;
+    } else if (addr < 0xFFFF) {
+        return REGION_HRAM;
+    }
+    return REGION_IE;
+}
+
+const char *memstats_io_name(uint16_t addr) {
+    return addr >= 0xFF00 && addr < 0xFF80 ? io_names[addr - 0xFF00] : NULL;
+}
+
+MemStats *memstats_create(void) {
+    return calloc(1, sizeof(MemStats));
+}
+
+void memstats_merge(MemStats *into, const MemStats *from) {
+    for (size_t addr = 0; addr < 0x10000; ++addr) {
+        into->reads[addr] += from->reads[addr];
+        into->writes[addr] += from->writes[addr];
+    }
+}
+
+void memstats_regions(const MemStats *stats, uint64_t reads[REGION_COUNT], uint64_t writes[REGION_COUNT]) {
+    memset(reads, 0, REGION_COUNT * sizeof(uint64_t));
+    memset(writes, 0, REGION_COUNT * sizeof(uint64_t));
+    for (size_t addr = 0; addr < 0x10000; ++addr) {
+        MemRegion region = memstats_region(addr);
+        reads[region] += stats->reads[addr];
+        writes[region] += stats->writes[addr];
+    }
+}
+
+void memstats_report(const MemStats *stats, FILE *out) {
+    uint64_t reads[REGION_COUNT];
+    uint64_t writes[REGION_COUNT];
+    memstats_regions(stats, reads, writes);
+
+    uint64_t total = 0;
+    for (size_t region = 0; region < REGION_COUNT; ++region) {
+        total += reads[region] + writes[region];
+    }
+    fprintf(out, "%llu memory accesses\n", (unsigned long long)total);
+    fprintf(out, "region             reads        writes       access%%\n");
+    for (size_t region = 0; region < REGION_COUNT; ++region) {
+        uint64_t accesses = reads[region] + writes[region];
+        if (accesses == 0) {
+            continue;
+        }
+        fprintf(out, "%-18s %-12llu %-12llu %6.2f\n", memstats_region_names[region], (unsigned long long)reads[region],
+                (unsigned long long)writes[region], 100.0 * accesses / total);
+    }
+
+    fprintf(out, "register     reads        writes\n");
+    for (uint16_t addr = 0xFF00; addr < 0xFF80; ++addr) {
+        if (stats->reads[addr] == 0 && stats->writes[addr] == 0) {
+            continue;
+        }
+        const char *name = memstats_io_name(addr);
+        fprintf(out, "$%04X %-6s %-12llu %llu\n", addr, name ? name : "", (unsigned long long)stats->reads[addr],
+                (unsigned long long)stats->writes[addr]);
+    }
+}
+
+bool memstats_write_csv(const MemStats *stats, const char *file) {
+    FILE *out = fopen(file, "w");
+    if (out == NULL) {
+        perror(file);
+        return false;
+    }
+
+    fprintf(out, "addr,region,register,reads,writes\n");
+    for (size_t addr = 0; addr < 0x10000; ++addr) {
+        if (stats->reads[addr] == 0 && stats->writes[addr] == 0) {
+            continue;
+        }
+        const char *name = memstats_io_name(addr);
+        fprintf(out, "0x%04zX,\"%s\",%s,%llu,%llu\n", addr, memstats_region_names[memstats_region(addr)],
+                name ? name : "", (unsigned long long)stats->reads[addr], (unsigned long long)stats->writes[addr]);
+    }
+    return fclose(out) == 0;
+}
@@ -0,0 +1,121 @@
+#include "alu_tables.h"
+#include "gbcpu.h"
+
+// The 256 CB prefixed instructions, expanded at compile time with the bit
+// number and the operand register baked into each handler. Register variants
+// use implied addressing and never go through DataAccess; only the (HL)
+// variants read and write through the memory bus.
+
+static inline uint8_t cb_shift(GBCPU *cpu, uint8_t op, uint8_t value) {
+    uint8_t carry = 0;
+    if (op == ALU_RL || op == ALU_RR) {
+        cpu_flags_sync(cpu);
+        carry = get_flag(&cpu->reg, FLAG_C);
+    }
+    uint16_t result = alu_shift[op][carry][value];
+    cpu->reg.F = (cpu->reg.F & 0x0F) | result >> 8;
+    cpu->lazy.op = LAZY_NONE;
+    return result & 0xFF;
+}
+
+static inline void cb_bit(GBCPU *cpu, uint8_t set) {
+    // n cleared, h set, c kept
+    cpu_flags_sync(cpu);
+    cpu->reg.F = (cpu->reg.F & 0x1F) | 0x20 | (set ? 0x00 : 0x80);
+}
+
+#define SHIFT(value, op) value = cb_shift(cpu, op, value)
+#define BIT(value, n) cb_bit(cpu, (value) & (1 << (n)))
+#define RES(value, n) value &= ~(1 << (n))
+#define SET(value, n) value |= 1 << (n)
+
+#define CB_HANDLERS(name, APPLY, arg, writes)      \
+    static void name##_b(GBCPU *cpu) {             \
+        APPLY(cpu->reg.B, arg);                    \
+    }                                              \
+    static void name##_c(GBCPU *cpu) {             \
+        APPLY(cpu->reg.C, arg);                    \
+    }                                              \
+    static void name##_d(GBCPU *cpu) {             \
+        APPLY(cpu->reg.D, arg);                    \
+    }                                              \
+    static void name##_e(GBCPU *cpu) {             \
+        APPLY(cpu->reg.E, arg);                    \
+    }                                              \
+    static void name##_h(GBCPU *cpu) {             \
+        APPLY(cpu->reg.H, arg);                    \
+    }                                              \
+    static void name##_l(GBCPU *cpu) {             \
+        APPLY(cpu->reg.L, arg);                    \
+    }                                              \
+    static void name##_hl(GBCPU *cpu) {            \
+        uint8_t value = cpu_read_from_dst(cpu);    \
+        APPLY(value, arg);                         \
+        if (writes) {                              \
+            cpu_write_to_dst(cpu, value);          \
+        }                                          \
+    }                                              \
+    static void name##_a(GBCPU *cpu) {             \
+        APPLY(cpu->reg.A, arg);                    \
+    }
+
+CB_HANDLERS(rlc, SHIFT, ALU_RLC, true)
+CB_HANDLERS(rrc, SHIFT, ALU_RRC, true)
+CB_HANDLERS(rl, SHIFT, ALU_RL, true)
+CB_HANDLERS(rr, SHIFT, ALU_RR, true)
+CB_HANDLERS(sla, SHIFT, ALU_SLA, true)
+CB_HANDLERS(sra, SHIFT, ALU_SRA, true)
+CB_HANDLERS(swap, SHIFT, ALU_SWAP, true)
+CB_HANDLERS(srl, SHIFT, ALU_SRL, true)
+
+#define CB_BIT_HANDLERS(n)                  \
+    CB_HANDLERS(bit_##n, BIT, n, false)     \
+    CB_HANDLERS(res_##n, RES, n, true)      \
+    CB_HANDLERS(set_##n, SET, n, true)
+
+CB_BIT_HANDLERS(0)
+CB_BIT_HANDLERS(1)
+CB_BIT_HANDLERS(2)
+CB_BIT_HANDLERS(3)
+CB_BIT_HANDLERS(4)
+CB_BIT_HANDLERS(5)
+CB_BIT_HANDLERS(6)
+CB_BIT_HANDLERS(7)
+
+// implied addressing that still names the register for the disassembler
+#define OPERAND(name) \
+    { .addr_mode_func = implied, .repr = name }
+
+#define CB_ROW(opcode, name, text)                                      \
+    [opcode | 0x00] = {name##_b, IMPLIED, OPERAND("B"), 2, 8, text},    \
+    [opcode | 0x01] = {name##_c, IMPLIED, OPERAND("C"), 2, 8, text},    \
+    [opcode | 0x02] = {name##_d, IMPLIED, OPERAND("D"), 2, 8, text},    \
+    [opcode | 0x03] = {name##_e, IMPLIED, OPERAND("E"), 2, 8, text},    \
+    [opcode | 0x04] = {name##_h, IMPLIED, OPERAND("H"), 2, 8, text},    \
+    [opcode | 0x05] = {name##_l, IMPLIED, OPERAND("L"), 2, 8, text},    \
+    [opcode | 0x06] = {name##_hl, IMPLIED, REG_HL_PTR, 2, 16, text},    \
+    [opcode | 0x07] = {name##_a, IMPLIED, OPERAND("A"), 2, 8, text}
+
+#define CB_BIT_ROWS(n)                                  \
+    CB_ROW(0x40 | n << 3, bit_##n, "BIT " #n ","),      \
+    CB_ROW(0x80 | n << 3, res_##n, "RES " #n ","),      \
+    CB_ROW(0xC0 | n << 3, set_##n, "SET " #n ",")
+
+const OpInstr prefix_opcodes[] = {
+    CB_ROW(0x00, rlc, "RLC"),
+    CB_ROW(0x08, rrc, "RRC"),
+    CB_ROW(0x10, rl, "RL"),
+    CB_ROW(0x18, rr, "RR"),
+    CB_ROW(0x20, sla, "SLA"),
+    CB_ROW(0x28, sra, "SRA"),
+    CB_ROW(0x30, swap, "SWAP"),
+    CB_ROW(0x38, srl, "SRL"),
+    CB_BIT_ROWS(0),
+    CB_BIT_ROWS(1),
+    CB_BIT_ROWS(2),
+    CB_BIT_ROWS(3),
+    CB_BIT_ROWS(4),
+    CB_BIT_ROWS(5),
+    CB_BIT_ROWS(6),
+    CB_BIT_ROWS(7),
+};
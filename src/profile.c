@@ -0,0 +1,111 @@
+#include "profile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    bool prefixed;
+    uint8_t opcode;
+    double ticks; // estimated over every execution
+} ProfileRow;
+
+Profile *profile_create(uint32_t interval) {
+    Profile *profile = calloc(1, sizeof(Profile));
+    profile->interval = interval ? interval : 1;
+    profile->countdown = profile->interval;
+    return profile;
+}
+
+void profile_merge(Profile *into, const Profile *from) {
+    for (size_t table = 0; table < 2; ++table) {
+        for (size_t opcode = 0; opcode < 0x100; ++opcode) {
+            ProfileEntry *a = &into->ops[table][opcode];
+            const ProfileEntry *b = &from->ops[table][opcode];
+            a->count += b->count;
+            a->cycles += b->cycles;
+            a->samples += b->samples;
+            a->ticks += b->ticks;
+        }
+    }
+}
+
+static double ticks_per_run(const ProfileEntry *entry) {
+    return entry->samples ? (double)entry->ticks / entry->samples : 0.0;
+}
+
+static void mnemonic(bool prefixed, uint8_t opcode, char *out, size_t size) {
+    const OpInstr *instr = prefixed ? &prefix_opcodes[opcode] : &opcodes[opcode];
+    const char *dst = instr->write_mode.repr;
+    const char *src = instr->read_mode.repr;
+    snprintf(out, size, "%s %s%s%s", instr->name, dst, dst[0] && src[0] ? ", " : "", src);
+}
+
+static int by_ticks(const void *a, const void *b) {
+    double x = ((const ProfileRow *)a)->ticks;
+    double y = ((const ProfileRow *)b)->ticks;
+    return (x < y) - (x > y);
+}
+
+// executed opcodes, most expensive first
+static size_t sorted_rows(const Profile *profile, ProfileRow *rows) {
+    size_t count = 0;
+    for (size_t table = 0; table < 2; ++table) {
+        for (size_t opcode = 0; opcode < 0x100; ++opcode) {
+            const ProfileEntry *entry = &profile->ops[table][opcode];
+            if (entry->count == 0) {
+                continue;
+            }
+            rows[count].prefixed = table;
+            rows[count].opcode = opcode;
+            rows[count].ticks = ticks_per_run(entry) * entry->count;
+            count++;
+        }
+    }
+    qsort(rows, count, sizeof(ProfileRow), by_ticks);
+    return count;
+}
+
+void profile_report(const Profile *profile, FILE *out, size_t top) {
+    ProfileRow rows[0x200];
+    size_t count = sorted_rows(profile, rows);
+
+    uint64_t instructions = 0;
+    double ticks = 0;
+    for (size_t i = 0; i < count; ++i) {
+        instructions += profile->ops[rows[i].prefixed][rows[i].opcode].count;
+        ticks += rows[i].ticks;
+    }
+
+    fprintf(out, "%zu opcodes, %llu instructions, host time sampled 1 in %u\n", count,
+            (unsigned long long)instructions, profile->interval);
+    fprintf(out, "opcode  mnemonic             count       count%%  cycles       ticks/run  time%%\n");
+    for (size_t i = 0; i < count && (top == 0 || i < top); ++i) {
+        const ProfileEntry *entry = &profile->ops[rows[i].prefixed][rows[i].opcode];
+        char name[32];
+        mnemonic(rows[i].prefixed, rows[i].opcode, name, sizeof(name));
+        fprintf(out, "%s%02X  %-20s %-11llu %6.2f  %-12llu %9.1f  %5.2f\n", rows[i].prefixed ? "CB" : "  ",
+                rows[i].opcode, name, (unsigned long long)entry->count, 100.0 * entry->count / instructions,
+                (unsigned long long)entry->cycles, ticks_per_run(entry), ticks > 0 ? 100.0 * rows[i].ticks / ticks : 0.0);
+    }
+}
+
+bool profile_write_csv(const Profile *profile, const char *file) {
+    FILE *out = fopen(file, "w");
+    if (out == NULL) {
+        perror(file);
+        return false;
+    }
+
+    ProfileRow rows[0x200];
+    size_t count = sorted_rows(profile, rows);
+    fprintf(out, "table,opcode,mnemonic,count,cycles,samples,ticks,ticks_per_run\n");
+    for (size_t i = 0; i < count; ++i) {
+        const ProfileEntry *entry = &profile->ops[rows[i].prefixed][rows[i].opcode];
+        char name[32];
+        mnemonic(rows[i].prefixed, rows[i].opcode, name, sizeof(name));
+        fprintf(out, "%s,0x%02X,\"%s\",%llu,%llu,%llu,%llu,%.1f\n", rows[i].prefixed ? "cb" : "base",
+                rows[i].opcode, name, (unsigned long long)entry->count, (unsigned long long)entry->cycles,
+                (unsigned long long)entry->samples, (unsigned long long)entry->ticks, ticks_per_run(entry));
+    }
+    return fclose(out) == 0;
+}
@@ -27,37 +27,6 @@ void serial_buffer_clear(SerialBuffer *serial_buffer) {
     serial_buffer->pos = 0;
 }
 
-Stack *stack_allocate() {
-    Stack *stack = (Stack *)malloc(sizeof(Stack));
-    stack->pointer = 0x100;
-    return stack;
-}
-
-void stack_push(Stack *stack, uint8_t value) {
-    if (stack->pointer == 0) {
-        printf("Stack max elements reached!\n");
-        return;
-    }
-    stack->stack[--(stack->pointer)] = value;
-}
-
-uint8_t stack_pop(Stack *stack) {
-    if (stack->pointer == STACK_SIZE) {
-        printf("Stack is empty!\n");
-        return 0x00;
-    }
-    uint8_t value = stack->stack[stack->pointer++];
-    return value;
-}
-
-uint8_t stack_peek(Stack *stack) {
-    if (stack->pointer == STACK_SIZE) {
-        printf("Stack is empty!\n");
-        return 0x00;
-    }
-    return stack->stack[stack->pointer];
-}
-
 bool read_binary(const char *file, uint8_t *dst) {
     FILE *fd = fopen(file, "rb");
 
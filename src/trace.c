@@ -0,0 +1,209 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+struct TraceWriter {
+    FILE *file;
+    uint64_t next; // next instruction to copy from the history
+    bool failed;
+    HistoryEntry *buffers[2];
+    int current;
+    size_t fill;
+
+    // hand-off to the writer thread, under lock
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    const HistoryEntry *pending;
+    size_t pending_count;
+    bool closing;
+    bool write_error;
+};
+
+static void *writer_main(void *arg) {
+    TraceWriter *trace = arg;
+    pthread_mutex_lock(&trace->lock);
+    for (;;) {
+        while (trace->pending == NULL && !trace->closing) {
+            pthread_cond_wait(&trace->changed, &trace->lock);
+        }
+        if (trace->pending == NULL) {
+            break;
+        }
+        const HistoryEntry *entries = trace->pending;
+        size_t count = trace->pending_count;
+        pthread_mutex_unlock(&trace->lock);
+
+        bool ok = fwrite(entries, sizeof(HistoryEntry), count, trace->file) == count;
+
+        pthread_mutex_lock(&trace->lock);
+        trace->write_error = trace->write_error || !ok;
+        trace->pending = NULL;
+        pthread_cond_broadcast(&trace->changed);
+    }
+    pthread_mutex_unlock(&trace->lock);
+    return NULL;
+}
+
+// Passes the current buffer to the writer thread once it finished the other.
+static void hand_off(TraceWriter *trace) {
+    pthread_mutex_lock(&trace->lock);
+    while (trace->pending != NULL) {
+        pthread_cond_wait(&trace->changed, &trace->lock);
+    }
+    trace->pending = trace->buffers[trace->current];
+    trace->pending_count = trace->fill;
+    trace->failed = trace->failed || trace->write_error;
+    pthread_cond_broadcast(&trace->changed);
+    pthread_mutex_unlock(&trace->lock);
+
+    trace->current ^= 1;
+    trace->fill = 0;
+}
+
+TraceWriter *trace_open(const char *file, const GBCPU *cpu) {
+    FILE *out = fopen(file, "wb");
+    if (out == NULL) {
+        perror(file);
+        return NULL;
+    }
+    TraceHeader header = {TRACE_MAGIC, TRACE_VERSION, sizeof(HistoryEntry), cpu->instruction_count};
+    if (fwrite(&header, sizeof(header), 1, out) != 1) {
+        fclose(out);
+        return NULL;
+    }
+
+    TraceWriter *trace = calloc(1, sizeof(TraceWriter));
+    if (trace == NULL) {
+        fclose(out);
+        return NULL;
+    }
+    trace->file = out;
+    trace->next = cpu->instruction_count;
+    trace->buffers[0] = malloc(TRACE_BUFFER_ENTRIES * sizeof(HistoryEntry));
+    trace->buffers[1] = malloc(TRACE_BUFFER_ENTRIES * sizeof(HistoryEntry));
+    bool started = trace->buffers[0] != NULL && trace->buffers[1] != NULL;
+    if (started) {
+        pthread_mutex_init(&trace->lock, NULL);
+        pthread_cond_init(&trace->changed, NULL);
+        started = pthread_create(&trace->thread, NULL, writer_main, trace) == 0;
+        if (!started) {
+            pthread_mutex_destroy(&trace->lock);
+            pthread_cond_destroy(&trace->changed);
+        }
+    }
+    if (started) {
+        return trace;
+    }
+
+    fprintf(stderr, "%s: trace writer could not be started\n", file);
+    fclose(out);
+    free(trace->buffers[0]);
+    free(trace->buffers[1]);
+    free(trace);
+    return NULL;
+}
+
+bool trace_sync(TraceWriter *trace, const GBCPU *cpu) {
+    if (trace->failed) {
+        return false;
+    }
+    if (cpu->instruction_count - trace->next > HISTORY_SIZE) {
+        fprintf(stderr, "Trace lost instructions %zu to %zu\n", (size_t)trace->next,
+                (size_t)(cpu->instruction_count - HISTORY_SIZE - 1));
+        trace->failed = true;
+        return false;
+    }
+
+    while (trace->next < cpu->instruction_count) {
+        size_t slot = trace->next & (HISTORY_SIZE - 1);
+        size_t count = cpu->instruction_count - trace->next;
+        if (count > HISTORY_SIZE - slot) {
+            count = HISTORY_SIZE - slot;
+        }
+        if (count > TRACE_BUFFER_ENTRIES - trace->fill) {
+            count = TRACE_BUFFER_ENTRIES - trace->fill;
+        }
+        memcpy(&trace->buffers[trace->current][trace->fill], &cpu->history[slot], count * sizeof(HistoryEntry));
+        trace->fill += count;
+        trace->next += count;
+        if (trace->fill == TRACE_BUFFER_ENTRIES) {
+            hand_off(trace);
+        }
+    }
+    return !trace->failed;
+}
+
+bool trace_close(TraceWriter *trace) {
+    if (trace->fill > 0) {
+        hand_off(trace);
+    }
+    pthread_mutex_lock(&trace->lock);
+    trace->closing = true;
+    pthread_cond_broadcast(&trace->changed);
+    pthread_mutex_unlock(&trace->lock);
+    pthread_join(trace->thread, NULL);
+
+    bool ok = !trace->failed && !trace->write_error;
+    ok = fclose(trace->file) == 0 && ok;
+    pthread_mutex_destroy(&trace->lock);
+    pthread_cond_destroy(&trace->changed);
+    free(trace->buffers[0]);
+    free(trace->buffers[1]);
+    free(trace);
+    return ok;
+}
+
+TraceReader *trace_reader_open(const char *file) {
+    FILE *in = fopen(file, "rb");
+    if (in == NULL) {
+        perror(file);
+        return NULL;
+    }
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, TRACE_MAGIC, 4) != 0 ||
+        header.version != TRACE_VERSION || header.entry_size != sizeof(HistoryEntry)) {
+        fprintf(stderr, "%s: not a version %d trace from this build\n", file, TRACE_VERSION);
+        fclose(in);
+        return NULL;
+    }
+
+    TraceReader *reader = calloc(1, sizeof(TraceReader));
+    reader->file = in;
+    reader->header = header;
+    fseeko(in, 0, SEEK_END);
+    reader->count = (ftello(in) - (off_t)sizeof(header)) / sizeof(HistoryEntry);
+    fseeko(in, sizeof(header), SEEK_SET);
+    reader->next = header.first;
+    return reader;
+}
+
+void trace_reader_close(TraceReader *reader) {
+    fclose(reader->file);
+    free(reader);
+}
+
+bool trace_seek(TraceReader *reader, uint64_t instruction) {
+    if (instruction < reader->header.first || instruction - reader->header.first >= reader->count) {
+        return false;
+    }
+    off_t offset = sizeof(TraceHeader) + (off_t)(instruction - reader->header.first) * sizeof(HistoryEntry);
+    if (fseeko(reader->file, offset, SEEK_SET) != 0) {
+        return false;
+    }
+    reader->next = instruction;
+    return true;
+}
+
+bool trace_next(TraceReader *reader, HistoryEntry *entry, uint64_t *instruction) {
+    if (fread(entry, sizeof(HistoryEntry), 1, reader->file) != 1) {
+        return false;
+    }
+    *instruction = reader->next++;
+    return true;
+}
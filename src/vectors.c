@@ -0,0 +1,482 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "vectors.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "blocks.h"
+#include "breakpoints.h"
+#include "disasm.h"
+
+#define WRAM 0xC000
+#define WRAM_SIZE 0x2000
+#define HRAM_OFFSET 0x80 // from $FF00
+#define HRAM_SIZE 0x7F   // without IE at $FFFF
+
+enum {
+    CHANGED_IME = 0x40,
+    CHANGED_CRASHED = 0x80,
+};
+#define REGISTERS 6 // AF, BC, DE, HL, SP, PC, bits 0-5 of changed
+#define RECORD_MAX (2 + REGISTERS * 2 + VECTOR_MAX_STORES * 3)
+
+static const char *const register_names[REGISTERS] = {"AF", "BC", "DE", "HL", "SP", "PC"};
+
+static const OpInstr *vector_instr(unsigned opcode) {
+    return opcode < 0x100 ? &opcodes[opcode] : &prefix_opcodes[opcode & 0xFF];
+}
+
+bool vector_opcode_defined(unsigned opcode) {
+    return opcode < VECTOR_OPCODES && opcode != 0xCB && vector_instr(opcode)->instruction != NULL;
+}
+
+// xorshift64*
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+static bool uses(const OpInstr *instr, AddrModeFunc mode) {
+    return instr->read_mode.addr_mode_func == mode || instr->write_mode.addr_mode_func == mode;
+}
+
+static void set_byte(VectorInput *input, uint16_t addr, uint8_t value) {
+    input->addr[input->count] = addr;
+    input->value[input->count] = value;
+    input->count++;
+}
+
+void vector_input(uint64_t seed, unsigned opcode, unsigned index, VectorInput *input) {
+    const OpInstr *instr = vector_instr(opcode);
+    uint64_t state = write_hash_mix(seed ^ ((uint64_t)opcode << 32 | index)) | 1;
+    memset(input, 0, sizeof(VectorInput));
+
+    cpu_registers *reg = &input->reg;
+    reg->AF = next_random(&state) & 0xFFF0;
+    reg->BC = next_random(&state);
+    reg->DE = next_random(&state);
+    reg->HL = next_random(&state);
+    // SP - 2 to SP + 1 and the instruction stay in WRAM
+    reg->SP = WRAM + 2 + next_random(&state) % (WRAM_SIZE - 3);
+    reg->PC = WRAM + next_random(&state) % (WRAM_SIZE - 2);
+    input->ime = next_random(&state) & 1;
+    input->length = instr->length;
+
+    uint8_t bytes[3] = {(uint8_t)opcode, next_random(&state), next_random(&state)};
+    if (opcode >= 0x100) {
+        bytes[0] = 0xCB;
+        bytes[1] = opcode & 0xFF;
+    }
+    if (uses(instr, reg_hl_ptr)) {
+        reg->HL = WRAM + next_random(&state) % WRAM_SIZE;
+    }
+    if (uses(instr, reg_bc_ptr)) {
+        reg->BC = WRAM + next_random(&state) % WRAM_SIZE;
+    }
+    if (uses(instr, reg_de_ptr)) {
+        reg->DE = WRAM + next_random(&state) % WRAM_SIZE;
+    }
+    if (uses(instr, reg_c_ptr)) {
+        reg->C = HRAM_OFFSET + next_random(&state) % HRAM_SIZE;
+    }
+    if (uses(instr, immediate_ptr)) {
+        bytes[1] = HRAM_OFFSET + next_random(&state) % HRAM_SIZE;
+    }
+    uint16_t nn = WRAM + next_random(&state) % (WRAM_SIZE - 1);
+    if (uses(instr, immediate_ext_ptr)) {
+        bytes[1] = nn & 0xFF;
+        bytes[2] = nn >> 8;
+    }
+
+    set_byte(input, reg->SP, next_random(&state));
+    set_byte(input, reg->SP + 1, next_random(&state));
+    if (uses(instr, reg_hl_ptr)) {
+        set_byte(input, reg->HL, next_random(&state));
+    }
+    if (uses(instr, reg_bc_ptr)) {
+        set_byte(input, reg->BC, next_random(&state));
+    }
+    if (uses(instr, reg_de_ptr)) {
+        set_byte(input, reg->DE, next_random(&state));
+    }
+    if (uses(instr, reg_c_ptr)) {
+        set_byte(input, 0xFF00 + reg->C, next_random(&state));
+    }
+    if (uses(instr, immediate_ptr)) {
+        set_byte(input, 0xFF00 + bytes[1], next_random(&state));
+    }
+    if (uses(instr, immediate_ext_ptr)) {
+        set_byte(input, nn, next_random(&state));
+        set_byte(input, nn + 1, next_random(&state));
+    }
+    // last, so an operand pointing into the instruction does not change it
+    for (uint8_t i = 0; i < input->length; ++i) {
+        set_byte(input, reg->PC + i, bytes[i]);
+    }
+}
+
+// the value the input leaves at addr, 0 where it sets nothing
+static uint8_t input_byte(const VectorInput *input, uint16_t addr) {
+    for (int i = input->count - 1; i >= 0; --i) {
+        if (input->addr[i] == addr) {
+            return input->value[i];
+        }
+    }
+    return 0;
+}
+
+static void poke(GBCPU *cpu, uint16_t addr, uint8_t value) {
+    cpu->memory[addr] = value;
+    if (cpu->blocks) {
+        block_cache_write(cpu->blocks, addr);
+    }
+}
+
+void vector_run(GBCPU *cpu, const VectorInput *input, VerifyEngine run, void *context, VectorResult *result) {
+    cpu->reg = input->reg;
+    cpu->lazy.op = LAZY_NONE;
+    cpu->ime = input->ime;
+    cpu->crashed = false;
+    memset(&cpu->src, 0, sizeof(DataAccess));
+    memset(&cpu->dst, 0, sizeof(DataAccess));
+    for (uint8_t i = 0; i < input->count && i < VECTOR_BYTES; ++i) {
+        poke(cpu, input->addr[i], input->value[i]);
+    }
+    uint16_t next = input->reg.PC + input->length;
+    if (cpu->blocks) {
+        if (cpu->breakpoints == NULL) {
+            breakpoints_attach(cpu);
+        }
+        breakpoint_set(cpu, next);
+    }
+
+    WriteHash writes = {0};
+    WriteHash *attached = cpu->writes;
+    size_t instructions = cpu->instruction_count;
+    size_t cycles = cpu->cycles;
+    cpu->writes = &writes;
+    run(cpu, context);
+    cpu->writes = attached;
+    if (cpu->blocks) {
+        breakpoint_clear(cpu, next);
+    }
+
+    memset(result, 0, sizeof(VectorResult));
+    cpu_flags_sync(cpu);
+    result->reg = cpu->reg;
+    result->ime = cpu->ime;
+    result->crashed = cpu->crashed;
+    result->cycles = cpu->cycles - cycles < UINT8_MAX ? cpu->cycles - cycles : UINT8_MAX;
+    result->instructions = cpu->instruction_count - instructions;
+    result->stores = writes.count < UINT8_MAX ? writes.count : UINT8_MAX;
+    for (size_t i = 0; i < writes.count && i < VECTOR_MAX_STORES; ++i) {
+        result->store_addr[i] = writes.log_addr[i];
+        result->store_value[i] = writes.log_value[i];
+    }
+
+    for (size_t i = 0; i < writes.count && i < WRITE_LOG; ++i) {
+        poke(cpu, writes.log_addr[i], 0);
+    }
+    for (uint8_t i = 0; i < input->count; ++i) {
+        poke(cpu, input->addr[i], 0);
+    }
+}
+
+static void registers(const cpu_registers *reg, uint16_t values[REGISTERS]) {
+    values[0] = reg->AF;
+    values[1] = reg->BC;
+    values[2] = reg->DE;
+    values[3] = reg->HL;
+    values[4] = reg->SP;
+    values[5] = reg->PC;
+}
+
+static void set_registers(cpu_registers *reg, const uint16_t values[REGISTERS]) {
+    reg->AF = values[0];
+    reg->BC = values[1];
+    reg->DE = values[2];
+    reg->HL = values[3];
+    reg->SP = values[4];
+    reg->PC = values[5];
+}
+
+// the registers of the input as a record leaves them, PC after the instruction
+static void unchanged_registers(const VectorInput *input, uint16_t values[REGISTERS]) {
+    registers(&input->reg, values);
+    values[5] += input->length;
+}
+
+static size_t encode(uint8_t *out, const VectorInput *input, const VectorResult *result) {
+    uint16_t before[REGISTERS];
+    uint16_t after[REGISTERS];
+    unchanged_registers(input, before);
+    registers(&result->reg, after);
+
+    uint8_t changed = 0;
+    size_t size = 2;
+    for (int i = 0; i < REGISTERS; ++i) {
+        if (after[i] != before[i]) {
+            changed |= 1 << i;
+            memcpy(&out[size], &after[i], 2);
+            size += 2;
+        }
+    }
+    changed |= result->ime != input->ime ? CHANGED_IME : 0;
+    changed |= result->crashed ? CHANGED_CRASHED : 0;
+    out[0] = changed;
+    out[1] = result->cycles | result->stores << 6;
+    for (uint8_t i = 0; i < result->stores; ++i) {
+        memcpy(&out[size], &result->store_addr[i], 2);
+        out[size + 2] = result->store_value[i];
+        size += 3;
+    }
+    return size;
+}
+
+// Decodes the record at *offset, false when it does not end before end.
+static bool decode(const uint8_t *data, size_t *offset, size_t end, const VectorInput *input, VectorResult *result) {
+    size_t at = *offset;
+    if (at + 2 > end) {
+        return false;
+    }
+    uint8_t changed = data[at];
+    uint8_t timing = data[at + 1];
+    at += 2;
+
+    memset(result, 0, sizeof(VectorResult));
+    uint16_t values[REGISTERS];
+    unchanged_registers(input, values);
+    for (int i = 0; i < REGISTERS; ++i) {
+        if (changed & (1 << i)) {
+            if (at + 2 > end) {
+                return false;
+            }
+            memcpy(&values[i], &data[at], 2);
+            at += 2;
+        }
+    }
+    set_registers(&result->reg, values);
+    result->ime = input->ime != ((changed & CHANGED_IME) != 0);
+    result->crashed = (changed & CHANGED_CRASHED) != 0;
+    result->cycles = timing & 0x3F;
+    result->stores = timing >> 6;
+    result->instructions = 1;
+    for (uint8_t i = 0; i < result->stores; ++i) {
+        if (at + 3 > end) {
+            return false;
+        }
+        memcpy(&result->store_addr[i], &data[at], 2);
+        result->store_value[i] = data[at + 2];
+        at += 3;
+    }
+    *offset = at;
+    return true;
+}
+
+static void clock_step(GBCPU *cpu, void *context) {
+    (void)context;
+    cpu_clock(cpu, false, false);
+}
+
+bool vectors_write(const char *file, uint64_t seed, unsigned per_opcode) {
+    VectorsHeader header;
+    memset(&header, 0, sizeof(VectorsHeader));
+    memcpy(header.magic, VECTORS_MAGIC, 4);
+    header.version = VECTORS_VERSION;
+    header.per_opcode = per_opcode;
+    header.seed = seed;
+
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    memset(cpu->memory, 0, sizeof(cpu->memory));
+    uint8_t *records = malloc((size_t)VECTOR_OPCODES * per_opcode * RECORD_MAX);
+    size_t size = 0;
+    bool ok = true;
+
+    for (unsigned opcode = 0; opcode < VECTOR_OPCODES; ++opcode) {
+        header.offsets[opcode] = sizeof(VectorsHeader) + size;
+        if (!vector_opcode_defined(opcode)) {
+            continue;
+        }
+        for (unsigned i = 0; i < per_opcode; ++i) {
+            VectorInput input;
+            VectorResult result;
+            vector_input(seed, opcode, i, &input);
+            vector_run(cpu, &input, clock_step, NULL, &result);
+            if (result.stores > VECTOR_MAX_STORES || result.cycles > 0x3F) {
+                fprintf(stderr, "opcode $%03X vector %u: %u stores, %u cycles do not fit a record\n", opcode, i,
+                        result.stores, result.cycles);
+                ok = false;
+            }
+            size += encode(&records[size], &input, &result);
+        }
+    }
+    header.offsets[VECTOR_OPCODES] = sizeof(VectorsHeader) + size;
+
+    FILE *out = ok ? fopen(file, "wb") : NULL;
+    if (ok && out == NULL) {
+        perror(file);
+        ok = false;
+    }
+    if (out) {
+        ok = fwrite(&header, sizeof(VectorsHeader), 1, out) == 1 && fwrite(records, 1, size, out) == size;
+        ok = fclose(out) == 0 && ok;
+    }
+    free(records);
+    free(cpu);
+    return ok;
+}
+
+Vectors *vectors_open(const char *file) {
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        perror(file);
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        perror(file);
+        close(fd);
+        return NULL;
+    }
+    if ((size_t)info.st_size < sizeof(VectorsHeader)) {
+        fprintf(stderr, "%s: not a vector file\n", file);
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid without the descriptor
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror(file);
+        return NULL;
+    }
+
+    Vectors *vectors = calloc(1, sizeof(Vectors));
+    vectors->data = data;
+    vectors->size = info.st_size;
+    vectors->header = data;
+    const VectorsHeader *header = vectors->header;
+    bool ok = memcmp(header->magic, VECTORS_MAGIC, 4) == 0 && header->version == VECTORS_VERSION;
+    for (unsigned opcode = 0; opcode < VECTOR_OPCODES; ++opcode) {
+        ok = ok && header->offsets[opcode] <= header->offsets[opcode + 1];
+    }
+    ok = ok && header->offsets[0] == sizeof(VectorsHeader) && header->offsets[VECTOR_OPCODES] == vectors->size;
+    if (!ok) {
+        fprintf(stderr, "%s: not a vector file of version %d\n", file, VECTORS_VERSION);
+        vectors_close(vectors);
+        return NULL;
+    }
+    posix_madvise(data, vectors->size, POSIX_MADV_SEQUENTIAL);
+    return vectors;
+}
+
+void vectors_close(Vectors *vectors) {
+    munmap((void *)vectors->data, vectors->size);
+    free(vectors);
+}
+
+// the stores of a result as a WriteHash, which does not depend on their order
+static WriteHash store_hash(const VectorResult *result) {
+    WriteHash hash = {0};
+    for (uint8_t i = 0; i < result->stores && i < VECTOR_MAX_STORES; ++i) {
+        write_hash_add(&hash, result->store_addr[i], result->store_value[i]);
+    }
+    return hash;
+}
+
+static bool same_result(const VectorResult *a, const VectorResult *b) {
+    return memcmp(&a->reg, &b->reg, sizeof(cpu_registers)) == 0 && a->ime == b->ime && a->crashed == b->crashed &&
+           a->cycles == b->cycles && a->instructions == b->instructions && a->stores == b->stores &&
+           store_hash(a).hash == store_hash(b).hash;
+}
+
+static void report_stores(FILE *out, const char *name, const VectorResult *result, bool mark) {
+    fprintf(out, "  %-12s", name);
+    for (uint8_t i = 0; i < result->stores && i < VECTOR_MAX_STORES; ++i) {
+        fprintf(out, " $%04X=%02X", result->store_addr[i], result->store_value[i]);
+    }
+    if (result->stores == 0) {
+        fprintf(out, " none");
+    } else if (result->stores > VECTOR_MAX_STORES) {
+        fprintf(out, " and %u more", result->stores - VECTOR_MAX_STORES);
+    }
+    fprintf(out, "%s\n", mark ? "  <--" : "");
+}
+
+static void report(FILE *out, unsigned opcode, unsigned index, unsigned count, const VectorInput *input,
+                   const VectorResult *expected, const VectorResult *found) {
+    uint8_t bytes[3];
+    for (uint16_t i = 0; i < 3; ++i) {
+        bytes[i] = input_byte(input, input->reg.PC + i);
+    }
+    char text[GB_DISASM_SIZE];
+    gb_disasm(bytes, input->reg.PC, text);
+    fprintf(out, "opcode $%s%02X, vector %u of %u: %s at $%04X\n", opcode >= 0x100 ? "CB" : "", opcode & 0xFF,
+            index, count, text, input->reg.PC);
+
+    fprintf(out, "  start        AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X IME=%d\n", input->reg.AF, input->reg.BC,
+            input->reg.DE, input->reg.HL, input->reg.SP, input->ime);
+    fprintf(out, "  memory      ");
+    for (uint8_t i = 0; i < input->count; ++i) {
+        fprintf(out, " $%04X=%02X", input->addr[i], input->value[i]);
+    }
+    fprintf(out, "\n  %-12s %-8s %s\n", "", "expected", "found");
+
+    uint16_t a[REGISTERS];
+    uint16_t b[REGISTERS];
+    registers(&expected->reg, a);
+    registers(&found->reg, b);
+    for (int i = 0; i < REGISTERS; ++i) {
+        fprintf(out, "  %-12s %04X     %04X%s\n", register_names[i], a[i], b[i], a[i] != b[i] ? "  <--" : "");
+    }
+    fprintf(out, "  %-12s %d        %d%s\n", "IME", expected->ime, found->ime, expected->ime != found->ime ? "  <--" : "");
+    fprintf(out, "  %-12s %d        %d%s\n", "crashed", expected->crashed, found->crashed,
+            expected->crashed != found->crashed ? "  <--" : "");
+    fprintf(out, "  %-12s %-8u %u%s\n", "cycles", expected->cycles, found->cycles,
+            expected->cycles != found->cycles ? "  <--" : "");
+    fprintf(out, "  %-12s %-8zu %zu%s\n", "instructions", expected->instructions, found->instructions,
+            expected->instructions != found->instructions ? "  <--" : "");
+    bool same_stores = expected->stores == found->stores && store_hash(expected).hash == store_hash(found).hash;
+    report_stores(out, "stores", expected, false);
+    report_stores(out, "found stores", found, !same_stores);
+}
+
+size_t vectors_check(const Vectors *vectors, GBCPU *cpu, unsigned opcode, VerifyEngine run, void *context, FILE *out) {
+    if (!vector_opcode_defined(opcode)) {
+        return 0;
+    }
+    const VectorsHeader *header = vectors->header;
+    size_t offset = header->offsets[opcode];
+    size_t end = header->offsets[opcode + 1];
+    size_t failed = 0;
+
+    for (unsigned i = 0; i < header->per_opcode; ++i) {
+        VectorInput input;
+        VectorResult expected;
+        VectorResult found;
+        vector_input(header->seed, opcode, i, &input);
+        if (!decode(vectors->data, &offset, end, &input, &expected)) {
+            if (out) {
+                fprintf(out, "opcode $%03X: the file ends after %u of %u vectors\n", opcode, i, header->per_opcode);
+            }
+            return failed + header->per_opcode - i;
+        }
+        vector_run(cpu, &input, run, context, &found);
+        if (!same_result(&expected, &found)) {
+            if (failed == 0 && out) {
+                report(out, opcode, i, header->per_opcode, &input, &expected, &found);
+            }
+            failed++;
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,262 @@
+#include "verify.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "disasm.h"
+#include "tools.h"
+
+void verify_attach(Verifier *verifier, GBCPU *reference, GBCPU *engine, VerifyEngine run, void *context) {
+    memset(verifier, 0, sizeof(Verifier));
+    verifier->reference = reference;
+    verifier->engine = engine;
+    verifier->run = run;
+    verifier->context = context;
+    reference->writes = calloc(1, sizeof(WriteHash));
+    engine->writes = calloc(1, sizeof(WriteHash));
+}
+
+void verify_detach(Verifier *verifier) {
+    free(verifier->reference->writes);
+    free(verifier->engine->writes);
+    verifier->reference->writes = NULL;
+    verifier->engine->writes = NULL;
+}
+
+static bool same_writes(const GBCPU *a, const GBCPU *b) {
+    if (a->writes == NULL || b->writes == NULL) {
+        return a->writes == b->writes;
+    }
+    return a->writes->hash == b->writes->hash && a->writes->count == b->writes->count;
+}
+
+bool verify_same_state(GBCPU *a, GBCPU *b) {
+    cpu_flags_sync(a);
+    cpu_flags_sync(b);
+    return a->reg.AF == b->reg.AF && a->reg.BC == b->reg.BC && a->reg.DE == b->reg.DE &&
+           a->reg.HL == b->reg.HL && a->reg.SP == b->reg.SP && a->reg.PC == b->reg.PC &&
+           a->ime == b->ime && a->crashed == b->crashed && a->instruction_count == b->instruction_count &&
+           a->cycles == b->cycles && same_writes(a, b);
+}
+
+bool verify_step(Verifier *verifier) {
+    GBCPU *engine = verifier->engine;
+    GBCPU *reference = verifier->reference;
+
+    verifier->synced = reference->instruction_count;
+    verifier->run(engine, verifier->context);
+    verifier->steps++;
+    while (!reference->crashed && reference->instruction_count < engine->instruction_count) {
+        cpu_clock(reference, false, false);
+    }
+
+    verifier->diverged = !verify_same_state(engine, reference);
+    return !verifier->diverged;
+}
+
+bool verify_run(Verifier *verifier, size_t instructions) {
+    GBCPU *engine = verifier->engine;
+    GBCPU *reference = verifier->reference;
+
+    while (!engine->crashed && (instructions == 0 || engine->instruction_count < instructions)) {
+        if (!verify_step(verifier)) {
+            return false;
+        }
+        if (serial_buffer_eol(&engine->buffer) || serial_buffer_eol(&reference->buffer)) {
+            if (strcmp(engine->buffer.buffer, reference->buffer.buffer) != 0) {
+                verifier->diverged = true;
+                return false;
+            }
+            memcpy(verifier->line, engine->buffer.buffer, SERIAL_BUFFER_SIZE);
+            serial_buffer_clear(&engine->buffer);
+            serial_buffer_clear(&reference->buffer);
+        }
+    }
+    return true;
+}
+
+static void report_row(FILE *out, const char *name, unsigned engine, unsigned reference, int digits) {
+    fprintf(out, "  %-12s %0*X%*s %0*X%s\n", name, digits, engine, 8 - digits, "", digits, reference,
+            engine != reference ? "  <--" : "");
+}
+
+static void report_count(FILE *out, const char *name, unsigned long long engine, unsigned long long reference) {
+    fprintf(out, "  %-12s %-8llu %llu%s\n", name, engine, reference, engine != reference ? "  <--" : "");
+}
+
+static void report_next(FILE *out, const char *name, const GBCPU *cpu) {
+    uint8_t bytes[3];
+    for (uint16_t i = 0; i < 3; ++i) {
+        bytes[i] = cpu->memory[(uint16_t)(cpu->reg.PC + i)];
+    }
+    char text[GB_DISASM_SIZE];
+    gb_disasm(bytes, cpu->reg.PC, text);
+    fprintf(out, "%s next: $%04X %s\n", name, cpu->reg.PC, text);
+}
+
+void verify_report(const Verifier *verifier, FILE *out) {
+    GBCPU *engine = verifier->engine;
+    GBCPU *reference = verifier->reference;
+    if (!verifier->diverged) {
+        fprintf(out, "no divergence in %zu steps, %zu instructions\n", verifier->steps, reference->instruction_count);
+        return;
+    }
+
+    cpu_flags_sync(engine);
+    cpu_flags_sync(reference);
+    fprintf(out, "diverged in step %zu, instructions %zu to %zu\n", verifier->steps, verifier->synced,
+            reference->instruction_count);
+    fprintf(out, "  %-12s %-8s %s\n", "", "engine", "reference");
+    report_row(out, "AF", engine->reg.AF, reference->reg.AF, 4);
+    report_row(out, "BC", engine->reg.BC, reference->reg.BC, 4);
+    report_row(out, "DE", engine->reg.DE, reference->reg.DE, 4);
+    report_row(out, "HL", engine->reg.HL, reference->reg.HL, 4);
+    report_row(out, "SP", engine->reg.SP, reference->reg.SP, 4);
+    report_row(out, "PC", engine->reg.PC, reference->reg.PC, 4);
+    report_row(out, "IME", engine->ime, reference->ime, 1);
+    report_row(out, "crashed", engine->crashed, reference->crashed, 1);
+    report_count(out, "instructions", engine->instruction_count, reference->instruction_count);
+    report_count(out, "cycles", engine->cycles, reference->cycles);
+    if (engine->writes && reference->writes) {
+        report_count(out, "writes", engine->writes->count, reference->writes->count);
+        fprintf(out, "  %-12s %016llX %016llX\n", "write hash", (unsigned long long)engine->writes->hash,
+                (unsigned long long)reference->writes->hash);
+    }
+    if (strcmp(engine->buffer.buffer, reference->buffer.buffer) != 0) {
+        fprintf(out, "  serial differs: \"%s\" and \"%s\"\n", engine->buffer.buffer, reference->buffer.buffer);
+    }
+
+    for (size_t addr = 0; addr < 0x10000; ++addr) {
+        if (engine->memory[addr] != reference->memory[addr]) {
+            fprintf(out, "first memory difference at $%04zX: %02X and %02X\n", addr, engine->memory[addr],
+                    reference->memory[addr]);
+            break;
+        }
+    }
+
+    // the instructions of the step that diverged, after a few before it
+    fprintf(out, "reference ran:\n");
+    size_t first = verifier->synced > VERIFY_HISTORY ? verifier->synced - VERIFY_HISTORY : 0;
+    char line[HISTORY_LINE_SIZE];
+    for (size_t i = first; i < reference->instruction_count; ++i) {
+        if (cpu_history_line(reference, i, line)) {
+            fprintf(out, "%c %s\n", i >= verifier->synced ? '>' : ' ', line);
+        }
+    }
+    report_next(out, "engine   ", engine);
+    report_next(out, "reference", reference);
+}
+
+// xorshift64*
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+// operations that keep HL and SP in WRAM, besides the LD r,r', ALU, CB and
+// JR picked in random_instr
+static const uint8_t random_ops[] = {
+    0x00, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x13, 0x14, 0x15, 0x16,
+    0x17, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x22, 0x23, 0x27, 0x2A, 0x2B, 0x2F, 0x32, 0x34, 0x35,
+    0x36, 0x37, 0x3A, 0x3C, 0x3D, 0x3E, 0x3F, 0xC1, 0xC5, 0xC6, 0xCE, 0xD1, 0xD5, 0xD6, 0xDE, 0xE5,
+    0xE6, 0xEE, 0xF1, 0xF3, 0xF5, 0xF6, 0xFB, 0xFE,
+};
+
+typedef struct {
+    uint8_t bytes[3];
+    uint8_t length;
+    bool jump;    // a JR over the next skip instructions
+    uint8_t skip;
+} RandomInstr;
+
+static void random_instr(uint64_t *state, RandomInstr *instr) {
+    uint64_t r = next_random(state);
+    uint8_t op;
+    memset(instr, 0, sizeof(RandomInstr));
+    switch (r % 8) {
+    case 0:
+        // JR or JR cc forward
+        instr->bytes[0] = (const uint8_t[]){0x18, 0x20, 0x28, 0x30, 0x38}[(r >> 8) % 5];
+        instr->length = 2;
+        instr->jump = true;
+        instr->skip = (r >> 16) % 4;
+        return;
+    case 1:
+        // CB, with (HL) instead of H or L unless it is a BIT
+        op = r >> 8;
+        if ((op & 0x07) == 4 || (op & 0x07) == 5) {
+            op = (op & 0xC0) == 0x40 ? op : (op & ~0x07) | 0x06;
+        }
+        instr->bytes[0] = 0xCB;
+        instr->bytes[1] = op;
+        instr->length = 2;
+        return;
+    case 2:
+    case 3:
+        // LD r,r', into A instead of H or L, and LD A,r instead of HALT
+        op = 0x40 + (r >> 8) % 0x40;
+        if (op == 0x76 || (op >= 0x60 && op < 0x70)) {
+            op = 0x78 + (op & 0x07);
+        }
+        break;
+    case 4:
+    case 5:
+        op = 0x80 + (r >> 8) % 0x40;
+        break;
+    default:
+        op = random_ops[(r >> 8) % sizeof(random_ops)];
+        break;
+    }
+    instr->bytes[0] = op;
+    instr->length = opcodes[op].length;
+    for (uint8_t i = 1; i < instr->length; ++i) {
+        instr->bytes[i] = next_random(state);
+    }
+}
+
+void verify_random_program(GBCPU *cpu, uint64_t seed, uint16_t addr, size_t size) {
+    uint64_t state = seed * 0x9E3779B97F4A7C15ull + 1;
+    RandomInstr *instrs = malloc(size * sizeof(RandomInstr));
+    size_t count = 0;
+    size_t length = 0;
+    while (length + 3 + 2 <= size) {
+        random_instr(&state, &instrs[count]);
+        length += instrs[count].length;
+        count++;
+    }
+
+    uint16_t at = addr;
+    for (size_t i = 0; i < count; ++i) {
+        const RandomInstr *instr = &instrs[i];
+        memcpy(&cpu->memory[at], instr->bytes, instr->length);
+        if (instr->jump) {
+            uint8_t offset = 0;
+            for (size_t k = 1; k <= instr->skip && i + k < count; ++k) {
+                offset += instrs[i + k].length;
+            }
+            cpu->memory[at + 1] = offset;
+        }
+        at += instr->length;
+    }
+    // pad to size and stop in an infinite loop
+    while (at < addr + size - 2) {
+        cpu->memory[at++] = 0x00;
+    }
+    cpu->memory[at++] = 0x18; // JR -2
+    cpu->memory[at] = 0xFE;
+    free(instrs);
+
+    // data for the loads, below the stack and above the program
+    for (uint32_t data = 0xD000; data < 0xE000; ++data) {
+        cpu->memory[data] = next_random(&state);
+    }
+    cpu->reg.AF = next_random(&state) & 0xFFF0;
+    cpu->reg.BC = next_random(&state);
+    cpu->reg.DE = next_random(&state);
+    cpu->reg.HL = 0xD400 + next_random(&state) % 0x400;
+    cpu->reg.SP = 0xDE00;
+    cpu->reg.PC = addr;
+    cpu->ime = false;
+}
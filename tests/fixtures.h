@@ -0,0 +1,52 @@
+#pragma once
+#include <stdlib.h>
+#include <string.h>
+
+#include "acutest.h"
+#include "gbcpu.h"
+#include "tools.h"
+#include "verify.h"
+
+// Instances and the differential check shared by the engine tests.
+
+// A reset instance with all of memory 0.
+static inline GBCPU *new_cpu(void) {
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    return cpu;
+}
+
+// A reset instance with a ROM loaded and LY in VBlank, which the Blargg ROMs
+// wait for.
+static inline GBCPU *load_rom_cpu(const char *rom) {
+    GBCPU *cpu = new_cpu();
+    read_binary(rom, cpu->memory);
+    cpu->memory[0xFF44] = 0x90; // LY
+    return cpu;
+}
+
+static inline GBCPU *copy_cpu(const GBCPU *cpu) {
+    GBCPU *copy = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    memcpy(copy, cpu, sizeof(GBCPU));
+    return copy;
+}
+
+// Runs the engine, attached to engine by the caller, against cpu_clock on
+// reference until it crashes, which a Blargg ROM does in its final infinite
+// loop. Both have to hold the same state. Checks that they never diverge,
+// that all of memory matches at the end and whether the ROM passed.
+static inline void check_differential(GBCPU *reference, GBCPU *engine, VerifyEngine run, void *context,
+                                      const char *rom, bool passes) {
+    Verifier verifier;
+    verify_attach(&verifier, reference, engine, run, context);
+    if (!TEST_CHECK(verify_run(&verifier, 0))) {
+        TEST_MSG("%s", rom);
+        verify_report(&verifier, stderr);
+    }
+    TEST_CHECK((strcmp(verifier.line, "Passed\n") == 0) == passes);
+    TEST_MSG("%s: %s", rom, verifier.line);
+    TEST_CHECK(memcmp(engine->memory, reference->memory, 0x10000) == 0);
+    TEST_MSG("%s", rom);
+    verify_detach(&verifier);
+}
@@ -0,0 +1,79 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "aot.h"
+#include "fixtures.h"
+#include "gbcpu.h"
+
+typedef struct {
+    AotRuntime *runtime;
+    size_t native;
+    size_t fallback;
+} AotRun;
+
+static void run_aot(GBCPU *cpu, void *context) {
+    AotRun *run = context;
+    if (aot_run(run->runtime, cpu)) {
+        run->native++;
+    } else {
+        run->fallback++;
+    }
+}
+
+// Runs a translated ROM and cpu_clock side by side, comparing the state
+// after every block.
+static void run_differential(const char *module, const char *rom) {
+    AotRun run = {aot_load(module), 0, 0};
+    TEST_ASSERT(run.runtime != NULL);
+    TEST_MSG("%s", module);
+
+    GBCPU *reference = load_rom_cpu(rom);
+    GBCPU *aot = copy_cpu(reference);
+    check_differential(reference, aot, run_aot, &run, rom, true);
+    // the Blargg ROMs copy their test code to WRAM, which runs in cpu_clock
+    TEST_CHECK(run.native > 0 && run.fallback > 0);
+    TEST_MSG("%s: %zu blocks of %zu translated", rom, run.native, run.native + run.fallback);
+
+    aot_unload(run.runtime);
+    free(aot);
+    free(reference);
+}
+
+void test_aot_blargg() {
+    run_differential("./aot_06.so", "../tests/roms/06-ld r,r.gb");
+    run_differential("./aot_07.so", "../tests/roms/07-jr,jp,call,ret,rst.gb");
+    run_differential("./aot_09.so", "../tests/roms/09-op r,r.gb");
+}
+
+void test_aot_stale_block() {
+    AotRuntime *runtime = aot_load("./aot_06.so");
+    TEST_ASSERT(runtime != NULL);
+    TEST_CHECK(runtime->entry[0x0100] != NULL);
+
+    // a block whose bytes changed is not run, cpu_clock runs one instruction
+    GBCPU *cpu = load_rom_cpu("../tests/roms/06-ld r,r.gb");
+    cpu->memory[0x0102] ^= 0xFF; // the target of JP $0213
+    TEST_CHECK(!aot_run(runtime, cpu));
+    TEST_CHECK(cpu->reg.PC == 0x0101);
+    TEST_CHECK(cpu->instruction_count == 1);
+
+    // neither is code gb_aot did not find
+    cpu->reg.PC = 0xC000;
+    TEST_CHECK(!aot_run(runtime, cpu));
+    TEST_CHECK(cpu->instruction_count == 2);
+
+    aot_unload(runtime);
+    free(cpu);
+}
+
+void test_aot_version() {
+    static const AotModule old = {AOT_VERSION + 1, 0, NULL};
+    TEST_CHECK(aot_attach_module(&old) == NULL);
+    TEST_CHECK(aot_load("./missing.so") == NULL);
+}
+
+TEST_LIST = {
+    {"AOT Blargg", test_aot_blargg},
+    {"AOT stale block", test_aot_stale_block},
+    {"AOT version", test_aot_version},
+    {NULL, NULL}};
@@ -0,0 +1,318 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "blocks.h"
+#include "engines.h"
+#include "fixtures.h"
+#include "gbcpu.h"
+
+// Runs the block engine against cpu_clock, comparing the state at every
+// block boundary.
+static void run_differential(const char *rom, bool passes) {
+    GBCPU *reference = load_rom_cpu(rom);
+    GBCPU *blocks = copy_cpu(reference);
+    Engine engine = ENGINE_BLOCKS;
+    engine_attach(blocks, engine);
+    check_differential(reference, blocks, engine_run, &engine, rom, passes);
+
+    // blocks are only decoded again after self-modifying code invalidated them
+    BlockCache *cache = blocks->blocks;
+    TEST_CHECK((cache->decoded - cache->invalidated) * 100 < cache->executed);
+    TEST_MSG("%s decoded %zu, executed %zu, invalidated %zu", rom, cache->decoded, cache->executed, cache->invalidated);
+
+    engine_detach(blocks);
+    free(blocks);
+    free(reference);
+}
+
+void test_blocks_blargg() {
+    // 02-interrupts does not pass with cpu_clock either, it only has to match
+    run_differential("../tests/roms/01-special.gb", true);
+    run_differential("../tests/roms/02-interrupts.gb", false);
+    run_differential("../tests/roms/03-op sp,hl.gb", true);
+    run_differential("../tests/roms/04-op r,imm.gb", true);
+    run_differential("../tests/roms/05-op rp.gb", true);
+    run_differential("../tests/roms/06-ld r,r.gb", true);
+    run_differential("../tests/roms/07-jr,jp,call,ret,rst.gb", true);
+    run_differential("../tests/roms/08-misc instrs.gb", true);
+    run_differential("../tests/roms/09-op r,r.gb", true);
+    run_differential("../tests/roms/10-bit ops.gb", true);
+    run_differential("../tests/roms/11-op a,(hl).gb", true);
+}
+
+void test_blocks_loop_decoded_once() {
+    uint8_t program[] = {
+        0x06, 0x00, // LD B,0
+        0x0E, 0x10, // LD C,16
+        0x04,       // INC B
+        0x0D,       // DEC C
+        0x20, 0xFC, // JR NZ,-4
+        0x18, 0xFE, // JR -2
+    };
+
+    GBCPU *cpu = new_cpu();
+    memcpy(&cpu->memory[0xC000], program, sizeof(program));
+    cpu->reg.PC = 0xC000;
+    block_cache_attach(cpu);
+
+    while (!cpu->crashed) {
+        block_run(cpu);
+    }
+
+    // entry block, loop body and the final JR
+    TEST_CHECK(cpu->reg.B == 0x10);
+    TEST_CHECK(cpu->reg.PC == 0xC008);
+    TEST_CHECK(cpu->blocks->decoded == 3);
+    TEST_MSG("decoded %zu", cpu->blocks->decoded);
+    TEST_CHECK(cpu->blocks->executed == 17);
+
+    block_cache_detach(cpu);
+    free(cpu);
+}
+
+void test_blocks_self_modifying() {
+    // an HRAM routine that patches its own LD A,n operand, the way DMA
+    // trampolines get copied and rewritten
+    uint8_t program[] = {
+        0x3E, 0x01,       // $FF80 LD A,1
+        0x80,             // $FF82 ADD A,B
+        0xEA, 0x81, 0xFF, // $FF83 LD ($FF81),A
+        0x05,             // $FF86 DEC B
+        0x20, 0xF7,       // $FF87 JR NZ,-9
+        0x18, 0xFE,       // $FF89 JR -2
+    };
+
+    GBCPU *blocks = new_cpu();
+    memcpy(&blocks->memory[0xFF80], program, sizeof(program));
+    blocks->reg.PC = 0xFF80;
+    blocks->reg.B = 0x20;
+    blocks->reg.SP = 0xDFFF;
+    GBCPU *reference = copy_cpu(blocks);
+    block_cache_attach(blocks);
+
+    while (!blocks->crashed) {
+        block_run(blocks);
+    }
+    while (!reference->crashed) {
+        cpu_clock(reference, false, false);
+    }
+
+    TEST_CHECK(verify_same_state(blocks, reference));
+    TEST_CHECK(blocks->reg.A == reference->reg.A);
+    TEST_MSG("A=%02X expected %02X", blocks->reg.A, reference->reg.A);
+    TEST_CHECK(blocks->blocks->invalidated == 0x20);
+    TEST_MSG("invalidated %zu", blocks->blocks->invalidated);
+
+    // a push over cached code invalidates it too
+    block_cache_detach(blocks);
+    cpu_initialize(blocks);
+    block_cache_attach(blocks);
+    blocks->reg.PC = 0xFF80;
+    blocks->reg.SP = 0xFF82;
+    blocks->memory[0xFF80] = 0xC5; // PUSH BC
+    blocks->memory[0xFF81] = 0x00; // NOP
+    blocks->reg.BC = 0x1800;       // pushes JR 0 over $FF80
+    block_run(blocks);
+    TEST_CHECK(blocks->blocks->invalidated == 1);
+    TEST_CHECK(blocks->instruction_count == 1);
+
+    block_cache_detach(blocks);
+    free(blocks);
+    free(reference);
+}
+
+static uint8_t fused_program[] = {
+    0x06, 0x40,       // $C000 LD B,$40
+    0x05,             // $C002 DEC B
+    0x20, 0xFD,       // $C003 JR NZ,-3
+    0x21, 0x00, 0xC1, // $C005 LD HL,$C100
+    0x11, 0x00, 0xC2, // $C008 LD DE,$C200
+    0x01, 0x80, 0x00, // $C00B LD BC,$0080
+    0x2A,             // $C00E LDI A,(HL)
+    0x12,             // $C00F LD (DE),A
+    0x13,             // $C010 INC DE
+    0x0B,             // $C011 DEC BC
+    0x78,             // $C012 LD A,B
+    0xB1,             // $C013 OR C
+    0x20, 0xF8,       // $C014 JR NZ,-8
+    0x0E, 0x10,       // $C016 LD C,$10
+    0xF0, 0x80,       // $C018 LDH A,($80)
+    0xE6, 0x01,       // $C01A AND $01
+    0x28, 0x02,       // $C01C JR Z,+2
+    0x3C,             // $C01E INC A
+    0x00,             // $C01F NOP
+    0x0D,             // $C020 DEC C
+    0x20, 0xF5,       // $C021 JR NZ,-11
+    0x18, 0xFE,       // $C023 JR -2
+};
+
+static GBCPU *load_fused_program(uint8_t hram) {
+    GBCPU *cpu = new_cpu();
+    memcpy(&cpu->memory[0xC000], fused_program, sizeof(fused_program));
+    for (size_t i = 0; i < 0x80; ++i) {
+        cpu->memory[0xC100 + i] = rand();
+    }
+    cpu->memory[0xFF80] = hram;
+    cpu->reg.PC = 0xC000;
+    return cpu;
+}
+
+void test_blocks_fused() {
+    srand(99);
+    for (uint8_t hram = 0; hram < 2; ++hram) {
+        GBCPU *blocks = load_fused_program(hram);
+        GBCPU *reference = copy_cpu(blocks);
+        block_cache_attach(blocks);
+
+        while (!blocks->crashed) {
+            block_run(blocks);
+        }
+        while (!reference->crashed) {
+            cpu_clock(reference, false, false);
+        }
+
+        TEST_CHECK(verify_same_state(blocks, reference));
+        TEST_CHECK(memcmp(blocks->memory, reference->memory, 0x10000) == 0);
+        BlockCache *cache = blocks->blocks;
+        for (int fuse = FUSE_DEC_JR; fuse <= FUSE_COPY; ++fuse) {
+            TEST_CHECK(cache->fused[fuse] > 0);
+            TEST_MSG("%s ran %zu instructions", block_fuse_names[fuse], cache->fused[fuse]);
+        }
+        // the DEC B loop and the copy loop each run in a single pass
+        TEST_CHECK(cache->fused[FUSE_DEC_JR] == 2 * 0x40 + 2 * 0x10);
+        TEST_CHECK(cache->fused[FUSE_COPY] == 7 * 0x80);
+        TEST_CHECK(cache->fuse_fallbacks == 0);
+
+        block_cache_detach(blocks);
+        free(blocks);
+        free(reference);
+    }
+}
+
+void test_blocks_fused_deadline() {
+    // a deadline inside a fused loop stops it after whole passes, a deadline
+    // closer than one pass falls back to single instructions
+    GBCPU *blocks = load_fused_program(0);
+    GBCPU *reference = copy_cpu(blocks);
+    block_cache_attach(blocks);
+    BlockCache *cache = blocks->blocks;
+
+    // LD B,$40 and five passes of DEC B; JR NZ
+    cache->deadline = 8 + 5 * (4 + 12) + 3;
+    block_run(blocks);
+    TEST_CHECK(blocks->reg.B == 0x40 - 5);
+    TEST_CHECK(blocks->reg.PC == 0xC002);
+    TEST_CHECK(cache->fused[FUSE_DEC_JR] == 10);
+
+    while (!blocks->crashed) {
+        cache->deadline = blocks->cycles + 8;
+        block_run(blocks);
+    }
+    while (!reference->crashed) {
+        cpu_clock(reference, false, false);
+    }
+
+    TEST_CHECK(verify_same_state(blocks, reference));
+    TEST_CHECK(memcmp(blocks->memory, reference->memory, 0x10000) == 0);
+    TEST_CHECK(cache->fused[FUSE_DEC_JR] == 10);
+    TEST_CHECK(cache->fused[FUSE_COPY] == 0);
+    TEST_CHECK(cache->fuse_fallbacks > 0);
+
+    block_cache_detach(blocks);
+    free(blocks);
+    free(reference);
+}
+
+static uint8_t bulk_program[] = {
+    0x21, 0x00, 0xC3, // $C000 LD HL,$C300
+    0x3E, 0x5A,       // $C003 LD A,$5A
+    0x06, 0x00,       // $C005 LD B,$00
+    0x22,             // $C007 LDI (HL),A
+    0x05,             // $C008 DEC B
+    0x20, 0xFC,       // $C009 JR NZ,-4
+    0x21, 0xFF, 0xC7, // $C00B LD HL,$C7FF
+    0x01, 0x00, 0x03, // $C00E LD BC,$0300
+    0xAF,             // $C011 XOR A
+    0x32,             // $C012 LDD (HL),A
+    0x0B,             // $C013 DEC BC
+    0x78,             // $C014 LD A,B
+    0xB1,             // $C015 OR C
+    0x20, 0xF9,       // $C016 JR NZ,-7
+    0x21, 0xFF, 0x9F, // $C018 LD HL,$9FFF
+    0x3E, 0x33,       // $C01B LD A,$33
+    0x32,             // $C01D LDD (HL),A
+    0xCB, 0x7C,       // $C01E BIT 7,H
+    0x20, 0xFB,       // $C020 JR NZ,-5
+    0x21, 0x00, 0xC2, // $C022 LD HL,$C200
+    0x11, 0x00, 0xD0, // $C025 LD DE,$D000
+    0x0E, 0x80,       // $C028 LD C,$80
+    0x2A,             // $C02A LDI A,(HL)
+    0x12,             // $C02B LD (DE),A
+    0x13,             // $C02C INC DE
+    0x0D,             // $C02D DEC C
+    0x20, 0xFA,       // $C02E JR NZ,-6
+    0xCD, 0x00, 0xD8, // $C030 CALL $D800
+    0x21, 0x00, 0xD8, // $C033 LD HL,$D800
+    0xAF,             // $C036 XOR A
+    0x06, 0x10,       // $C037 LD B,$10
+    0x22,             // $C039 LDI (HL),A
+    0x05,             // $C03A DEC B
+    0x20, 0xFC,       // $C03B JR NZ,-4
+    0xCD, 0x00, 0xD8, // $C03D CALL $D800
+    0x18, 0xFE,       // $C040 JR -2
+};
+
+void test_blocks_bulk() {
+    // fill and copy loops run as one memset or memmove, with and without a
+    // deadline cutting them into several runs
+    srand(7);
+    for (size_t slice = 0; slice < 2; ++slice) {
+        GBCPU *blocks = new_cpu();
+        memcpy(&blocks->memory[0xC000], bulk_program, sizeof(bulk_program));
+        for (size_t i = 0; i < 0x80; ++i) {
+            blocks->memory[0xC200 + i] = rand();
+        }
+        // RET, then overwritten by NOPs running into the second RET
+        blocks->memory[0xD800] = 0xC9;
+        blocks->memory[0xD810] = 0xC9;
+        blocks->reg.PC = 0xC000;
+        GBCPU *reference = copy_cpu(blocks);
+        block_cache_attach(blocks);
+        BlockCache *cache = blocks->blocks;
+
+        while (!blocks->crashed) {
+            if (slice) {
+                cache->deadline = blocks->cycles + 1000;
+            }
+            block_run(blocks);
+        }
+        while (!reference->crashed) {
+            cpu_clock(reference, false, false);
+        }
+
+        TEST_CHECK(verify_same_state(blocks, reference));
+        TEST_CHECK(memcmp(blocks->memory, reference->memory, 0x10000) == 0);
+        TEST_CHECK(cache->fused[FUSE_FILL] == 3 * 0x100 + 3 * 0x10);
+        TEST_CHECK(cache->fused[FUSE_FILL_BC] == 6 * 0x300);
+        TEST_CHECK(cache->fused[FUSE_FILL_H] == 3 * 0x2000);
+        TEST_CHECK(cache->fused[FUSE_COPY_R] == 5 * 0x80);
+        TEST_MSG("fill %zu, long fill %zu, fill to H %zu, copy %zu", cache->fused[FUSE_FILL],
+                 cache->fused[FUSE_FILL_BC], cache->fused[FUSE_FILL_H], cache->fused[FUSE_COPY_R]);
+        TEST_CHECK(cache->fuse_fallbacks == 0);
+        // the fill over $D800 dropped the block holding the first RET
+        TEST_CHECK(cache->invalidated == 1);
+
+        block_cache_detach(blocks);
+        free(blocks);
+        free(reference);
+    }
+}
+
+TEST_LIST = {
+    {"Blocks Blargg", test_blocks_blargg},
+    {"Blocks loop decoded once", test_blocks_loop_decoded_once},
+    {"Blocks self-modifying code", test_blocks_self_modifying},
+    {"Blocks fused idioms", test_blocks_fused},
+    {"Blocks fused idioms with a deadline", test_blocks_fused_deadline},
+    {"Blocks fill and copy loops", test_blocks_bulk},
+    {NULL, NULL}};
@@ -0,0 +1,231 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "blocks.h"
+#include "breakpoints.h"
+#include "gbcpu.h"
+#include "tools.h"
+
+// stores $55 to $C800-$C83F in a loop the block cache fuses into a memset,
+// then stops in an infinite loop
+static const uint8_t fill_program[] = {
+    0x21, 0x00, 0xC8, // LD HL,$C800
+    0x3E, 0x55,       // LD A,$55
+    0x06, 0x40,       // LD B,$40
+    0x22,             // $C007: LDI (HL),A
+    0x05,             // DEC B
+    0x20, 0xFC,       // JR NZ,$C007
+    0x18, 0xFE,       // JR $C00B
+};
+
+static GBCPU *load_program(void) {
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    memcpy(&cpu->memory[0xC000], fill_program, sizeof(fill_program));
+    cpu->reg.PC = 0xC000;
+    return cpu;
+}
+
+static GBCPU *load_rom(char *rom) {
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    read_binary(rom, cpu->memory);
+    cpu->memory[0xFF44] = 0x90; // LY
+    return cpu;
+}
+
+// Runs until the CPU stops or crashes, through the block cache or stepping
+// cpu_clock. Returns whether it stopped.
+static bool run_until_stopped(GBCPU *cpu, bool blocks) {
+    while (!cpu->crashed) {
+        if (blocks) {
+            block_run(cpu);
+        } else if (!breakpoints_check(cpu)) {
+            cpu_clock(cpu, false, false);
+        }
+        if (cpu->breakpoints->hit.kind != BREAK_NONE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void free_cpu(GBCPU *cpu) {
+    breakpoints_detach(cpu);
+    block_cache_detach(cpu);
+    free(cpu);
+}
+
+void test_breakpoints_pc() {
+    // a breakpoint at the start of the fused loop and one inside it stop on
+    // every pass, the same with and without the block cache
+    const uint16_t pcs[] = {0xC007, 0xC008};
+    for (size_t blocks = 0; blocks < 2; ++blocks) {
+        for (size_t i = 0; i < 2; ++i) {
+            GBCPU *cpu = load_program();
+            if (blocks) {
+                block_cache_attach(cpu);
+            }
+            breakpoints_attach(cpu);
+            breakpoint_set(cpu, pcs[i]);
+
+            size_t hits = 0;
+            while (run_until_stopped(cpu, blocks)) {
+                const BreakHit *hit = &cpu->breakpoints->hit;
+                TEST_CHECK(hit->kind == BREAK_PC && hit->addr == pcs[i] && cpu->reg.PC == pcs[i]);
+                TEST_CHECK(hit->instruction == 3 + i + 3 * hits);
+                TEST_CHECK(cpu->instruction_count == hit->instruction);
+                TEST_MSG("hit %zu at %zu", hits, hit->instruction);
+                hits++;
+                breakpoints_resume(cpu);
+            }
+            TEST_CHECK(hits == 0x40);
+            TEST_MSG("$%04X %s: %zu hits", pcs[i], blocks ? "blocks" : "cpu_clock", hits);
+            TEST_CHECK(cpu->reg.HL == 0xC840);
+            free_cpu(cpu);
+        }
+    }
+}
+
+void test_breakpoints_watch() {
+    // the store into a watched page leaves the memset, the run stops after
+    // the store into $C820 and not at the other ones
+    for (size_t blocks = 0; blocks < 2; ++blocks) {
+        GBCPU *cpu = load_program();
+        if (blocks) {
+            block_cache_attach(cpu);
+        }
+        breakpoints_attach(cpu);
+        watchpoint_set(cpu, 0xC820);
+
+        TEST_ASSERT(run_until_stopped(cpu, blocks));
+        const BreakHit *hit = &cpu->breakpoints->hit;
+        TEST_CHECK(hit->kind == BREAK_WATCH && hit->addr == 0xC820);
+        TEST_CHECK(hit->old_value == 0x00 && hit->new_value == 0x55);
+        TEST_CHECK(hit->instruction == 3 + 0x20 * 3);
+        TEST_CHECK(cpu->memory[0xC820] == 0x55 && cpu->memory[0xC821] == 0x00);
+        // the rest of the block ran
+        TEST_CHECK(cpu->instruction_count > hit->instruction && cpu->instruction_count <= hit->instruction + 3);
+
+        breakpoints_resume(cpu);
+        TEST_CHECK(!run_until_stopped(cpu, blocks));
+        TEST_CHECK(cpu->reg.HL == 0xC840 && cpu->memory[0xC83F] == 0x55);
+        if (blocks) {
+            // the fill was not run as a memset over the watched page
+            TEST_CHECK(cpu->blocks->fused[FUSE_FILL] == 0 && cpu->blocks->fuse_fallbacks > 0);
+        }
+        free_cpu(cpu);
+    }
+
+    // a store of the value already there does not stop the run
+    GBCPU *cpu = load_program();
+    cpu->memory[0xC820] = 0x55;
+    breakpoints_attach(cpu);
+    watchpoint_set(cpu, 0xC820);
+    TEST_CHECK(!run_until_stopped(cpu, false));
+    free_cpu(cpu);
+}
+
+void test_breakpoints_rom() {
+    // the block cache stops where stepping cpu_clock reaches the same PC or
+    // changes the same address
+    char *rom = "../tests/roms/06-ld r,r.gb";
+    GBCPU *cpu = load_rom(rom);
+    GBCPU *reference = load_rom(rom);
+    block_cache_attach(cpu);
+    breakpoints_attach(cpu);
+    while (cpu->instruction_count < 100000) {
+        block_run(cpu);
+    }
+    while (reference->instruction_count < cpu->instruction_count + 5) {
+        cpu_clock(reference, false, false);
+    }
+
+    // setting a breakpoint drops the cached blocks running over it
+    uint16_t pc = reference->reg.PC;
+    size_t invalidated = cpu->blocks->invalidated;
+    breakpoint_set(cpu, pc);
+    TEST_CHECK(cpu->blocks->invalidated > invalidated);
+
+    memcpy(reference, cpu, sizeof(GBCPU));
+    reference->blocks = NULL;
+    reference->breakpoints = NULL;
+    while (reference->reg.PC != pc) {
+        cpu_clock(reference, false, false);
+    }
+    TEST_ASSERT(run_until_stopped(cpu, true));
+    TEST_CHECK(cpu->reg.PC == pc);
+    TEST_CHECK(cpu->instruction_count == reference->instruction_count);
+    TEST_MSG("$%04X: %zu, reference %zu", pc, cpu->instruction_count, reference->instruction_count);
+    breakpoint_clear(cpu, pc);
+    breakpoints_resume(cpu);
+
+    // the next change of the serial data register
+    watchpoint_set(cpu, 0xFF01);
+    memcpy(reference, cpu, sizeof(GBCPU));
+    reference->blocks = NULL;
+    reference->breakpoints = NULL;
+    uint8_t old_value = cpu->memory[0xFF01];
+    while (!reference->crashed && reference->memory[0xFF01] == old_value) {
+        cpu_clock(reference, false, false);
+    }
+    TEST_ASSERT(run_until_stopped(cpu, true));
+    const BreakHit *hit = &cpu->breakpoints->hit;
+    TEST_CHECK(hit->kind == BREAK_WATCH && hit->addr == 0xFF01 && hit->old_value == old_value);
+    TEST_CHECK(hit->instruction + 1 == reference->instruction_count);
+    TEST_CHECK(hit->new_value == reference->memory[0xFF01]);
+    TEST_MSG("store at %zu, reference %zu", hit->instruction, reference->instruction_count - 1);
+    free(reference);
+    free_cpu(cpu);
+}
+
+void test_breakpoints_detached() {
+    // runs without stopping once detached, blocks are decoded whole again
+    GBCPU *cpu = load_program();
+    block_cache_attach(cpu);
+    breakpoints_attach(cpu);
+    breakpoint_set(cpu, 0xC008);
+    TEST_ASSERT(run_until_stopped(cpu, true));
+    breakpoints_detach(cpu);
+    TEST_CHECK(cpu->breakpoints == NULL);
+    while (!cpu->crashed) {
+        block_run(cpu);
+    }
+    TEST_CHECK(cpu->reg.HL == 0xC840);
+    TEST_CHECK(cpu->blocks->fused[FUSE_FILL] > 0);
+    free_cpu(cpu);
+}
+
+void test_breakpoints_unattached() {
+    // clearing on an instance without breakpoints leaves it without them
+    GBCPU *cpu = load_program();
+    breakpoint_clear(cpu, 0xC008);
+    watchpoint_clear(cpu, 0xC820);
+    breakpoints_resume(cpu);
+    TEST_CHECK(cpu->breakpoints == NULL);
+
+    // setting attaches them
+    block_cache_attach(cpu);
+    breakpoint_set(cpu, 0xC008);
+    TEST_ASSERT(cpu->breakpoints != NULL);
+    TEST_CHECK(run_until_stopped(cpu, true));
+    TEST_CHECK(cpu->breakpoints->hit.kind == BREAK_PC && cpu->reg.PC == 0xC008);
+    free_cpu(cpu);
+
+    cpu = load_program();
+    watchpoint_set(cpu, 0xC820);
+    TEST_ASSERT(cpu->breakpoints != NULL);
+    TEST_CHECK(run_until_stopped(cpu, false));
+    TEST_CHECK(cpu->breakpoints->hit.kind == BREAK_WATCH && cpu->breakpoints->hit.addr == 0xC820);
+    free_cpu(cpu);
+}
+
+TEST_LIST = {
+    {"Breakpoints PC", test_breakpoints_pc},
+    {"Breakpoints watch", test_breakpoints_watch},
+    {"Breakpoints ROM", test_breakpoints_rom},
+    {"Breakpoints detached", test_breakpoints_detached},
+    {"Breakpoints unattached", test_breakpoints_unattached},
+    {NULL, NULL}};
@@ -0,0 +1,204 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "blocks.h"
+#include "callstack.h"
+#include "gbcpu.h"
+#include "tools.h"
+
+// main calls outer 16 times, outer calls inner 32 times, inner counts down
+// from 8
+static const uint8_t nested_program[] = {
+    0x31, 0xFE, 0xDF, // $C000: LD SP,$DFFE
+    0x06, 0x10,       // LD B,$10
+    0xCD, 0x10, 0xC0, // $C005: CALL $C010
+    0x05,             // DEC B
+    0x20, 0xFA,       // JR NZ,$C005
+    0x18, 0xFE,       // $C00B: JR $C00B
+    0x00, 0x00, 0x00,
+    0x0E, 0x20,       // $C010: LD C,$20
+    0xCD, 0x20, 0xC0, // $C012: CALL $C020
+    0x0D,             // DEC C
+    0x20, 0xFA,       // JR NZ,$C012
+    0xC9,             // RET
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x3E, 0x08,       // $C020: LD A,$08
+    0x3D,             // $C022: DEC A
+    0x20, 0xFD,       // JR NZ,$C022
+    0xC9,             // RET
+};
+
+// f calls g, which drops both return addresses and calls h from main's
+// level; h returns normally, then RST $38 runs into an infinite loop
+static const uint8_t unwind_program[] = {
+    0x31, 0xFE, 0xDF, // $C000: LD SP,$DFFE
+    0xCD, 0x10, 0xC0, // CALL $C010
+    0x18, 0xFE,       // $C006: JR $C006
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xCD, 0x20, 0xC0, // $C010: CALL $C020
+    0xC9,             // RET
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xE1,             // $C020: POP HL
+    0xE1,             // POP HL
+    0xCD, 0x30, 0xC0, // CALL $C030
+    0xFF,             // RST $38
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xC9,             // $C030: RET
+};
+
+static GBCPU *load_program(const uint8_t *program, size_t size) {
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    memcpy(&cpu->memory[0xC000], program, size);
+    cpu->memory[0x0038] = 0x18; // $0038: JR $0038
+    cpu->memory[0x0039] = 0xFE;
+    cpu->reg.PC = 0xC000;
+    return cpu;
+}
+
+static void run(GBCPU *cpu, bool blocks) {
+    if (blocks) {
+        block_cache_attach(cpu);
+    }
+    while (!cpu->crashed) {
+        if (blocks) {
+            block_run(cpu);
+        } else {
+            cpu_clock(cpu, false, false);
+        }
+        callstack_poll(cpu);
+    }
+}
+
+// the folded output, and the sum of its counts
+static char *folded(const CallStack *stack, uint64_t *total) {
+    static char text[0x1000];
+    FILE *out = tmpfile();
+    callstack_write_folded(stack, out);
+    rewind(out);
+    size_t length = fread(text, 1, sizeof(text) - 1, out);
+    text[length] = '\0';
+    fclose(out);
+
+    *total = 0;
+    for (char *line = text; *line; line = strchr(line, '\n') + 1) {
+        *total += strtoull(strchr(line, ' ') + 1, NULL, 10);
+    }
+    return text;
+}
+
+static uint64_t count_of(const char *text, const char *stack) {
+    char line[64];
+    snprintf(line, sizeof(line), "%s ", stack);
+    for (const char *found = strstr(text, line); found; found = strstr(found + 1, line)) {
+        if (found == text || found[-1] == '\n') {
+            return strtoull(found + strlen(line), NULL, 10);
+        }
+    }
+    return 0;
+}
+
+void test_callstack_nested() {
+    for (int blocks = 0; blocks < 2; ++blocks) {
+        GBCPU *cpu = load_program(nested_program, sizeof(nested_program));
+        callstack_attach(cpu, 16);
+        run(cpu, blocks);
+        TEST_CHECK(cpu->calls->depth == 0);
+
+        // every interval up to the end is counted once, most of them in inner
+        uint64_t total;
+        char *text = folded(cpu->calls, &total);
+        TEST_CHECK(total == cpu->cycles / 16);
+        TEST_MSG("%llu samples in %zu cycles", (unsigned long long)total, cpu->cycles);
+        uint64_t main = count_of(text, "00:C000");
+        uint64_t outer = count_of(text, "00:C000;00:C010");
+        uint64_t inner = count_of(text, "00:C000;00:C010;00:C020");
+        TEST_CHECK(main + outer + inner == total);
+        TEST_CHECK(inner > outer && outer > main);
+        TEST_MSG("%s", text);
+        TEST_CHECK(cpu->calls->node_count == 3);
+
+        callstack_detach(cpu);
+        block_cache_detach(cpu);
+        free(cpu);
+    }
+}
+
+void test_callstack_unwind() {
+    GBCPU *cpu = load_program(unwind_program, sizeof(unwind_program));
+    callstack_attach(cpu, 1);
+    run(cpu, false);
+
+    // h is a child of main, not of g, and RST is a call
+    uint64_t total;
+    char *text = folded(cpu->calls, &total);
+    TEST_CHECK(count_of(text, "00:C000;00:C010;00:C020") > 0);
+    TEST_CHECK(count_of(text, "00:C000;00:C030") > 0);
+    TEST_CHECK(strstr(text, "00:C020;00:C030") == NULL);
+    TEST_CHECK(count_of(text, "00:C000;00:0038") > 0);
+    TEST_MSG("%s", text);
+    TEST_CHECK(cpu->calls->depth == 1);
+
+    callstack_detach(cpu);
+    free(cpu);
+}
+
+void test_callstack_symbols() {
+    const char *file = "test_callstack.sym";
+    FILE *sym = fopen(file, "w");
+    fprintf(sym, "; comment\n00:C020 inner\n00:C010 outer\n\n00:C000 main\n01:4000 banked\n");
+    fclose(sym);
+
+    GBCPU *cpu = load_program(nested_program, sizeof(nested_program));
+    callstack_attach(cpu, 0);
+    TEST_CHECK(cpu->calls->interval == CALLSTACK_INTERVAL);
+    TEST_ASSERT(callstack_load_symbols(cpu->calls, file));
+    TEST_CHECK(cpu->calls->symbol_count == 4);
+    run(cpu, false);
+
+    uint64_t total;
+    char *text = folded(cpu->calls, &total);
+    TEST_CHECK(count_of(text, "main;outer;inner") > 0);
+    TEST_MSG("%s", text);
+    TEST_CHECK(callstack_bank(0x3FFF) == 0 && callstack_bank(0x4000) == 1 && callstack_bank(0xC000) == 0);
+
+    TEST_CHECK(!callstack_load_symbols(cpu->calls, "missing.sym"));
+    callstack_detach(cpu);
+    free(cpu);
+    remove(file);
+}
+
+void test_callstack_rom() {
+    // the same samples through the block cache as through cpu_clock
+    GBCPU *cpus[2];
+    for (int blocks = 0; blocks < 2; ++blocks) {
+        GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+        cpu_initialize(cpu);
+        cpu_reset(cpu);
+        read_binary("../tests/roms/07-jr,jp,call,ret,rst.gb", cpu->memory);
+        cpu->memory[0xFF44] = 0x90; // LY
+        callstack_attach(cpu, 0);
+        run(cpu, blocks);
+        cpus[blocks] = cpu;
+    }
+    uint64_t totals[2];
+    folded(cpus[0]->calls, &totals[0]);
+    folded(cpus[1]->calls, &totals[1]);
+    TEST_CHECK(totals[0] == totals[1] && totals[0] == cpus[0]->cycles / CALLSTACK_INTERVAL);
+    TEST_CHECK(cpus[0]->calls->node_count == cpus[1]->calls->node_count);
+    TEST_CHECK(cpus[0]->calls->node_count > 10);
+    TEST_MSG("%u stacks", cpus[0]->calls->node_count);
+    for (int i = 0; i < 2; ++i) {
+        callstack_detach(cpus[i]);
+        block_cache_detach(cpus[i]);
+        free(cpus[i]);
+    }
+}
+
+TEST_LIST = {
+    {"Callstack nested", test_callstack_nested},
+    {"Callstack unwind", test_callstack_unwind},
+    {"Callstack symbols", test_callstack_symbols},
+    {"Callstack ROM", test_callstack_rom},
+    {NULL, NULL}};
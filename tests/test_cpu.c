@@ -71,23 +71,23 @@ void test_cpu_registers() {
     TEST_MSG("%d != %d", reg.A, 0xAA);
     TEST_MSG("%d != %d", reg.F, 0x55);
 
-    TEST_CHECK(reg.flags.areg == 0xAA);
-    TEST_CHECK(reg.flags.z == 0);
-    TEST_CHECK(reg.flags.n == 1);
-    TEST_CHECK(reg.flags.h == 0);
-    TEST_CHECK(reg.flags.c == 1);
+    TEST_CHECK(reg.A == 0xAA);
+    TEST_CHECK(get_flag(&reg, FLAG_Z) == 0);
+    TEST_CHECK(get_flag(&reg, FLAG_N) == 1);
+    TEST_CHECK(get_flag(&reg, FLAG_H) == 0);
+    TEST_CHECK(get_flag(&reg, FLAG_C) == 1);
 
     reg.F = 0xF0;
-    TEST_CHECK(reg.flags.z == 1);
-    TEST_CHECK(reg.flags.n == 1);
-    TEST_CHECK(reg.flags.h == 1);
-    TEST_CHECK(reg.flags.c == 1);
+    TEST_CHECK(get_flag(&reg, FLAG_Z) == 1);
+    TEST_CHECK(get_flag(&reg, FLAG_N) == 1);
+    TEST_CHECK(get_flag(&reg, FLAG_H) == 1);
+    TEST_CHECK(get_flag(&reg, FLAG_C) == 1);
 
     reg.F = 0xAA;
-    TEST_CHECK(reg.flags.z == 1);
-    TEST_CHECK(reg.flags.n == 0);
-    TEST_CHECK(reg.flags.h == 1);
-    TEST_CHECK(reg.flags.c == 0);
+    TEST_CHECK(get_flag(&reg, FLAG_Z) == 1);
+    TEST_CHECK(get_flag(&reg, FLAG_N) == 0);
+    TEST_CHECK(get_flag(&reg, FLAG_H) == 1);
+    TEST_CHECK(get_flag(&reg, FLAG_C) == 0);
 
     reg.BC = 0x6699;
     TEST_CHECK(reg.B == 0x66);
@@ -127,9 +127,36 @@ void test_reset() {
     TEST_CHECK(cpu.reg.PC == 0x0100);
 }
 
+void test_history() {
+    static char expected[1000][HISTORY_LINE_SIZE];
+    GBCPU cpu;
+    cpu_initialize(&cpu);
+    cpu_reset(&cpu);
+    read_binary("../tests/roms/06-ld r,r.gb", cpu.memory);
+    cpu.memory[0xFF44] = 0x90; // LY
+
+    char line[HISTORY_LINE_SIZE];
+    TEST_CHECK(!cpu_history_line(&cpu, 0, line));
+    for (size_t i = 0; i < 1000; ++i) {
+        cpu_clock(&cpu, false, true);
+        strcpy(expected[i], cpu.disassembly);
+    }
+
+    // the same text as disassembling while running, for the last entries only
+    for (size_t i = 1000 - HISTORY_SIZE; i < 1000; ++i) {
+        TEST_CHECK(cpu_history_line(&cpu, i, line));
+        TEST_CHECK(strcmp(line, expected[i]) == 0);
+        TEST_MSG("expected %s", expected[i]);
+        TEST_MSG("found    %s", line);
+    }
+    TEST_CHECK(!cpu_history_line(&cpu, 1000 - HISTORY_SIZE - 1, line));
+    TEST_CHECK(!cpu_history_line(&cpu, 1000, line));
+}
+
 TEST_LIST = {
     {"Blargg CPU binary", test_blargg_binary},
     {"CPU Registers", test_cpu_registers},
     {"CPU Reset", test_reset},
+    {"CPU History", test_history},
     {NULL, NULL} /* zeroed record marking the end of the list */
 };
@@ -0,0 +1,80 @@
+#include "acutest.h"
+#include "disasm.h"
+#include "gbcpu.h"
+
+static void check(uint16_t addr, uint8_t b0, uint8_t b1, uint8_t b2, const char *text, uint8_t length) {
+    const uint8_t bytes[] = {b0, b1, b2};
+    char out[GB_DISASM_SIZE];
+    TEST_CHECK(gb_disasm(bytes, addr, out) == length);
+    TEST_CHECK(strcmp(out, text) == 0);
+    TEST_MSG("$%04X %02X %02X %02X: expected \"%s\", found \"%s\"", addr, b0, b1, b2, text, out);
+}
+
+void test_disasm_operands() {
+    check(0x0100, 0x00, 0x00, 0x00, "NOP", 1);
+    check(0x0101, 0xC3, 0x13, 0x02, "JP $0213", 3);
+    check(0x0213, 0x21, 0x00, 0x40, "LD HL, $4000", 3);
+    check(0x0000, 0x3E, 0xE4, 0x00, "LD A, $E4", 2);
+    check(0x0000, 0xE0, 0x47, 0x00, "LDH ($FF00+$47), A", 2);
+    check(0x0000, 0xF0, 0x44, 0x00, "LDH A, ($FF00+$44)", 2);
+    check(0x0000, 0xE2, 0x00, 0x00, "LD ($FF00+C), A", 1);
+    check(0x0000, 0x08, 0x34, 0x12, "LD ($1234), SP", 3);
+    check(0x0000, 0xFA, 0x1D, 0xD8, "LD A, ($D81D)", 3);
+    check(0x0000, 0xE9, 0x00, 0x00, "JP HL", 1);
+    check(0x0000, 0xFF, 0x00, 0x00, "RST 38H", 1);
+    check(0x0000, 0x10, 0x00, 0x00, "STOP $00", 2);
+}
+
+void test_disasm_relative() {
+    // JR targets are relative to the next instruction, also across $0000
+    check(0x0209, 0x20, 0xFB, 0x00, "JRNZ $0206", 2);
+    check(0xC005, 0x18, 0x7F, 0x00, "JR $C086", 2);
+    check(0x0000, 0x18, 0xFD, 0x00, "JR $FFFF", 2);
+    check(0x0000, 0xE8, 0xFB, 0x00, "ADD SP, -$05", 2);
+    check(0x0000, 0xF8, 0x80, 0x00, "LDHL SP, -$80", 2);
+    check(0x0000, 0xF8, 0x7F, 0x00, "LDHL SP, +$7F", 2);
+}
+
+void test_disasm_prefixed() {
+    check(0x0000, 0xCB, 0x37, 0x00, "SWAP A", 2);
+    check(0x0000, 0xCB, 0x7E, 0x00, "BIT 7, (HL)", 2);
+    check(0x0000, 0xCB, 0x80, 0x00, "RES 0, B", 2);
+}
+
+void test_disasm_undefined() {
+    check(0x0000, 0xD3, 0x00, 0x00, "DB $D3", 1);
+    check(0x0000, 0xFD, 0x00, 0x00, "DB $FD", 1);
+}
+
+void test_disasm_lengths() {
+    // every defined opcode reports the length of its table entry
+    char out[GB_DISASM_SIZE];
+    for (int opcode = 0; opcode < 0x100; ++opcode) {
+        uint8_t bytes[] = {opcode, 0x00, 0x00};
+        uint8_t length = opcode == 0xCB ? 2 : opcodes[opcode].instruction ? opcodes[opcode].length : 1;
+        TEST_CHECK(gb_disasm(bytes, 0, out) == length);
+        TEST_MSG("%02X %s", opcode, out);
+        TEST_CHECK(strlen(out) < GB_DISASM_SIZE);
+    }
+}
+
+void test_disasm_numbers() {
+    char out[24];
+    *disasm_decimal(out, 42, 8) = '\0';
+    TEST_CHECK(strcmp(out, "      42") == 0);
+    *disasm_decimal(out, 0, 3) = '\0';
+    TEST_CHECK(strcmp(out, "  0") == 0);
+    *disasm_decimal(out, 1234567890123ull, 8) = '\0';
+    TEST_CHECK(strcmp(out, "1234567890123") == 0);
+    *disasm_hex16(disasm_hex8(out, 0x0F), 0xA05B) = '\0';
+    TEST_CHECK(strcmp(out, "0FA05B") == 0);
+}
+
+TEST_LIST = {
+    {"Disasm operands", test_disasm_operands},
+    {"Disasm relative", test_disasm_relative},
+    {"Disasm prefixed", test_disasm_prefixed},
+    {"Disasm undefined", test_disasm_undefined},
+    {"Disasm lengths", test_disasm_lengths},
+    {"Disasm numbers", test_disasm_numbers},
+    {NULL, NULL}};
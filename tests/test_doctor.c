@@ -0,0 +1,137 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "doctor.h"
+#include "gbcpu.h"
+#include "tools.h"
+
+#define LOGGED 20000
+
+static GBCPU *load_cpu(void) {
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    read_binary("../tests/roms/06-ld r,r.gb", cpu->memory);
+    cpu->memory[0xFF44] = 0x90; // LY
+    return cpu;
+}
+
+// Writes what print_flags produces for the first instructions, with line
+// changed to text when it is not 0.
+static void write_log(const char *file, const char *eol, size_t line, const char *text) {
+    GBCPU *cpu = load_cpu();
+    FILE *out = fopen(file, "wb");
+    for (size_t i = 1; i <= LOGGED; ++i) {
+        cpu_clock(cpu, true, false);
+        fprintf(out, "%s%s", i == line ? text : cpu->debug, eol);
+    }
+    fclose(out);
+    free(cpu);
+}
+
+// Runs the ROM against the log, returns the first result that is not a
+// match and the instruction it happened at.
+static DoctorResult run_against(DoctorLog *log, size_t *instruction, HistoryEntry *entry) {
+    GBCPU *cpu = load_cpu();
+    DoctorResult result = DOCTOR_MATCH;
+    while (result == DOCTOR_MATCH) {
+        *instruction = cpu->instruction_count;
+        cpu_clock(cpu, false, false);
+        *entry = cpu->history[*instruction & (HISTORY_SIZE - 1)];
+        result = doctor_compare(log, entry);
+    }
+    free(cpu);
+    return result;
+}
+
+void test_doctor_match() {
+    const char *eols[] = {"\n", "\r\n"};
+    for (size_t i = 0; i < 2; ++i) {
+        const char *file = "test_doctor.txt";
+        write_log(file, eols[i], 0, NULL);
+        DoctorLog *log = doctor_open(file);
+        TEST_ASSERT(log != NULL);
+
+        size_t instruction;
+        HistoryEntry entry;
+        TEST_CHECK(run_against(log, &instruction, &entry) == DOCTOR_END);
+        TEST_CHECK(instruction == LOGGED);
+        TEST_CHECK(log->line == LOGGED + 1);
+
+        doctor_close(log);
+        remove(file);
+    }
+}
+
+void test_doctor_divergence() {
+    const char *file = "test_doctor_divergence.txt";
+    const char *changed = "A: 01 F: B0 B: 00 C: 13 D: 00 E: D8 H: 01 L: 4D SP: FFFE PC: 00:0100 (00 C3 13 02)";
+    write_log(file, "\n", 5000, changed);
+    DoctorLog *log = doctor_open(file);
+    TEST_ASSERT(log != NULL);
+
+    size_t instruction;
+    HistoryEntry entry;
+    TEST_CHECK(run_against(log, &instruction, &entry) == DOCTOR_MISMATCH);
+    TEST_CHECK(instruction == 4999);
+    TEST_CHECK(log->line == 5000);
+
+    // the report names the line and marks where it differs
+    char text[400];
+    FILE *report = tmpfile();
+    doctor_report(log, &entry, report);
+    rewind(report);
+    TEST_CHECK(fgets(text, sizeof(text), report) && strcmp(text, "Line 5000\n") == 0);
+    TEST_CHECK(fgets(text, sizeof(text), report) && strncmp(text + 10, changed, strlen(changed)) == 0);
+    TEST_CHECK(fgets(text, sizeof(text), report) && strncmp(text, "Found   : A: ", 13) == 0);
+    TEST_CHECK(fgets(text, sizeof(text), report) && strchr(text, '^') != NULL);
+    fclose(report);
+
+    doctor_close(log);
+    remove(file);
+}
+
+void test_doctor_malformed() {
+    const char *file = "test_doctor_malformed.txt";
+    const char *lines[] = {
+        "A: 01 F: B0 B: 00 C: 13 D: 00 E: D8 H: 01 L: 4D SP: FFFE PC: 00:0100 (00 C3 13 0G)",
+        "A: 01 F: B0 B: 00 C: 13 D: 00 E: D8 H: 01 L: 4D SP: FFFE PC: 00:0100 (00 C3 13 02",
+        "A: 01 F: B0 B: 00 C: 13 D: 00 E: D8 H: 01 L: 4D SP: FFFE PC: 01:0100 (00 C3 13 02)",
+        "",
+    };
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); ++i) {
+        write_log(file, "\n", 10, lines[i]);
+        DoctorLog *log = doctor_open(file);
+        TEST_ASSERT(log != NULL);
+
+        size_t instruction;
+        HistoryEntry entry;
+        TEST_CHECK(run_against(log, &instruction, &entry) == DOCTOR_MALFORMED);
+        TEST_CHECK(instruction == 9);
+        TEST_MSG("line \"%s\"", lines[i]);
+
+        doctor_close(log);
+        remove(file);
+    }
+}
+
+void test_doctor_empty() {
+    const char *file = "test_doctor_empty.txt";
+    fclose(fopen(file, "w"));
+    DoctorLog *log = doctor_open(file);
+    TEST_ASSERT(log != NULL);
+    size_t instruction;
+    HistoryEntry entry;
+    TEST_CHECK(run_against(log, &instruction, &entry) == DOCTOR_END);
+    TEST_CHECK(instruction == 0);
+    doctor_close(log);
+    remove(file);
+    TEST_CHECK(doctor_open("missing.txt") == NULL);
+}
+
+TEST_LIST = {
+    {"Doctor match", test_doctor_match},
+    {"Doctor divergence", test_doctor_divergence},
+    {"Doctor malformed", test_doctor_malformed},
+    {"Doctor empty", test_doctor_empty},
+    {NULL, NULL}};
@@ -0,0 +1,76 @@
+#include "acutest.h"
+#include "gbenv.h"
+
+void test_env_lifecycle() {
+    TEST_CHECK(gb_env_api_version() == GB_ENV_API_VERSION);
+    TEST_CHECK(gb_env_create("../tests/roms/missing.gb") == NULL);
+
+    GBEnv *env = gb_env_create("../tests/roms/06-ld r,r.gb");
+    TEST_CHECK(env != NULL);
+
+    const GBEnvObservation *observation = gb_env_observe(env);
+    TEST_CHECK(observation->frame == 0);
+    TEST_CHECK(observation->vram == observation->memory + 0x8000);
+    TEST_CHECK(observation->oam == observation->memory + 0xFE00);
+
+    gb_env_destroy(env);
+}
+
+void test_env_step_blargg() {
+    GBEnv *env = gb_env_create("../tests/roms/06-ld r,r.gb");
+    TEST_CHECK(gb_env_observe_range(env, 0xC000, 0x2000));
+    TEST_CHECK(gb_env_observe_range(env, 0xFF80, 0x7F));
+    TEST_CHECK(!gb_env_observe_range(env, 0xFFFF, 0x02));
+
+    const GBEnvObservation *observation = gb_env_observe(env);
+    TEST_CHECK(observation->range_count == 2);
+    TEST_CHECK(observation->ranges[0].ptr == observation->memory + 0xC000);
+
+    size_t frames = 0;
+    while (frames < 200 && !strstr(observation->serial, "Passed")) {
+        frames += gb_env_step(env, GB_ENV_BUTTON_NONE, 1);
+    }
+
+    TEST_CHECK(strstr(observation->serial, "Passed") != NULL);
+    TEST_MSG("serial: %s", observation->serial);
+    TEST_CHECK(observation->frame == frames);
+    TEST_CHECK(observation->cycles >= frames * GB_ENV_FRAME_CYCLES);
+
+    // the finished line is consumed by the next step
+    gb_env_step(env, GB_ENV_BUTTON_NONE, 1);
+    TEST_CHECK(strstr(observation->serial, "Passed") == NULL);
+    TEST_MSG("serial: %s", observation->serial);
+
+    // the ranges alias instance memory, the test wrote to WRAM without a re-observe
+    bool written = false;
+    for (size_t i = 0; i < observation->ranges[0].length; ++i) {
+        written = written || observation->ranges[0].ptr[i] != 0x00;
+    }
+    TEST_CHECK(written);
+
+    gb_env_destroy(env);
+}
+
+void test_env_frame_skip() {
+    GBEnv *env = gb_env_create("../tests/roms/06-ld r,r.gb");
+    gb_env_set_frame_skip(env, 3);
+
+    TEST_CHECK(gb_env_step(env, GB_ENV_BUTTON_A | GB_ENV_BUTTON_START, 2) == 2);
+
+    const GBEnvObservation *observation = gb_env_observe(env);
+    TEST_CHECK(observation->frame == 8);
+    TEST_CHECK(observation->cycles >= 8 * GB_ENV_FRAME_CYCLES);
+    TEST_CHECK(observation->cycles < 9 * GB_ENV_FRAME_CYCLES);
+
+    gb_env_reset(env);
+    TEST_CHECK(observation->frame == 0);
+    TEST_CHECK(observation->cycles == 0);
+
+    gb_env_destroy(env);
+}
+
+TEST_LIST = {
+    {"Env lifecycle", test_env_lifecycle},
+    {"Env step Blargg", test_env_step_blargg},
+    {"Env frame skip", test_env_frame_skip},
+    {NULL, NULL}};
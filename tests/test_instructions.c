@@ -1,6 +1,7 @@
 #include <stdlib.h>
 
 #include "acutest.h"
+#include "alu_tables.h"
 #include "gbcpu.h"
 #include "tools.h"
 
@@ -88,21 +89,21 @@ void test_add() {
     uint8_t res = add(&cpu, 0xFF, 0x01, false);
 
     TEST_CHECK(res == 0x00);
-    TEST_CHECK(cpu.reg.flags.c == 1);
-    TEST_CHECK(cpu.reg.flags.h == 1);
+    TEST_CHECK(get_flag(&cpu.reg, FLAG_C) == 1);
+    TEST_CHECK(get_flag(&cpu.reg, FLAG_H) == 1);
 
-    res = add(&cpu, 0x7F, 0x00, cpu.reg.flags.c);
+    res = add(&cpu, 0x7F, 0x00, get_flag(&cpu.reg, FLAG_C));
 
     TEST_CHECK(res == 0x80);
-    TEST_CHECK(cpu.reg.flags.c == 0);
-    TEST_CHECK(cpu.reg.flags.h == 1);
+    TEST_CHECK(get_flag(&cpu.reg, FLAG_C) == 0);
+    TEST_CHECK(get_flag(&cpu.reg, FLAG_H) == 1);
 
     // switch order on last operation
     res = add(&cpu, 0x00, 0x7F, 1);
 
     TEST_CHECK(res == 0x80);
-    TEST_CHECK(cpu.reg.flags.c == 0);
-    TEST_CHECK(cpu.reg.flags.h == 1);
+    TEST_CHECK(get_flag(&cpu.reg, FLAG_C) == 0);
+    TEST_CHECK(get_flag(&cpu.reg, FLAG_H) == 1);
 }
 
 void test_add_sp_r8() {
@@ -118,8 +119,8 @@ void test_add_sp_r8() {
     TEST_CHECK(cpu.reg.SP == 0xFFFF);
     TEST_MSG("Expected 0x%04X found 0x%04X", 0xFFFF, cpu.reg.SP);
 
-    TEST_CHECK(cpu.reg.flags.c == 0);
-    TEST_CHECK(cpu.reg.flags.h == 0);
+    TEST_CHECK(get_flag(&cpu.reg, FLAG_C) == 0);
+    TEST_CHECK(get_flag(&cpu.reg, FLAG_H) == 0);
 }
 
 void test_print_flags() {
@@ -142,10 +143,395 @@ void test_print_flags() {
     TEST_MSG("%s != %s", expected, cpu.debug);
 }
 
+static uint8_t expected_flags(uint8_t opcode, uint8_t a, uint8_t b, uint8_t f) {
+    // reference flags for ADD/ADC/SUB/SBC/CP A,B and INC/DEC A
+    uint8_t carry = (opcode == 0x88 || opcode == 0x98) ? (f >> 4) & 0x01 : 0;
+    uint8_t low = f & 0x0F;
+    uint8_t result;
+    switch (opcode) {
+    case 0x80:
+    case 0x88:
+        result = a + b + carry;
+        return low | (result == 0) << 7 | ((a & 0x0F) + (b & 0x0F) + carry > 0x0F) << 5 | (a + b + carry > 0xFF) << 4;
+    case 0x3C:
+        result = a + 1;
+        return (f & 0x1F) | (result == 0) << 7 | ((result & 0x0F) == 0x00) << 5;
+    case 0x3D:
+        result = a - 1;
+        return (f & 0x1F) | (result == 0) << 7 | 0x40 | ((result & 0x0F) == 0x0F) << 5;
+    default:
+        result = a - b - carry;
+        return low | (result == 0) << 7 | 0x40 | ((a & 0x0F) < (b & 0x0F) + carry) << 5 | (a < b + carry) << 4;
+    }
+}
+
+void test_lazy_flags() {
+    uint8_t opcodes[] = {0x80, 0x88, 0x90, 0x98, 0xB8, 0x3C, 0x3D};
+    GBCPU cpu;
+    cpu_initialize(&cpu);
+    cpu_reset(&cpu);
+
+    for (size_t op = 0; op < sizeof(opcodes); ++op) {
+        for (uint32_t i = 0; i < 0x20000; ++i) {
+            uint8_t a = i & 0xFF;
+            uint8_t b = (i >> 8) & 0xFF;
+            uint8_t f = (i & 0x10000) ? 0x10 : 0xE0;
+            cpu.memory[0x0100] = opcodes[op];
+            cpu.reg.PC = 0x0100;
+            cpu.reg.A = a;
+            cpu.reg.B = b;
+            cpu.reg.F = f;
+
+            cpu_clock(&cpu, false, false);
+            cpu_flags_sync(&cpu);
+            uint8_t expected = expected_flags(opcodes[op], a, b, f);
+            if (!TEST_CHECK(cpu.reg.F == expected)) {
+                TEST_MSG("opcode %02X A=%02X B=%02X F=%02X: F=%02X expected %02X", opcodes[op], a, b, f, cpu.reg.F, expected);
+                return;
+            }
+        }
+    }
+}
+
+void test_lazy_flags_inc_dec_carry() {
+    // INC and DEC record the c of the pending operation instead of syncing F
+    uint8_t opcodes[] = {0x80, 0x88, 0x90, 0x98, 0xB8, 0x3C};
+    GBCPU cpu;
+    cpu_initialize(&cpu);
+    cpu_reset(&cpu);
+
+    for (size_t op = 0; op < sizeof(opcodes); ++op) {
+        for (uint32_t i = 0; i < 0x20000; ++i) {
+            uint8_t a = i & 0xFF;
+            uint8_t b = (i >> 8) & 0xFF;
+            uint8_t f = (i & 0x10000) ? 0x10 : 0xE0;
+            cpu.memory[0x0100] = opcodes[op];
+            cpu.memory[0x0101] = 0x0C; // INC C
+            cpu.memory[0x0102] = 0x15; // DEC D
+            cpu.reg.PC = 0x0100;
+            cpu.reg.A = a;
+            cpu.reg.B = b;
+            cpu.reg.F = f;
+            cpu.lazy.op = LAZY_NONE;
+
+            for (int n = 0; n < 3; ++n) {
+                cpu_clock(&cpu, false, false);
+            }
+            uint8_t carry = cpu_flag_carry(&cpu);
+            cpu_flags_sync(&cpu);
+            uint8_t expected = expected_flags(opcodes[op], a, b, f) & FLAG_C;
+            if (!TEST_CHECK((cpu.reg.F & FLAG_C) == expected && carry == (expected != 0))) {
+                TEST_MSG("opcode %02X A=%02X B=%02X F=%02X: F=%02X", opcodes[op], a, b, f, cpu.reg.F);
+                return;
+            }
+        }
+    }
+}
+
+void test_lazy_flags_push_pop() {
+    GBCPU cpu;
+    cpu_initialize(&cpu);
+    cpu_reset(&cpu);
+
+    uint8_t program[] = {
+        0x90, // SUB B
+        0xF5, // PUSH AF
+        0x04, // INC B
+        0xF1, // POP AF, replaces the pending INC
+        0x3C, // INC A, keeps the popped carry
+    };
+    memcpy(&cpu.memory[0x0100], program, sizeof(program));
+    cpu.reg.A = 0x10;
+    cpu.reg.B = 0x20;
+
+    for (size_t i = 0; i < sizeof(program); ++i) {
+        cpu_clock(&cpu, false, false);
+    }
+    TEST_CHECK(cpu.memory[0xFFFC] == 0x50);
+    TEST_MSG("pushed F=%02X", cpu.memory[0xFFFC]);
+    cpu_flags_sync(&cpu);
+    TEST_CHECK(cpu.reg.A == 0xF1);
+    TEST_CHECK(cpu.reg.F == 0x10);
+    TEST_MSG("AF=%04X", cpu.reg.AF);
+}
+
+// The flag logic the ALU handlers had before alu_tables.h, kept as the
+// reference the generated tables are checked against. Each returns F << 8 | result.
+
+static uint16_t reference_add(uint8_t a, uint8_t b, bool carry) {
+    cpu_registers reg = {0};
+    uint16_t result = a + b + carry;
+    set_flag(&reg, FLAG_Z, (result & 0xFF) == 0);
+    set_flag(&reg, FLAG_N, 0);
+    set_flag(&reg, FLAG_H, (((a & 0xF) + (b & 0xF) + carry) & 0x10) == 0x10);
+    set_flag(&reg, FLAG_C, result > 0xFF);
+    return reg.F << 8 | (result & 0xFF);
+}
+
+static uint16_t reference_sbc(uint8_t a, uint8_t b, bool carry) {
+    cpu_registers reg = {0};
+    set_flag(&reg, FLAG_C, carry);
+    uint16_t result = a + ~(b - 1) - get_flag(&reg, FLAG_C);
+    set_flag(&reg, FLAG_Z, (result & 0xFF) == 0);
+    set_flag(&reg, FLAG_N, 1);
+    set_flag(&reg, FLAG_H, (a & 0x0f) < ((b & 0x0f) + get_flag(&reg, FLAG_C)));
+    set_flag(&reg, FLAG_C, a < (b + get_flag(&reg, FLAG_C)));
+    return reg.F << 8 | (result & 0xFF);
+}
+
+static uint16_t reference_dec(uint8_t val) {
+    cpu_registers reg = {0};
+    val--;
+    set_flag(&reg, FLAG_Z, val == 0);
+    set_flag(&reg, FLAG_N, 1);
+    set_flag(&reg, FLAG_H, ((val + 1) & 0x0f) < (val & 0x0f));
+    return reg.F << 8 | val;
+}
+
+static uint16_t reference_daa(uint8_t value, uint8_t f) {
+    cpu_registers reg = {0};
+    reg.F = f;
+    uint16_t a = value;
+    bool carry = false;
+
+    if (get_flag(&reg, FLAG_H)) {
+        if (get_flag(&reg, FLAG_N)) {
+            a += 0x0A;
+        } else {
+            a += 0x06;
+        }
+    } else if (!get_flag(&reg, FLAG_N) && ((a & 0x0F) > 0x09)) {
+        a += 0x06;
+    }
+
+    if (get_flag(&reg, FLAG_C)) {
+        if (get_flag(&reg, FLAG_N) && get_flag(&reg, FLAG_H)) {
+            a += 0x90;
+        } else if (get_flag(&reg, FLAG_N)) {
+            a += 0xA0;
+        } else {
+            a += 0x60;
+        }
+        carry = true;
+    } else if (get_flag(&reg, FLAG_N) && get_flag(&reg, FLAG_H)) {
+        a += 0xF0;
+    } else if (get_flag(&reg, FLAG_N)) {
+        a += 0x00;
+    } else if ((a & 0xFFF0) > 0x90) {
+        a += 0x60;
+        carry = true;
+    }
+
+    set_flag(&reg, FLAG_Z, (a & 0x00FF) == 0);
+    set_flag(&reg, FLAG_H, 0);
+    set_flag(&reg, FLAG_C, carry);
+    return reg.F << 8 | (a & 0xFF);
+}
+
+static uint16_t reference_shift(uint8_t op, uint8_t value, bool carry) {
+    cpu_registers reg = {0};
+    set_flag(&reg, FLAG_C, carry);
+    switch (op) {
+    case ALU_RLC:
+        set_flag(&reg, FLAG_C, (value & 0x80) == 0x80);
+        value = (value << 1) | get_flag(&reg, FLAG_C);
+        break;
+    case ALU_RRC:
+        set_flag(&reg, FLAG_C, value & 0x01);
+        value = (get_flag(&reg, FLAG_C) << 7) | value >> 1;
+        break;
+    case ALU_RL:
+        set_flag(&reg, FLAG_C, (value & 0x80) == 0x80);
+        value = (value << 1) | carry;
+        break;
+    case ALU_RR:
+        set_flag(&reg, FLAG_C, value & 0x01);
+        value = (carry << 7) | value >> 1;
+        break;
+    case ALU_SLA:
+        set_flag(&reg, FLAG_C, (value & 0x80) == 0x80);
+        value = value << 1;
+        break;
+    case ALU_SRA:
+        set_flag(&reg, FLAG_C, value & 0x01);
+        value = (value & 0x80) | (value >> 1);
+        break;
+    case ALU_SWAP:
+        value = ((value & 0x0F) << 4 | (value & 0xF0) >> 4);
+        set_flag(&reg, FLAG_C, 0);
+        break;
+    case ALU_SRL:
+        set_flag(&reg, FLAG_C, value & 0x01);
+        value = value >> 1;
+        break;
+    }
+    set_flag(&reg, FLAG_Z, value == 0);
+    return reg.F << 8 | value;
+}
+
+void test_alu_tables() {
+    for (uint8_t carry = 0; carry < 2; ++carry) {
+        for (uint32_t pair = 0; pair < 0x10000; ++pair) {
+            uint8_t a = pair >> 8;
+            uint8_t b = pair & 0xFF;
+            if (!TEST_CHECK(alu_add[carry][pair] == reference_add(a, b, carry))) {
+                TEST_MSG("ADD %02X+%02X+%d: %04X expected %04X", a, b, carry, alu_add[carry][pair], reference_add(a, b, carry));
+                return;
+            }
+            if (!TEST_CHECK(alu_sub[carry][pair] == reference_sbc(a, b, carry))) {
+                TEST_MSG("SUB %02X-%02X-%d: %04X expected %04X", a, b, carry, alu_sub[carry][pair], reference_sbc(a, b, carry));
+                return;
+            }
+        }
+    }
+
+    for (uint16_t value = 0; value < 0x100; ++value) {
+        // the old INC went through add() and restored c afterwards
+        TEST_CHECK(alu_inc[value] == (reference_add(value, 1, false) & 0xEFFF));
+        TEST_MSG("INC %02X: %04X", value, alu_inc[value]);
+        TEST_CHECK(alu_dec[value] == reference_dec(value));
+        TEST_MSG("DEC %02X: %04X", value, alu_dec[value]);
+
+        for (uint8_t nhc = 0; nhc < 8; ++nhc) {
+            uint16_t expected = reference_daa(value, nhc << 4);
+            if (!TEST_CHECK(alu_daa[nhc][value] == expected)) {
+                TEST_MSG("DAA A=%02X F=%02X: %04X expected %04X", value, nhc << 4, alu_daa[nhc][value], expected);
+                return;
+            }
+        }
+
+        for (uint8_t op = ALU_RLC; op <= ALU_SRL; ++op) {
+            for (uint8_t carry = 0; carry < 2; ++carry) {
+                uint16_t expected = reference_shift(op, value, carry);
+                if (!TEST_CHECK(alu_shift[op][carry][value] == expected)) {
+                    TEST_MSG("shift %d value %02X carry %d: %04X expected %04X", op, value, carry, alu_shift[op][carry][value], expected);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+void test_alu_table_handlers() {
+    // DAA, the CB rotates and shifts on B and the accumulator rotates, run
+    // through cpu_clock for every input
+    GBCPU cpu;
+    cpu_initialize(&cpu);
+    cpu_reset(&cpu);
+
+    for (uint16_t value = 0; value < 0x100; ++value) {
+        for (uint8_t nhc = 0; nhc < 8; ++nhc) {
+            uint8_t f = nhc << 4 | 0x0A;
+            cpu.memory[0x0100] = 0x27; // DAA
+            cpu.reg.PC = 0x0100;
+            cpu.reg.A = value;
+            cpu.reg.F = f;
+            cpu_clock(&cpu, false, false);
+            uint16_t expected = reference_daa(value, nhc << 4) | 0x0A00;
+            TEST_CHECK(cpu.reg.AF == (uint16_t)(expected << 8 | expected >> 8));
+            TEST_MSG("DAA A=%02X F=%02X: AF=%04X", value, f, cpu.reg.AF);
+        }
+
+        for (uint8_t op = ALU_RLC; op <= ALU_SRL; ++op) {
+            for (uint8_t carry = 0; carry < 2; ++carry) {
+                cpu.memory[0x0100] = 0xCB;
+                cpu.memory[0x0101] = op << 3; // op B
+                cpu.reg.PC = 0x0100;
+                cpu.reg.B = value;
+                cpu.reg.F = carry << 4;
+                cpu_clock(&cpu, false, false);
+                uint16_t expected = reference_shift(op, value, carry);
+                TEST_CHECK(cpu.reg.B == (expected & 0xFF) && cpu.reg.F == expected >> 8);
+                TEST_MSG("CB %02X B=%02X carry %d: B=%02X F=%02X", op << 3, value, carry, cpu.reg.B, cpu.reg.F);
+
+                if (op > ALU_RR) {
+                    continue;
+                }
+                cpu.memory[0x0100] = 0x07 | op << 3; // RLCA, RRCA, RLA, RRA
+                cpu.reg.PC = 0x0100;
+                cpu.reg.A = value;
+                cpu.reg.F = carry << 4;
+                cpu_clock(&cpu, false, false);
+                TEST_CHECK(cpu.reg.A == (expected & 0xFF) && cpu.reg.F == ((expected >> 8) & 0x10));
+                TEST_MSG("%02X A=%02X carry %d: A=%02X F=%02X", 0x07 | op << 3, value, carry, cpu.reg.A, cpu.reg.F);
+            }
+        }
+    }
+}
+
+static uint8_t *cb_operand(GBCPU *cpu, uint8_t opcode) {
+    uint8_t *operands[] = {&cpu->reg.B, &cpu->reg.C, &cpu->reg.D, &cpu->reg.E,
+                           &cpu->reg.H, &cpu->reg.L, &cpu->memory[cpu->reg.HL], &cpu->reg.A};
+    return operands[opcode & 0x07];
+}
+
+void test_prefix_opcodes() {
+    // every CB opcode against a decode-at-runtime reference, so each
+    // generated handler has to hit the right bit and the right operand
+    GBCPU cpu;
+    GBCPU expected;
+    cpu_initialize(&cpu);
+    cpu_reset(&cpu);
+    srand(1234);
+
+    for (uint16_t opcode = 0; opcode < 0x100; ++opcode) {
+        for (int run = 0; run < 64; ++run) {
+            cpu.reg.PC = 0x0100;
+            cpu.memory[0x0100] = 0xCB;
+            cpu.memory[0x0101] = opcode;
+            cpu.reg.AF = rand() & 0xFFF0;
+            cpu.reg.BC = rand();
+            cpu.reg.DE = rand();
+            cpu.reg.HL = 0xC000 | (rand() & 0x0FFF);
+            cpu.memory[cpu.reg.HL] = rand();
+            memcpy(&expected, &cpu, sizeof(GBCPU));
+
+            uint8_t *value = cb_operand(&expected, opcode);
+            uint8_t n = (opcode >> 3) & 0x07;
+            switch (opcode >> 6) {
+            case 0: {
+                uint16_t result = reference_shift(n, *value, get_flag(&expected.reg, FLAG_C));
+                *value = result & 0xFF;
+                expected.reg.F = result >> 8;
+                break;
+            }
+            case 1:
+                set_flag(&expected.reg, FLAG_Z, (*value & (1 << n)) == 0);
+                set_flag(&expected.reg, FLAG_N, 0);
+                set_flag(&expected.reg, FLAG_H, 1);
+                break;
+            case 2:
+                *value &= ~(1 << n);
+                break;
+            case 3:
+                *value |= 1 << n;
+                break;
+            }
+
+            cpu_clock(&cpu, false, false);
+            bool same = cpu.reg.AF == expected.reg.AF && cpu.reg.BC == expected.reg.BC &&
+                        cpu.reg.DE == expected.reg.DE && cpu.reg.HL == expected.reg.HL &&
+                        cpu.reg.PC == 0x0102 && cpu.memory[cpu.reg.HL] == expected.memory[expected.reg.HL];
+            if (!TEST_CHECK(same)) {
+                TEST_MSG("CB %02X: AF=%04X BC=%04X DE=%04X (HL)=%02X expected AF=%04X BC=%04X DE=%04X (HL)=%02X",
+                         opcode, cpu.reg.AF, cpu.reg.BC, cpu.reg.DE, cpu.memory[cpu.reg.HL],
+                         expected.reg.AF, expected.reg.BC, expected.reg.DE, expected.memory[expected.reg.HL]);
+                return;
+            }
+        }
+    }
+}
+
 TEST_LIST = {
     {"INC 16 and DEC 16", test_inc_16_and_dec_16},
     {"ADD Add with carry", test_add},
     {"ADD SP,r8", test_add_sp_r8},
     {"Print Flags", test_print_flags},
+    {"Lazy flags", test_lazy_flags},
+    {"Lazy flags: INC/DEC keep a pending carry", test_lazy_flags_inc_dec_carry},
+    {"Lazy flags through PUSH/POP AF", test_lazy_flags_push_pop},
+    {"ALU tables", test_alu_tables},
+    {"ALU table handlers", test_alu_table_handlers},
+    {"CB prefix opcodes", test_prefix_opcodes},
     {NULL, NULL} /* zeroed record marking the end of the list */
 };
@@ -0,0 +1,150 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "engines.h"
+#include "fixtures.h"
+#include "gbcpu.h"
+#include "jit.h"
+
+// Runs the recompiler against cpu_clock, comparing the state after every
+// block.
+static void run_differential(const char *rom, bool passes) {
+    GBCPU *reference = load_rom_cpu(rom);
+    GBCPU *jit = copy_cpu(reference);
+    Engine engine = ENGINE_JIT;
+    engine_attach(jit, engine);
+    check_differential(reference, jit, engine_run, &engine, rom, passes);
+
+    JitArena *arena = jit_arena(jit);
+    TEST_CHECK(arena->native_runs > 0);
+    TEST_MSG("%s compiled %zu, native runs %zu of %zu", rom, arena->compiled, arena->native_runs, jit->blocks->executed);
+
+    engine_detach(jit);
+    free(jit);
+    free(reference);
+}
+
+void test_jit_blargg() {
+    // 02-interrupts does not pass with cpu_clock either, it only has to match
+    run_differential("../tests/roms/01-special.gb", true);
+    run_differential("../tests/roms/02-interrupts.gb", false);
+    run_differential("../tests/roms/03-op sp,hl.gb", true);
+    run_differential("../tests/roms/04-op r,imm.gb", true);
+    run_differential("../tests/roms/05-op rp.gb", true);
+    run_differential("../tests/roms/06-ld r,r.gb", true);
+    run_differential("../tests/roms/07-jr,jp,call,ret,rst.gb", true);
+    run_differential("../tests/roms/08-misc instrs.gb", true);
+    run_differential("../tests/roms/09-op r,r.gb", true);
+    run_differential("../tests/roms/10-bit ops.gb", true);
+    run_differential("../tests/roms/11-op a,(hl).gb", true);
+}
+
+void test_jit_alu_loop() {
+    // every translated operation in a hot loop, including dead and live
+    // flags and (HL) reads both in WRAM and on the I/O page
+    uint8_t program[] = {
+        0x80,       // ADD A,B
+        0xA1,       // AND C
+        0x8A,       // ADC A,D
+        0x93,       // SUB E
+        0x9C,       // SBC A,H
+        0xB5,       // OR L
+        0xAF,       // XOR A
+        0xC6, 0x5A, // ADD A,n
+        0xCE, 0xA5, // ADC A,n
+        0x96,       // SUB (HL)
+        0xDE, 0x0F, // SBC A,n
+        0xE6, 0xF7, // AND n
+        0xFE, 0x42, // CP n
+        0x86,       // ADD A,(HL)
+        0xEE, 0x3C, // XOR n
+        0xF6, 0x81, // OR n
+        0x0C,       // INC C
+        0x15,       // DEC D
+        0x2F,       // CPL
+        0x37,       // SCF
+        0x3F,       // CCF
+        0x4F,       // LD C,A
+        0x7E,       // LD A,(HL)
+        0x2C,       // INC L
+        0x26, 0xFF, // LD H,$FF
+        0x7E,       // LD A,(HL)
+        0x26, 0xC1, // LD H,$C1
+        0x05,       // DEC B
+        0xC2, 0x00, 0xC0, // JP NZ,$C000
+        0x18, 0xFE, // JR -2
+    };
+
+    srand(4321);
+    for (int run = 0; run < 16; ++run) {
+        GBCPU *jit = new_cpu();
+        memcpy(&jit->memory[0xC000], program, sizeof(program));
+        for (size_t i = 0; i < 0x100; ++i) {
+            jit->memory[0xC100 + i] = rand();
+        }
+        jit->reg.PC = 0xC000;
+        jit->reg.AF = rand() & 0xFFFF;
+        jit->reg.BC = 0x4000 | (rand() & 0xFF);
+        jit->reg.DE = rand() & 0xFFFF;
+        jit->reg.HL = 0xC100 | (rand() & 0xFF);
+        GBCPU *reference = copy_cpu(jit);
+        Engine engine = ENGINE_JIT;
+        engine_attach(jit, engine);
+
+        Verifier verifier;
+        verify_attach(&verifier, reference, jit, engine_run, &engine);
+        if (!TEST_CHECK(verify_run(&verifier, 0))) {
+            TEST_MSG("run %d", run);
+            verify_report(&verifier, stderr);
+        }
+        verify_detach(&verifier);
+        TEST_CHECK(jit_arena(jit)->compiled > 0);
+
+        engine_detach(jit);
+        free(jit);
+        free(reference);
+    }
+}
+
+void test_jit_self_modifying() {
+    // a hot loop that patches the immediate of its own LD A,n
+    uint8_t program[] = {
+        0x3E, 0x01,       // $FF80 LD A,1
+        0x80,             // $FF82 ADD A,B
+        0xEA, 0x81, 0xFF, // $FF83 LD ($FF81),A
+        0x05,             // $FF86 DEC B
+        0x20, 0xF7,       // $FF87 JR NZ,-9
+        0x18, 0xFE,       // $FF89 JR -2
+    };
+
+    GBCPU *jit = new_cpu();
+    memcpy(&jit->memory[0xFF80], program, sizeof(program));
+    jit->reg.PC = 0xFF80;
+    jit->reg.B = 0x80;
+    jit->reg.SP = 0xDFFF;
+    GBCPU *reference = copy_cpu(jit);
+    jit_attach(jit);
+
+    while (!jit->crashed) {
+        jit_run(jit);
+    }
+    while (!reference->crashed) {
+        cpu_clock(reference, false, false);
+    }
+
+    TEST_CHECK(verify_same_state(jit, reference));
+    TEST_CHECK(jit->reg.A == reference->reg.A);
+    TEST_MSG("A=%02X expected %02X", jit->reg.A, reference->reg.A);
+    TEST_CHECK(jit->blocks->invalidated == 0x80);
+    TEST_MSG("invalidated %zu", jit->blocks->invalidated);
+
+    jit_detach(jit);
+    free(jit);
+    free(reference);
+}
+
+TEST_LIST = {
+    {"JIT Blargg", test_jit_blargg},
+    {"JIT ALU loop", test_jit_alu_loop},
+    {"JIT self-modifying code", test_jit_self_modifying},
+    {NULL, NULL}};
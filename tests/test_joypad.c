@@ -0,0 +1,43 @@
+#include "acutest.h"
+#include "gbcpu.h"
+#include "joypad.h"
+
+void test_joypad_parse() {
+    TEST_CHECK(joypad_parse("") == 0x00);
+    TEST_CHECK(joypad_parse("A") == JOYPAD_A);
+    TEST_CHECK(joypad_parse("A+START") == (JOYPAD_A | JOYPAD_START));
+    TEST_CHECK(joypad_parse("RIGHT+B+SELECT") == (JOYPAD_RIGHT | JOYPAD_B | JOYPAD_SELECT));
+    TEST_CHECK(joypad_parse("BOGUS") == 0x00);
+}
+
+void test_joypad_select() {
+    GBCPU cpu;
+    cpu_initialize(&cpu);
+    cpu_reset(&cpu);
+
+    cpu.memory[0x0100] = 0xE0; // LDH ($FF00+n),A
+    cpu.memory[0x0101] = 0x00;
+    cpu.memory[0x0102] = 0xE0;
+    cpu.memory[0x0103] = 0x00;
+
+    joypad_set(&cpu, JOYPAD_A | JOYPAD_LEFT);
+
+    cpu.reg.A = 0x20; // select directions
+    cpu_clock(&cpu, false, false);
+    TEST_CHECK(cpu.memory[0xFF00] == 0xED);
+    TEST_MSG("P1=0x%02X != 0x%02X", cpu.memory[0xFF00], 0xED);
+
+    cpu.reg.A = 0x10; // select action buttons
+    cpu_clock(&cpu, false, false);
+    TEST_CHECK(cpu.memory[0xFF00] == 0xDE);
+    TEST_MSG("P1=0x%02X != 0x%02X", cpu.memory[0xFF00], 0xDE);
+
+    joypad_set(&cpu, 0x00);
+    TEST_CHECK(cpu.memory[0xFF00] == 0xDF);
+    TEST_MSG("P1=0x%02X != 0x%02X", cpu.memory[0xFF00], 0xDF);
+}
+
+TEST_LIST = {
+    {"Joypad Parse", test_joypad_parse},
+    {"Joypad Select", test_joypad_select},
+    {NULL, NULL}};
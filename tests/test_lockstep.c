@@ -0,0 +1,156 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "fixtures.h"
+#include "gbcpu.h"
+#include "lockstep.h"
+
+static bool check_lanes(Lockstep *lockstep, GBCPU **reference, size_t step) {
+    lockstep_sync(lockstep);
+    for (size_t i = 0; i < lockstep->lanes; ++i) {
+        GBCPU *lane = lockstep->cpus[i];
+        if (!TEST_CHECK(verify_same_state(lane, reference[i]))) {
+            TEST_MSG("step %zu lane %zu opcode 0x%02X", step, i, reference[i]->opcode);
+            TEST_MSG("lane      AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X PC=%04X",
+                     lane->reg.AF, lane->reg.BC, lane->reg.DE, lane->reg.HL, lane->reg.SP, lane->reg.PC);
+            TEST_MSG("reference AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X PC=%04X",
+                     reference[i]->reg.AF, reference[i]->reg.BC, reference[i]->reg.DE,
+                     reference[i]->reg.HL, reference[i]->reg.SP, reference[i]->reg.PC);
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_lockstep_decode() {
+    TEST_CHECK(lockstep_vectorizable(0x00));  // NOP
+    TEST_CHECK(lockstep_vectorizable(0x41));  // LD B,C
+    TEST_CHECK(lockstep_vectorizable(0x3E));  // LD A,n
+    TEST_CHECK(lockstep_vectorizable(0x80));  // ADD A,B
+    TEST_CHECK(lockstep_vectorizable(0xFE));  // CP n
+    TEST_CHECK(lockstep_vectorizable(0x3D));  // DEC A
+    TEST_CHECK(!lockstep_vectorizable(0x46)); // LD B,(HL)
+    TEST_CHECK(!lockstep_vectorizable(0x34)); // INC (HL)
+    TEST_CHECK(!lockstep_vectorizable(0x20)); // JR NZ
+    TEST_CHECK(!lockstep_vectorizable(0xCB)); // prefix
+}
+
+void test_lockstep_divergent_lanes() {
+    // ALU block followed by a DEC B loop whose trip count differs per lane
+    uint8_t program[] = {
+        0x04,       // INC B
+        0x80,       // ADD A,B
+        0x05,       // DEC B
+        0x20, 0xFD, // JR NZ,-3
+        0x88,       // ADC A,B
+        0x91,       // SUB C
+        0x9A,       // SBC A,D
+        0xA3,       // AND E
+        0xAC,       // XOR H
+        0xB5,       // OR L
+        0xBF,       // CP A
+        0x3C,       // INC A
+        0x0D,       // DEC C
+        0x2F,       // CPL
+        0x37,       // SCF
+        0x3F,       // CCF
+        0x47,       // LD B,A
+        0xC6, 0x37, // ADD A,n
+        0xCE, 0x11, // ADC A,n
+        0xD6, 0x05, // SUB n
+        0xDE, 0x80, // SBC A,n
+        0xE6, 0xF3, // AND n
+        0xEE, 0x0F, // XOR n
+        0xF6, 0x01, // OR n
+        0xFE, 0x42, // CP n
+        0x54,       // LD D,H
+        0x18, 0xDB, // JR -37
+    };
+
+    GBCPU *lanes[LOCKSTEP_LANES];
+    GBCPU *reference[LOCKSTEP_LANES];
+    srand(1234);
+
+    for (size_t i = 0; i < LOCKSTEP_LANES; ++i) {
+        lanes[i] = new_cpu();
+        memcpy(&lanes[i]->memory[0xC000], program, sizeof(program));
+        lanes[i]->reg.PC = 0xC000;
+        lanes[i]->reg.AF = rand() & 0xFFF0;
+        lanes[i]->reg.BC = rand() & 0xFFFF;
+        lanes[i]->reg.DE = rand() & 0xFFFF;
+        lanes[i]->reg.HL = rand() & 0xFFFF;
+        reference[i] = copy_cpu(lanes[i]);
+    }
+
+    Lockstep *lockstep = aligned_alloc(64, sizeof(Lockstep));
+    lockstep_initialize(lockstep, lanes, LOCKSTEP_LANES);
+
+    // each reference runs as many instructions as its lane did
+    size_t diverged_at = 0;
+    size_t vector_steps = 0; // before the lanes came apart
+    for (size_t step = 0; step < 20000; ++step) {
+        lockstep_step(lockstep);
+        for (size_t i = 0; i < LOCKSTEP_LANES; ++i) {
+            while (reference[i]->instruction_count < lanes[i]->instruction_count) {
+                cpu_clock(reference[i], false, false);
+            }
+            if (diverged_at == 0 && lockstep->pc[i] != lockstep->pc[0]) {
+                diverged_at = step;
+                vector_steps = lockstep->vector_steps;
+            }
+        }
+        if (!check_lanes(lockstep, reference, step)) {
+            break;
+        }
+    }
+
+    // the lanes come apart in the DEC B loop and run the ALU block after it
+    // together again, 25 vector steps in every pass
+    TEST_CHECK(diverged_at > 0);
+    TEST_CHECK(lockstep->vector_steps - vector_steps >= 25 * 20);
+    TEST_MSG("diverged at step %zu, vector steps %zu, scalar steps %zu", diverged_at, lockstep->vector_steps,
+             lockstep->scalar_steps);
+
+    for (size_t i = 0; i < LOCKSTEP_LANES; ++i) {
+        free(lanes[i]);
+        free(reference[i]);
+    }
+    free(lockstep);
+}
+
+void test_lockstep_blargg_op_r_r() {
+    GBCPU *lanes[LOCKSTEP_LANES];
+    GBCPU *reference = load_rom_cpu("../tests/roms/09-op r,r.gb");
+    GBCPU *references[LOCKSTEP_LANES];
+
+    for (size_t i = 0; i < LOCKSTEP_LANES; ++i) {
+        lanes[i] = copy_cpu(reference);
+        references[i] = reference;
+    }
+
+    Lockstep *lockstep = aligned_alloc(64, sizeof(Lockstep));
+    lockstep_initialize(lockstep, lanes, LOCKSTEP_LANES);
+
+    for (size_t step = 0; step < 300000 && !reference->crashed; ++step) {
+        lockstep_step(lockstep);
+        cpu_clock(reference, false, false);
+        if (!check_lanes(lockstep, references, step)) {
+            break;
+        }
+    }
+
+    TEST_CHECK(lockstep->vector_steps > 0);
+    TEST_MSG("vector steps %zu, scalar steps %zu", lockstep->vector_steps, lockstep->scalar_steps);
+
+    for (size_t i = 0; i < LOCKSTEP_LANES; ++i) {
+        free(lanes[i]);
+    }
+    free(reference);
+    free(lockstep);
+}
+
+TEST_LIST = {
+    {"Lockstep decode", test_lockstep_decode},
+    {"Lockstep divergent lanes", test_lockstep_divergent_lanes},
+    {"Lockstep Blargg op r,r", test_lockstep_blargg_op_r_r},
+    {NULL, NULL}};
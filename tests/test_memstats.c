@@ -0,0 +1,149 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "blocks.h"
+#include "gbcpu.h"
+#include "memstats.h"
+#include "tools.h"
+
+static const uint8_t program[] = {
+    0x31, 0xFE, 0xDF, // $0100: LD SP,$DFFE
+    0x21, 0x00, 0x80, // LD HL,$8000
+    0x3E, 0x42,       // LD A,$42
+    0x22,             // LDI (HL),A
+    0x22,             // LDI (HL),A
+    0xF0, 0x44,       // $010A: LDH A,($44)
+    0xE0, 0x80,       // LDH ($80),A
+    0xC5,             // PUSH BC
+    0xD1,             // POP DE
+    0x08, 0x00, 0xC1, // LD ($C100),SP
+    0x18, 0xFE,       // $0113: JR $0113
+};
+
+static GBCPU *run_program(MemStats *stats, bool blocks) {
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    memcpy(&cpu->memory[0x0100], program, sizeof(program));
+    cpu->reg.PC = 0x0100;
+    cpu->stats = stats;
+    if (blocks) {
+        block_cache_attach(cpu);
+    }
+    while (!cpu->crashed) {
+        if (blocks) {
+            block_run(cpu);
+        } else {
+            cpu_clock(cpu, false, false);
+        }
+    }
+    block_cache_detach(cpu);
+    return cpu;
+}
+
+void test_memstats_accesses() {
+    MemStats *stats[2];
+    for (int blocks = 0; blocks < 2; ++blocks) {
+        stats[blocks] = memstats_create();
+        free(run_program(stats[blocks], blocks));
+    }
+    MemStats *s = stats[0];
+
+    TEST_CHECK(s->writes[0x8000] == 1 && s->writes[0x8001] == 1);
+    TEST_CHECK(s->reads[0xFF44] == 1 && s->writes[0xFF44] == 0);
+    TEST_CHECK(s->writes[0xFF80] == 1);
+    TEST_CHECK(s->writes[0xDFFD] == 1 && s->writes[0xDFFC] == 1);
+    TEST_CHECK(s->reads[0xDFFD] == 1 && s->reads[0xDFFC] == 1);
+    TEST_CHECK(s->writes[0xC100] == 1 && s->writes[0xC101] == 1);
+    // immediate operands are reads, opcodes and the LDH offset are not
+    TEST_CHECK(s->reads[0x0101] == 1 && s->reads[0x0102] == 1 && s->reads[0x0107] == 1);
+    TEST_CHECK(s->reads[0x0100] == 0 && s->reads[0x010A] == 0 && s->reads[0x010B] == 0);
+
+    uint64_t reads[REGION_COUNT];
+    uint64_t writes[REGION_COUNT];
+    memstats_regions(s, reads, writes);
+    TEST_CHECK(writes[REGION_VRAM] == 2);
+    TEST_CHECK(reads[REGION_IO] == 1 && writes[REGION_IO] == 0);
+    TEST_CHECK(writes[REGION_HRAM] == 1);
+    TEST_CHECK(reads[REGION_WRAM] == 2 && writes[REGION_WRAM] == 4);
+    TEST_CHECK(writes[REGION_ROM0] == 0);
+
+    // block_step goes through the same accessors
+    TEST_CHECK(memcmp(stats[0], stats[1], sizeof(MemStats)) == 0);
+
+    free(stats[0]);
+    free(stats[1]);
+}
+
+void test_memstats_regions() {
+    struct {
+        uint16_t addr;
+        MemRegion region;
+    } expected[] = {
+        {0x0000, REGION_ROM0},     {0x3FFF, REGION_ROM0}, {0x4000, REGION_ROM1},     {0x8000, REGION_VRAM},
+        {0xA000, REGION_EXTERNAL}, {0xC000, REGION_WRAM}, {0xDFFF, REGION_WRAM},     {0xE000, REGION_ECHO},
+        {0xFE00, REGION_OAM},      {0xFE9F, REGION_OAM},  {0xFEA0, REGION_UNUSABLE}, {0xFF00, REGION_IO},
+        {0xFF7F, REGION_IO},       {0xFF80, REGION_HRAM}, {0xFFFE, REGION_HRAM},     {0xFFFF, REGION_IE},
+    };
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        TEST_CHECK(memstats_region(expected[i].addr) == expected[i].region);
+        TEST_MSG("$%04X", expected[i].addr);
+    }
+    TEST_CHECK(strcmp(memstats_io_name(0xFF44), "LY") == 0);
+    TEST_CHECK(strcmp(memstats_io_name(0xFF0F), "IF") == 0);
+    TEST_CHECK(memstats_io_name(0xFF03) == NULL);
+    TEST_CHECK(memstats_io_name(0xFF80) == NULL);
+}
+
+void test_memstats_export() {
+    MemStats *stats = memstats_create();
+    free(run_program(stats, false));
+
+    // merging adds up every counter
+    MemStats *total = memstats_create();
+    memstats_merge(total, stats);
+    memstats_merge(total, stats);
+    TEST_CHECK(total->writes[0x8000] == 2 && total->reads[0xFF44] == 2);
+
+    const char *file = "test_memstats.csv";
+    TEST_ASSERT(memstats_write_csv(stats, file));
+    FILE *csv = fopen(file, "r");
+    char line[128];
+    size_t lines = 0;
+    bool found = false;
+    while (fgets(line, sizeof(line), csv)) {
+        lines++;
+        found |= strcmp(line, "0xFF44,\"I/O Registers\",LY,1,0\n") == 0;
+    }
+    fclose(csv);
+    remove(file);
+    TEST_CHECK(found);
+
+    size_t accessed = 0;
+    for (size_t addr = 0; addr < 0x10000; ++addr) {
+        accessed += stats->reads[addr] || stats->writes[addr];
+    }
+    TEST_CHECK(lines == accessed + 1);
+    TEST_MSG("%zu lines for %zu addresses", lines, accessed);
+
+    FILE *out = tmpfile();
+    memstats_report(stats, out);
+    rewind(out);
+    char report[0x1000];
+    size_t length = fread(report, 1, sizeof(report) - 1, out);
+    report[length] = '\0';
+    fclose(out);
+    TEST_CHECK(strstr(report, "VRAM") != NULL);
+    TEST_CHECK(strstr(report, "$FF44 LY") != NULL);
+    TEST_CHECK(strstr(report, "External RAM") == NULL);
+    TEST_MSG("%s", report);
+
+    free(total);
+    free(stats);
+}
+
+TEST_LIST = {
+    {"Memstats accesses", test_memstats_accesses},
+    {"Memstats regions", test_memstats_regions},
+    {"Memstats export", test_memstats_export},
+    {NULL, NULL}};
@@ -0,0 +1,123 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "gbcpu.h"
+#include "profile.h"
+
+static uint8_t program[] = {
+    0x06, 0x10, // $C000 LD B,$10
+    0xCB, 0x37, // $C002 SWAP A
+    0x05,       // $C004 DEC B
+    0x20, 0xFB, // $C005 JR NZ,-5
+    0x18, 0xFE, // $C007 JR -2
+};
+
+static GBCPU *run_program(Profile *profile) {
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    memcpy(&cpu->memory[0xC000], program, sizeof(program));
+    cpu->reg.PC = 0xC000;
+    cpu->profile = profile;
+    while (!cpu->crashed) {
+        cpu_clock(cpu, false, false);
+    }
+    return cpu;
+}
+
+void test_profile_counts() {
+    Profile *profile = profile_create(1);
+    GBCPU *cpu = run_program(profile);
+
+    struct {
+        bool prefixed;
+        uint8_t opcode;
+        uint64_t count;
+    } expected[] = {
+        {false, 0x06, 1}, {true, 0x37, 0x10}, {false, 0x05, 0x10}, {false, 0x20, 0x10}, {false, 0x18, 1},
+    };
+    uint64_t total = 0;
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        ProfileEntry *entry = &profile->ops[expected[i].prefixed][expected[i].opcode];
+        const OpInstr *instr = expected[i].prefixed ? &prefix_opcodes[expected[i].opcode] : &opcodes[expected[i].opcode];
+        TEST_CHECK(entry->count == expected[i].count);
+        TEST_MSG("%02X ran %llu times", expected[i].opcode, (unsigned long long)entry->count);
+        TEST_CHECK(entry->cycles == expected[i].count * instr->cycles);
+        TEST_CHECK(entry->samples == entry->count);
+        total += entry->count;
+    }
+    TEST_CHECK(total == cpu->instruction_count);
+    // the same byte in the other table was never run
+    TEST_CHECK(profile->ops[false][0x37].count == 0);
+
+    free(cpu);
+    free(profile);
+}
+
+void test_profile_sampling() {
+    Profile *profile = profile_create(4);
+    GBCPU *cpu = run_program(profile);
+
+    uint64_t count = 0;
+    uint64_t samples = 0;
+    for (size_t table = 0; table < 2; ++table) {
+        for (size_t opcode = 0; opcode < 0x100; ++opcode) {
+            count += profile->ops[table][opcode].count;
+            samples += profile->ops[table][opcode].samples;
+        }
+    }
+    TEST_CHECK(count == cpu->instruction_count);
+    TEST_CHECK(samples == count / 4);
+    TEST_MSG("%llu samples of %llu", (unsigned long long)samples, (unsigned long long)count);
+
+    // merging adds up every counter
+    Profile *total = profile_create(4);
+    profile_merge(total, profile);
+    profile_merge(total, profile);
+    TEST_CHECK(total->ops[true][0x37].count == 2 * 0x10);
+    TEST_CHECK(total->ops[false][0x20].samples == 2 * profile->ops[false][0x20].samples);
+
+    free(cpu);
+    free(profile);
+    free(total);
+}
+
+void test_profile_output() {
+    Profile *profile = profile_create(1);
+    GBCPU *cpu = run_program(profile);
+    char line[200];
+
+    FILE *report = tmpfile();
+    profile_report(profile, report, 0);
+    rewind(report);
+    bool swap = false;
+    while (fgets(line, sizeof(line), report)) {
+        swap = swap || (strncmp(line, "CB37", 4) == 0 && strstr(line, "SWAP A") != NULL);
+    }
+    TEST_CHECK(swap);
+    fclose(report);
+
+    const char *file = "test_profile.csv";
+    TEST_CHECK(profile_write_csv(profile, file));
+    FILE *csv = fopen(file, "r");
+    TEST_ASSERT(csv != NULL);
+    size_t rows = 0;
+    TEST_CHECK(fgets(line, sizeof(line), csv) != NULL);
+    TEST_CHECK(strcmp(line, "table,opcode,mnemonic,count,cycles,samples,ticks,ticks_per_run\n") == 0);
+    while (fgets(line, sizeof(line), csv)) {
+        rows++;
+    }
+    TEST_CHECK(rows == 5);
+    TEST_MSG("%zu rows", rows);
+    fclose(csv);
+    remove(file);
+
+    free(cpu);
+    free(profile);
+}
+
+TEST_LIST = {
+    {"Profile counts", test_profile_counts},
+    {"Profile sampling", test_profile_sampling},
+    {"Profile output", test_profile_output},
+    {NULL, NULL}};
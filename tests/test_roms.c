@@ -2,72 +2,45 @@
 
 #include "acutest.h"
 #include "cartridge.h"
+#include "doctor.h"
 #include "gbcpu.h"
 #include "tools.h"
 
-bool run_cpu(GBCPU *cpu, FILE *log, size_t last_instruction) {
-    char line[256];
-    // uint8_t mem_val_d = cpu->memory[0xFF0F];
-    // uint8_t mem_val_e = cpu->memory[0xDF7E];
-    // uint8_t mem_val_c = cpu->memory[0xDF7C];
-
+bool run_cpu(GBCPU *cpu, DoctorLog *log, size_t last_instruction) {
     while (!cpu->crashed && cpu->instruction_count <= last_instruction) {
+        size_t instruction = cpu->instruction_count;
         cpu_clock(cpu, false, false);
 
-        // if (mem_val_d != cpu->memory[0xFF0F]) {
-        // printf("%s $FF0F=0x%02X\n", &cpu->disassembly[0], mem_val_d);
-        // mem_val_d = cpu->memory[0xFF0F];
-        // }
-
-        // mem_val_d = cpu->memory[0xDF7D];
-        //     mem_val_e = cpu->memory[0xDF7E];
-        //     mem_val_c = cpu->memory[0xDF7C];
-        // printf("%s $DF7D=0x%02X $DF7E=0x%02X $DF7C=0x%02X\n", &cpu->disassembly[0], mem_val_d, mem_val_e, mem_val_c);
-        // printf("%s $0104=0x%02X\n", &cpu->disassembly[0], mem_val_d);
-        // }
+        if (log && cpu->instruction_count != instruction) {
+            const HistoryEntry *entry = &cpu->history[instruction & (HISTORY_SIZE - 1)];
+            DoctorResult result = doctor_compare(log, entry);
+            if (result == DOCTOR_END) {
+                log = NULL;
+            } else if (result != DOCTOR_MATCH) {
+                TEST_CHECK(false);
+                TEST_MSG("%s after %zu instructions", result == DOCTOR_MALFORMED ? "malformed log line" : "divergence",
+                         instruction);
+                doctor_report(log, entry, stdout);
+                return false;
+            }
+        }
 
         if (!cpu->crashed) {
             if (serial_buffer_eol(&cpu->buffer)) {
                 printf("%s", &cpu->buffer.buffer[0]);
-
-                // if (strcmp("Passed\n", &cpu->buffer.buffer[0]) == 0) {
-                //     printf("Test completed after %zu instructions\n", cpu->instruction_count);
-                //     serial_buffer_clear(&cpu->buffer);
-                //     return true;
-                // }
-
                 serial_buffer_clear(&cpu->buffer);
             }
-            if (log && !fgets(line, sizeof(line), log)) {
-                // bool success = TEST_CHECK(false);
-                // TEST_MSG("Log is empty!");
-                // if (!success)
-                // return false;
-            }
-
-            // line[strcspn(line, "\n")] = '\0';  // strip newline
-            // bool success = TEST_CHECK(strcmp(line, cpu->debug) == 0);
-            // TEST_MSG("%8zu opcode=0x%02X", cpu->instruction_count - 1, cpu->opcode);
-            // TEST_MSG("\033[0;32mExpected: %s\033[0m", line);
-            // TEST_MSG("\033[0;31mFound   : %s\033[0m", cpu->debug);
-            // if (!success)
-            //     return false;
         }
     }
     return true;
 }
 
-void run_disassembly(GBCPU *cpu, size_t last_line) {
-    size_t first_line = last_line - 10;
-    while (!cpu->crashed && cpu->instruction_count < last_line) {
-        cpu_clock(cpu, false, cpu->instruction_count >= first_line);
-
-        char *color = cpu->instruction_count == last_line ? "\033[0;31m" : "";
-        char *end_color = cpu->instruction_count == last_line ? "\033[0m" : "";
-
-        if (cpu->instruction_count >= first_line) {
-            printf("%s%s%s\n", color, &cpu->disassembly[0], end_color);
-        }
+void print_history(GBCPU *cpu, size_t lines) {
+    char line[HISTORY_LINE_SIZE];
+    size_t first = cpu->instruction_count > lines ? cpu->instruction_count - lines : 0;
+    for (size_t i = first; cpu_history_line(cpu, i, line); ++i) {
+        bool last = i + 1 == cpu->instruction_count;
+        printf("%s%s%s\n", last ? "\033[0;31m" : "", line, last ? "\033[0m" : "");
     }
 }
 
@@ -79,14 +52,18 @@ void run_and_test_rom(char *rom, char *log, size_t last_instruction) {
 
     cpu.memory[0xFF44] = 0x90; // LY
 
-    FILE *file;
-    if (log != NULL) {
-        file = fopen(log, "r");
-    } else {
-        file = NULL;
+    // the reference logs are large and not checked in, compare when present
+    DoctorLog *reference = NULL;
+    FILE *file = log ? fopen(log, "r") : NULL;
+    if (file) {
+        fclose(file);
+        reference = doctor_open(log);
     }
 
-    bool success = run_cpu(&cpu, file, last_instruction);
+    bool success = run_cpu(&cpu, reference, last_instruction);
+    if (reference) {
+        doctor_close(reference);
+    }
     success = !cpu.crashed && success;
 
     if (cpu.buffer.pos > 0) {
@@ -95,11 +72,7 @@ void run_and_test_rom(char *rom, char *log, size_t last_instruction) {
 
     if (!success) {
         // print assembly for some lines before the error
-        size_t instruction_number = cpu.instruction_count;
-        cpu_reset(&cpu);
-        cpu.memory[0xFF44] = 0x90; // LY
-        read_binary(rom, cpu.memory);
-        run_disassembly(&cpu, instruction_number);
+        print_history(&cpu, 10);
     }
 
     TEST_CHECK(success);
@@ -247,6 +220,7 @@ void test_bootstrap_rom() {
     }
 
     TEST_CHECK(!cpu.crashed);
+    cpu_flags_sync(&cpu);
     TEST_CHECK(cpu.reg.AF == 0x01B0);
     TEST_CHECK(cpu.reg.BC == 0x0013);
     TEST_CHECK(cpu.reg.DE == 0x00D8);
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "gbcpu.h"
+#include "tools.h"
+#include "trace.h"
+
+#define TRACED 50000
+
+static GBCPU *load_cpu(char *rom) {
+    GBCPU *cpu = aligned_alloc(GBCPU_CACHE_LINE, sizeof(GBCPU));
+    cpu_initialize(cpu);
+    cpu_reset(cpu);
+    read_binary(rom, cpu->memory);
+    cpu->memory[0xFF44] = 0x90; // LY
+    return cpu;
+}
+
+static void write_trace(const char *file) {
+    GBCPU *cpu = load_cpu("../tests/roms/06-ld r,r.gb");
+    // start part way in, the header records the first instruction
+    for (size_t i = 0; i < 100; ++i) {
+        cpu_clock(cpu, false, false);
+    }
+    TraceWriter *trace = trace_open(file, cpu);
+    TEST_ASSERT(trace != NULL);
+    while (cpu->instruction_count < 100 + TRACED) {
+        cpu_clock(cpu, false, false);
+        // an uneven interval, so copies wrap around the history
+        if (cpu->instruction_count % 37 == 0) {
+            TEST_CHECK(trace_sync(trace, cpu));
+        }
+    }
+    TEST_CHECK(trace_sync(trace, cpu));
+    TEST_CHECK(trace_close(trace));
+    free(cpu);
+}
+
+void test_trace_round_trip() {
+    const char *file = "test_trace.bin";
+    write_trace(file);
+
+    // every entry formats to what cpu_clock disassembled while running
+    TraceReader *reader = trace_reader_open(file);
+    TEST_ASSERT(reader != NULL);
+    TEST_CHECK(reader->header.first == 100);
+    TEST_CHECK(reader->count == TRACED);
+
+    GBCPU *cpu = load_cpu("../tests/roms/06-ld r,r.gb");
+    HistoryEntry entry;
+    uint64_t instruction;
+    char line[HISTORY_LINE_SIZE];
+    size_t mismatches = 0;
+    while (cpu->instruction_count < 100) {
+        cpu_clock(cpu, false, false);
+    }
+    while (trace_next(reader, &entry, &instruction)) {
+        TEST_ASSERT(instruction == cpu->instruction_count);
+        cpu_clock(cpu, true, true);
+        history_format_disassembly(&entry, instruction, line);
+        mismatches += strcmp(line, cpu->disassembly) != 0;
+        history_format_doctor(&entry, line);
+        mismatches += strcmp(line, cpu->debug) != 0;
+    }
+    TEST_CHECK(cpu->instruction_count == 100 + TRACED);
+    TEST_CHECK(mismatches == 0);
+    TEST_MSG("%zu mismatches", mismatches);
+
+    // seeking lands on the same entry as reading up to it
+    TEST_CHECK(trace_seek(reader, 100 + 12345));
+    TEST_CHECK(trace_next(reader, &entry, &instruction));
+    TEST_CHECK(instruction == 100 + 12345);
+    history_format_disassembly(&entry, instruction, line);
+    TEST_CHECK(strncmp(line, "   12445 ", 9) == 0);
+    TEST_CHECK(!trace_seek(reader, 99));
+    TEST_CHECK(!trace_seek(reader, 100 + TRACED));
+
+    trace_reader_close(reader);
+    remove(file);
+    free(cpu);
+}
+
+void test_trace_lost() {
+    const char *file = "test_trace_lost.bin";
+    GBCPU *cpu = load_cpu("../tests/roms/06-ld r,r.gb");
+    TraceWriter *trace = trace_open(file, cpu);
+    TEST_ASSERT(trace != NULL);
+
+    for (size_t i = 0; i < HISTORY_SIZE; ++i) {
+        cpu_clock(cpu, false, false);
+    }
+    TEST_CHECK(trace_sync(trace, cpu));
+    for (size_t i = 0; i <= HISTORY_SIZE; ++i) {
+        cpu_clock(cpu, false, false);
+    }
+    TEST_CHECK(!trace_sync(trace, cpu));
+    TEST_CHECK(!trace_close(trace));
+
+    // the file stops before the gap
+    TraceReader *reader = trace_reader_open(file);
+    TEST_ASSERT(reader != NULL);
+    TEST_CHECK(reader->count == HISTORY_SIZE);
+    trace_reader_close(reader);
+    remove(file);
+    free(cpu);
+}
+
+TEST_LIST = {
+    {"Trace round trip", test_trace_round_trip},
+    {"Trace lost instructions", test_trace_lost},
+    {NULL, NULL}};
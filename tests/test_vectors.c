@@ -0,0 +1,163 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "breakpoints.h"
+#include "engines.h"
+#include "fixtures.h"
+#include "gbcpu.h"
+#include "vectors.h"
+
+#define VECTORS_FILE "../tests/vectors.bin"
+
+static void free_cpu(GBCPU *cpu) {
+    breakpoints_detach(cpu);
+    engine_detach(cpu);
+    free(cpu);
+}
+
+// Attaches the engine and checks every opcode, naming each one that fails
+// with its first failing vector.
+static void check_all(const Vectors *vectors, GBCPU *cpu, Engine engine) {
+    engine_attach(cpu, engine);
+    for (unsigned opcode = 0; opcode < VECTOR_OPCODES; ++opcode) {
+        size_t failed = vectors_check(vectors, cpu, opcode, engine_run_eager, &engine, NULL);
+        if (!TEST_CHECK(failed == 0)) {
+            TEST_MSG("opcode $%03X: %zu of %u vectors differ", opcode, failed, vectors->header->per_opcode);
+            vectors_check(vectors, cpu, opcode, engine_run_eager, &engine, stderr);
+        }
+    }
+}
+
+void test_vectors_file() {
+    Vectors *vectors = vectors_open(VECTORS_FILE);
+    TEST_ASSERT(vectors != NULL);
+    const VectorsHeader *header = vectors->header;
+    TEST_CHECK(header->per_opcode == VECTORS_PER_OPCODE);
+    size_t defined = 0;
+    for (unsigned opcode = 0; opcode < VECTOR_OPCODES; ++opcode) {
+        bool empty = header->offsets[opcode] == header->offsets[opcode + 1];
+        TEST_CHECK(empty != vector_opcode_defined(opcode));
+        TEST_MSG("opcode $%03X", opcode);
+        defined += vector_opcode_defined(opcode);
+    }
+    // all of the CB table and everything but the prefix and the 11 holes and HALT
+    TEST_CHECK(defined == 0x100 + 0x100 - 13);
+    TEST_MSG("%zu opcodes", defined);
+    vectors_close(vectors);
+}
+
+void test_vectors_cpu() {
+    Vectors *vectors = vectors_open(VECTORS_FILE);
+    TEST_ASSERT(vectors != NULL);
+    GBCPU *cpu = new_cpu();
+    check_all(vectors, cpu, ENGINE_CPU);
+    free_cpu(cpu);
+    vectors_close(vectors);
+}
+
+void test_vectors_blocks() {
+    Vectors *vectors = vectors_open(VECTORS_FILE);
+    TEST_ASSERT(vectors != NULL);
+    GBCPU *cpu = new_cpu();
+    check_all(vectors, cpu, ENGINE_BLOCKS);
+    // every vector was a block of one instruction
+    TEST_CHECK(cpu->blocks->executed == cpu->instruction_count);
+    free_cpu(cpu);
+    vectors_close(vectors);
+}
+
+#ifdef GB_JIT
+void test_vectors_jit() {
+    Vectors *vectors = vectors_open(VECTORS_FILE);
+    TEST_ASSERT(vectors != NULL);
+    GBCPU *cpu = new_cpu();
+    check_all(vectors, cpu, ENGINE_JIT);
+    TEST_CHECK(jit_arena(cpu)->native_runs > 0);
+    free_cpu(cpu);
+    vectors_close(vectors);
+}
+#endif
+
+void test_vectors_write() {
+    // a small file written now holds the same results as the one in tests/
+    const char *file = "test_vectors.bin";
+    TEST_ASSERT(vectors_write(file, 12345, 4));
+    Vectors *vectors = vectors_open(file);
+    TEST_ASSERT(vectors != NULL);
+    TEST_CHECK(vectors->header->seed == 12345 && vectors->header->per_opcode == 4);
+    GBCPU *cpu = new_cpu();
+    check_all(vectors, cpu, ENGINE_CPU);
+    free_cpu(cpu);
+    vectors_close(vectors);
+    remove(file);
+}
+
+void test_vector_input() {
+    VectorInput a;
+    VectorInput b;
+    vector_input(1, 0x22, 5, &a); // LDI (HL),A
+    vector_input(1, 0x22, 5, &b);
+    TEST_CHECK(memcmp(&a, &b, sizeof(VectorInput)) == 0);
+    vector_input(1, 0x22, 6, &b);
+    TEST_CHECK(memcmp(&a.reg, &b.reg, sizeof(cpu_registers)) != 0);
+    for (unsigned i = 0; i < 1000; ++i) {
+        vector_input(1, 0x22, i, &a);
+        TEST_CHECK(a.reg.HL >= 0xC000 && a.reg.HL <= 0xDFFF && a.reg.SP >= 0xC002 && a.reg.SP <= 0xDFFE);
+        vector_input(1, 0xE2, i, &a); // LD ($FF00+C),A
+        TEST_CHECK(a.reg.C >= 0x80 && a.reg.C <= 0xFE);
+        vector_input(1, 0x108 + (i & 7), i, &a); // CB prefixed
+        TEST_CHECK(a.addr[a.count - 2] == a.reg.PC && a.value[a.count - 2] == 0xCB);
+    }
+}
+
+// cpu_clock with the result of ADD A,B off by one
+static void run_broken(GBCPU *cpu, void *context) {
+    (void)context;
+    bool add = cpu->memory[cpu->reg.PC] == 0x80;
+    cpu_clock(cpu, false, false);
+    if (add) {
+        cpu->reg.A++;
+    }
+}
+
+static char *report(const Vectors *vectors, GBCPU *cpu, unsigned opcode) {
+    static char text[0x1000];
+    FILE *out = tmpfile();
+    vectors_check(vectors, cpu, opcode, run_broken, NULL, out);
+    rewind(out);
+    size_t length = fread(text, 1, sizeof(text) - 1, out);
+    text[length] = '\0';
+    fclose(out);
+    return text;
+}
+
+void test_vectors_pinpoint() {
+    Vectors *vectors = vectors_open(VECTORS_FILE);
+    TEST_ASSERT(vectors != NULL);
+    GBCPU *cpu = new_cpu();
+    for (unsigned opcode = 0; opcode < VECTOR_OPCODES; ++opcode) {
+        size_t failed = vectors_check(vectors, cpu, opcode, run_broken, NULL, NULL);
+        TEST_CHECK(failed == (opcode == 0x80 ? VECTORS_PER_OPCODE : 0));
+        TEST_MSG("opcode $%03X: %zu", opcode, failed);
+    }
+    char *text = report(vectors, cpu, 0x80);
+    TEST_CHECK(strstr(text, "opcode $80, vector 0 of 64: ADD A, B at $") == text);
+    const char *af = strstr(text, "  AF ");
+    const char *mark = af ? strstr(af, "<--") : NULL;
+    TEST_CHECK(mark && mark < strstr(text, "  BC "));
+    TEST_MSG("%s", text);
+    free_cpu(cpu);
+    vectors_close(vectors);
+}
+
+TEST_LIST = {
+    {"Vectors file", test_vectors_file},
+    {"Vectors cpu_clock", test_vectors_cpu},
+    {"Vectors blocks", test_vectors_blocks},
+#ifdef GB_JIT
+    {"Vectors JIT", test_vectors_jit},
+#endif
+    {"Vectors write", test_vectors_write},
+    {"Vector input", test_vector_input},
+    {"Vectors pinpoint", test_vectors_pinpoint},
+    {NULL, NULL}};
@@ -0,0 +1,184 @@
+#include <stdlib.h>
+
+#include "acutest.h"
+#include "engines.h"
+#include "fixtures.h"
+#include "gbcpu.h"
+#include "verify.h"
+
+static const char *const roms[] = {
+    "../tests/roms/01-special.gb",
+    "../tests/roms/02-interrupts.gb",
+    "../tests/roms/03-op sp,hl.gb",
+    "../tests/roms/04-op r,imm.gb",
+    "../tests/roms/05-op rp.gb",
+    "../tests/roms/06-ld r,r.gb",
+    "../tests/roms/07-jr,jp,call,ret,rst.gb",
+    "../tests/roms/08-misc instrs.gb",
+    "../tests/roms/09-op r,r.gb",
+    "../tests/roms/10-bit ops.gb",
+    "../tests/roms/11-op a,(hl).gb",
+};
+
+static bool check(Verifier *verifier, bool ok, const char *what) {
+    if (!TEST_CHECK(ok)) {
+        TEST_MSG("%s", what);
+        verify_report(verifier, stderr);
+    }
+    return ok;
+}
+
+static void verify_roms(Engine kind) {
+    size_t fused = 0;
+    for (size_t i = 0; i < sizeof(roms) / sizeof(roms[0]); ++i) {
+        GBCPU *reference = load_rom_cpu(roms[i]);
+        GBCPU *engine = copy_cpu(reference);
+        engine_attach(engine, kind);
+
+        Verifier verifier;
+        verify_attach(&verifier, reference, engine, engine_run, &kind);
+        check(&verifier, verify_run(&verifier, 0), roms[i]);
+        TEST_CHECK(engine->crashed && engine->writes->count > 0);
+        for (size_t f = FUSE_COPY; f < FUSE_COUNT; ++f) {
+            fused += engine->blocks->fused[f];
+        }
+        verify_detach(&verifier);
+
+        engine_detach(engine);
+        free(engine);
+        free(reference);
+    }
+    // the bulk stores are hashed like the stores they replace
+    TEST_CHECK(fused > 0);
+}
+
+static void verify_random(Engine kind) {
+    for (uint64_t seed = 0; seed < 500; ++seed) {
+        GBCPU *reference = new_cpu();
+        verify_random_program(reference, seed, 0xC000, 0x200);
+        GBCPU *engine = copy_cpu(reference);
+        engine_attach(engine, kind);
+
+        Verifier verifier;
+        verify_attach(&verifier, reference, engine, engine_run, &kind);
+        bool ok = check(&verifier, verify_run(&verifier, 100000), "random program");
+        TEST_MSG("seed %llu", (unsigned long long)seed);
+        ok = ok && TEST_CHECK(engine->crashed && engine->reg.PC == 0xC1FE);
+        verify_detach(&verifier);
+
+        engine_detach(engine);
+        free(engine);
+        free(reference);
+        if (!ok) {
+            break;
+        }
+    }
+}
+
+void test_verify_blocks() {
+    verify_roms(ENGINE_BLOCKS);
+    verify_random(ENGINE_BLOCKS);
+}
+
+#ifdef GB_JIT
+void test_verify_jit() {
+    verify_roms(ENGINE_JIT);
+    verify_random(ENGINE_JIT);
+}
+#endif
+
+void test_verify_random_program() {
+    GBCPU *a = new_cpu();
+    GBCPU *b = new_cpu();
+    verify_random_program(a, 7, 0xC000, 0x100);
+    verify_random_program(b, 7, 0xC000, 0x100);
+    TEST_CHECK(memcmp(a->memory, b->memory, 0x10000) == 0 && a->reg.AF == b->reg.AF && a->reg.HL == b->reg.HL);
+    verify_random_program(b, 8, 0xC000, 0x100);
+    TEST_CHECK(memcmp(&a->memory[0xC000], &b->memory[0xC000], 0x100) != 0);
+    // nothing past the program and the final JR -2
+    TEST_CHECK(a->memory[0xC0FE] == 0x18 && a->memory[0xC0FF] == 0xFE && a->memory[0xC100] == 0x00);
+    free(a);
+    free(b);
+
+    // HL and SP only move by steps of one or two, so they stay in WRAM
+    for (uint64_t seed = 0; seed < 1000; ++seed) {
+        GBCPU *cpu = new_cpu();
+        verify_random_program(cpu, seed, 0xC000, 0x400);
+        while (!cpu->crashed && cpu->reg.HL >= 0xC000 && cpu->reg.HL <= 0xDFFF && cpu->reg.SP >= 0xC000 &&
+               cpu->reg.SP <= 0xDFFF) {
+            cpu_clock(cpu, false, false);
+        }
+        bool ok = TEST_CHECK(cpu->crashed && cpu->reg.PC == 0xC3FE);
+        TEST_MSG("seed %llu: PC=%04X HL=%04X SP=%04X", (unsigned long long)seed, cpu->reg.PC, cpu->reg.HL, cpu->reg.SP);
+        free(cpu);
+        if (!ok) {
+            break;
+        }
+    }
+}
+
+// cpu_clock with a wrong store in step 50 or a wrong register in step 60
+static void run_broken(GBCPU *cpu, void *context) {
+    int *fault = context;
+    cpu_clock(cpu, false, false);
+    if (cpu->instruction_count == 50 && *fault == 0) {
+        cpu->memory[0xD123] ^= 0x01;
+        verify_store(cpu, 0xD123, cpu->memory[0xD123]);
+    } else if (cpu->instruction_count == 60 && *fault == 1) {
+        cpu->reg.DE ^= 0x0100;
+    }
+}
+
+// whether the row of the report starting with name is marked as different
+static bool marked(const char *text, const char *name) {
+    const char *row = strstr(text, name);
+    const char *mark = row ? strstr(row, "<--") : NULL;
+    return mark && mark < strchr(row, '\n');
+}
+
+static char *report(const Verifier *verifier) {
+    static char text[0x1000];
+    FILE *out = tmpfile();
+    verify_report(verifier, out);
+    rewind(out);
+    size_t length = fread(text, 1, sizeof(text) - 1, out);
+    text[length] = '\0';
+    fclose(out);
+    return text;
+}
+
+void test_verify_divergence() {
+    for (int fault = 0; fault < 2; ++fault) {
+        GBCPU *reference = new_cpu();
+        verify_random_program(reference, 1, 0xC000, 0x200);
+        GBCPU *engine = copy_cpu(reference);
+
+        Verifier verifier;
+        verify_attach(&verifier, reference, engine, run_broken, &fault);
+        TEST_CHECK(!verify_run(&verifier, 0));
+        TEST_CHECK(verifier.diverged);
+        TEST_CHECK(verifier.steps == (fault == 0 ? 50 : 60));
+        char *text = report(&verifier);
+        TEST_MSG("%s", text);
+        if (fault == 0) {
+            TEST_CHECK(marked(text, "  writes") || marked(text, "  write hash"));
+            TEST_CHECK(strstr(text, "first memory difference at $D123") != NULL);
+        } else {
+            TEST_CHECK(marked(text, "  DE") && !marked(text, "  HL"));
+        }
+        // the last instruction run, in the disassembler's format
+        TEST_CHECK(strstr(text, "> ") != NULL && strstr(text, "reference next: $") != NULL);
+        verify_detach(&verifier);
+        free(engine);
+        free(reference);
+    }
+}
+
+TEST_LIST = {
+    {"Verify blocks", test_verify_blocks},
+#ifdef GB_JIT
+    {"Verify JIT", test_verify_jit},
+#endif
+    {"Verify random program", test_verify_random_program},
+    {"Verify divergence", test_verify_divergence},
+    {NULL, NULL}};